@@ -0,0 +1,78 @@
+#include "Bounds.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace VkRenderer {
+	Bounds computeBounds(const float* vertexData, size_t vertexCount, size_t vertexStride, const uint32_t* indices, size_t indexCount, int32_t indexOffset)
+	{
+		Bounds bounds{};
+
+		size_t count = indices ? indexCount : vertexCount;
+		auto position = [&](size_t i) {
+			size_t vertex = indices ? static_cast<size_t>(static_cast<int64_t>(indices[i]) + indexOffset) : i;
+			const float* p = vertexData + vertex * vertexStride;
+			return glm::vec3(p[0], p[1], p[2]);
+		};
+
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 p = position(i);
+			bounds.minimum = glm::min(bounds.minimum, p);
+			bounds.maximum = glm::max(bounds.maximum, p);
+		}
+
+		if (bounds.isEmpty())
+			return bounds;
+
+		// squared distances, one square root at the end
+		glm::vec3 center = bounds.getCenter();
+		float radiusSquared = 0.0f;
+		for (size_t i = 0; i < count; i++) {
+			glm::vec3 offset = position(i) - center;
+			radiusSquared = std::max(radiusSquared, glm::dot(offset, offset));
+		}
+
+		bounds.sphere = glm::vec4(center, std::sqrt(radiusSquared));
+		return bounds;
+	}
+
+	WorldBounds transformBounds(const Bounds& bounds, const glm::mat4& transform)
+	{
+		WorldBounds out;
+		transformBounds(&bounds, 1, transform, &out);
+		return out;
+	}
+
+	void transformBounds(const Bounds* bounds, size_t count, const glm::mat4& transform, WorldBounds* out, size_t stride)
+	{
+		glm::vec3 axisX(transform[0]);
+		glm::vec3 axisY(transform[1]);
+		glm::vec3 axisZ(transform[2]);
+		glm::vec3 translation(transform[3]);
+
+		glm::vec3 absX = glm::abs(axisX);
+		glm::vec3 absY = glm::abs(axisY);
+		glm::vec3 absZ = glm::abs(axisZ);
+
+		float scale = std::sqrt(std::max({ glm::dot(axisX, axisX), glm::dot(axisY, axisY), glm::dot(axisZ, axisZ) }));
+
+		for (size_t i = 0; i < count; i++) {
+			const Bounds& source = *reinterpret_cast<const Bounds*>(reinterpret_cast<const unsigned char*>(bounds) + i * stride);
+			WorldBounds& result = out[i];
+
+			if (source.isEmpty()) {
+				result = { translation, glm::vec3(0.0f), glm::vec4(translation, 0.0f) };
+				continue;
+			}
+
+			glm::vec3 center = source.getCenter();
+			glm::vec3 extent = source.getExtent();
+
+			result.center = translation + axisX * center.x + axisY * center.y + axisZ * center.z;
+			result.extent = absX * extent.x + absY * extent.y + absZ * extent.z;
+
+			// the sphere shares the box center, so it lands on the transformed one
+			result.sphere = glm::vec4(result.center, source.sphere.w * scale);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+
+namespace VkRenderer {
+	// model space box and sphere, the sphere is centered on the box. empty until something was added
+	struct Bounds {
+		glm::vec3 minimum{ std::numeric_limits<float>::max() };
+		glm::vec3 maximum{ -std::numeric_limits<float>::max() };
+		glm::vec4 sphere{}; // center and radius
+
+		bool isEmpty() const { return minimum.x > maximum.x; }
+		glm::vec3 getCenter() const { return (minimum + maximum) * 0.5f; }
+		glm::vec3 getExtent() const { return (maximum - minimum) * 0.5f; }
+	};
+
+	// bounds after a transform, the box as center and half extent since that's what plane tests want
+	struct WorldBounds {
+		glm::vec3 center{};
+		glm::vec3 extent{};
+		glm::vec4 sphere{};
+
+		glm::vec3 getMinimum() const { return center - extent; }
+		glm::vec3 getMaximum() const { return center + extent; }
+	};
+
+	/*
+	 * Bounds of the positions a range of indices reads, or of every vertex when indices is null. vertexData is read
+	 * as vertexStride floats per vertex with the position in the first three, indexOffset is added to every index.
+	 */
+	Bounds computeBounds(const float* vertexData, size_t vertexCount, size_t vertexStride,
+		const uint32_t* indices = nullptr, size_t indexCount = 0, int32_t indexOffset = 0);
+
+	// the box through Arvo's transform: the center goes through the matrix and the half extent through the absolute
+	// value of its upper 3x3, which is exact for the box and saves transforming eight corners. the sphere radius grows
+	// with the largest axis scale
+	WorldBounds transformBounds(const Bounds& bounds, const glm::mat4& transform);
+	// many bounds under one transform, the absolute matrix and the scale are only worked out once.
+	// stride is the distance between two bounds in bytes, so they can be read straight out of an array of Submesh
+	void transformBounds(const Bounds* bounds, size_t count, const glm::mat4& transform, WorldBounds* out, size_t stride = sizeof(Bounds));
+}
@@ -0,0 +1,200 @@
+#include "GeometryPool.hpp"
+
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+
+namespace VkRenderer {
+	GeometryPool::GeometryPool(VulkanDevice& device, VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, VkDeviceSize meshletCapacity)
+		: device{ device }
+	{
+		vertexBuffer = std::make_unique<VulkanBuffer>(
+			device,
+			vertexCapacity,
+			1,
+			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		indexBuffer = std::make_unique<VulkanBuffer>(
+			device,
+			indexCapacity,
+			1,
+			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		meshletBuffer = std::make_unique<VulkanBuffer>(
+			device,
+			meshletCapacity,
+			1,
+			VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+		);
+
+		vertexRanges.reset(vertexCapacity);
+		indexRanges.reset(indexCapacity);
+		meshletRanges.reset(meshletCapacity);
+	}
+
+	GeometryPool::~GeometryPool()
+	{
+		// flushes pending copies into the pool and runs the deferred frees below
+		device.getUploadContext().waitIdle();
+	}
+
+	GeometryPool::Allocation GeometryPool::allocate(uint32_t vertexStride, uint32_t vertexCount, uint32_t indexSize, uint32_t indexCount)
+	{
+		assert(vertexStride > 0 && indexSize > 0 && "Geometry pool strides must be non zero");
+
+		Allocation allocation{};
+		allocation.vertexByteSize = static_cast<VkDeviceSize>(vertexStride) * vertexCount;
+		allocation.indexByteSize = static_cast<VkDeviceSize>(indexSize) * indexCount;
+
+		// vertex ranges are aligned to the stride so the offset can be expressed in whole vertices
+		if (!vertexRanges.allocate(allocation.vertexByteSize, vertexStride, allocation.vertexByteOffset))
+			throw std::runtime_error("geometry pool is out of vertex memory!");
+
+		if (!indexRanges.allocate(allocation.indexByteSize, indexSize, allocation.indexByteOffset)) {
+			vertexRanges.free(allocation.vertexByteOffset, allocation.vertexByteSize);
+			throw std::runtime_error("geometry pool is out of index memory!");
+		}
+
+		allocation.vertexOffset = static_cast<int32_t>(allocation.vertexByteOffset / vertexStride);
+		allocation.firstIndex = static_cast<uint32_t>(allocation.indexByteOffset / indexSize);
+
+		return allocation;
+	}
+
+	GeometryPool::Staging GeometryPool::beginUpload(const Allocation& allocation)
+	{
+		Staging staging{};
+
+		VkDeviceSize stagingSize = allocation.vertexByteSize + allocation.indexByteSize;
+		if (stagingSize == 0)
+			return staging;
+
+		staging.memory = device.getUploadContext().stage(stagingSize);
+		staging.vertexData = staging.memory.data;
+		staging.indexData = static_cast<char*>(staging.memory.data) + allocation.vertexByteSize;
+
+		return staging;
+	}
+
+	UploadTicket GeometryPool::endUpload(const Allocation& allocation, const Staging& staging)
+	{
+		UploadContext& uploadContext = device.getUploadContext();
+
+		if (staging.memory.size == 0)
+			return uploadContext.currentTicket();
+
+		VkCommandBuffer commandBuffer = uploadContext.getCommandBuffer();
+
+		if (allocation.vertexByteSize > 0) {
+			VkBufferCopy vertexCopy{ staging.memory.offset, allocation.vertexByteOffset, allocation.vertexByteSize };
+			vkCmdCopyBuffer(commandBuffer, staging.memory.buffer, vertexBuffer->getBuffer(), 1, &vertexCopy);
+
+			uploadContext.releaseBuffer(vertexBuffer->getBuffer(), allocation.vertexByteOffset, allocation.vertexByteSize,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
+		}
+
+		if (allocation.indexByteSize > 0) {
+			VkBufferCopy indexCopy{ staging.memory.offset + allocation.vertexByteSize, allocation.indexByteOffset, allocation.indexByteSize };
+			vkCmdCopyBuffer(commandBuffer, staging.memory.buffer, indexBuffer->getBuffer(), 1, &indexCopy);
+
+			uploadContext.releaseBuffer(indexBuffer->getBuffer(), allocation.indexByteOffset, allocation.indexByteSize,
+				VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
+		}
+
+		return uploadContext.currentTicket();
+	}
+
+	UploadTicket GeometryPool::upload(const Allocation& allocation, const void* vertexData, const void* indexData)
+	{
+		Staging staging = beginUpload(allocation);
+
+		if (allocation.vertexByteSize > 0)
+			memcpy(staging.vertexData, vertexData, allocation.vertexByteSize);
+		if (allocation.indexByteSize > 0)
+			memcpy(staging.indexData, indexData, allocation.indexByteSize);
+
+		return endUpload(allocation, staging);
+	}
+
+	void GeometryPool::free(const Allocation& allocation)
+	{
+		UploadContext& uploadContext = device.getUploadContext();
+
+		// a copy into this range might still be sitting in the recorded batch, don't hand it out again before that ran
+		if (uploadContext.isRecording()) {
+			uploadContext.onComplete([this, allocation]() {
+				vertexRanges.free(allocation.vertexByteOffset, allocation.vertexByteSize);
+				indexRanges.free(allocation.indexByteOffset, allocation.indexByteSize);
+			});
+			return;
+		}
+
+		vertexRanges.free(allocation.vertexByteOffset, allocation.vertexByteSize);
+		indexRanges.free(allocation.indexByteOffset, allocation.indexByteSize);
+	}
+
+	GeometryPool::MeshletAllocation GeometryPool::allocateMeshlets(uint32_t meshletCount)
+	{
+		MeshletAllocation allocation{};
+		allocation.byteSize = static_cast<VkDeviceSize>(sizeof(Meshlet)) * meshletCount;
+		allocation.meshletCount = meshletCount;
+
+		if (meshletCount == 0)
+			return allocation;
+
+		if (!meshletRanges.allocate(allocation.byteSize, sizeof(Meshlet), allocation.byteOffset))
+			throw std::runtime_error("geometry pool is out of meshlet memory!");
+
+		allocation.firstMeshlet = static_cast<uint32_t>(allocation.byteOffset / sizeof(Meshlet));
+		return allocation;
+	}
+
+	UploadTicket GeometryPool::uploadMeshlets(const MeshletAllocation& allocation, const Meshlet* meshlets)
+	{
+		UploadContext& uploadContext = device.getUploadContext();
+
+		if (allocation.byteSize == 0)
+			return uploadContext.currentTicket();
+
+		StagingAllocation staging = uploadContext.stage(allocation.byteSize);
+		memcpy(staging.data, meshlets, allocation.byteSize);
+
+		VkBufferCopy copy{ staging.offset, allocation.byteOffset, allocation.byteSize };
+		vkCmdCopyBuffer(uploadContext.getCommandBuffer(), staging.buffer, meshletBuffer->getBuffer(), 1, &copy);
+
+		uploadContext.releaseBuffer(meshletBuffer->getBuffer(), allocation.byteOffset, allocation.byteSize,
+			VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+
+		return uploadContext.currentTicket();
+	}
+
+	void GeometryPool::freeMeshlets(const MeshletAllocation& allocation)
+	{
+		if (allocation.byteSize == 0)
+			return;
+
+		UploadContext& uploadContext = device.getUploadContext();
+
+		if (uploadContext.isRecording()) {
+			uploadContext.onComplete([this, allocation]() {
+				meshletRanges.free(allocation.byteOffset, allocation.byteSize);
+			});
+			return;
+		}
+
+		meshletRanges.free(allocation.byteOffset, allocation.byteSize);
+	}
+
+	void GeometryPool::bind(VkCommandBuffer commandBuffer, VkIndexType indexType) const
+	{
+		VkBuffer buffers[] = { vertexBuffer->getBuffer() };
+		VkDeviceSize offsets[] = { 0 };
+		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, indexType);
+	}
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+#include "VulkanBuffer.hpp"
+#include "RangeAllocator.hpp"
+#include "Meshlets.hpp"
+
+#include <memory>
+
+namespace VkRenderer {
+	/*
+	 * Sub-allocates the vertex and index data of every model out of one large
+	 * device local vertex buffer and one index buffer, so a pass binds them once.
+	 * Meshlets live next to them in a storage buffer for the culling pass.
+	 */
+	class GeometryPool
+	{
+		public:
+			static constexpr VkDeviceSize DEFAULT_VERTEX_CAPACITY = 256ull * 1024 * 1024;
+			static constexpr VkDeviceSize DEFAULT_INDEX_CAPACITY = 128ull * 1024 * 1024;
+			static constexpr VkDeviceSize DEFAULT_MESHLET_CAPACITY = 32ull * 1024 * 1024;
+
+			struct Allocation {
+				VkDeviceSize vertexByteOffset = 0;
+				VkDeviceSize vertexByteSize = 0;
+				VkDeviceSize indexByteOffset = 0;
+				VkDeviceSize indexByteSize = 0;
+
+				// what vkCmdDrawIndexed wants, in vertices and indices rather than bytes
+				int32_t vertexOffset = 0;
+				uint32_t firstIndex = 0;
+			};
+
+			struct MeshletAllocation {
+				VkDeviceSize byteOffset = 0;
+				VkDeviceSize byteSize = 0;
+				uint32_t firstMeshlet = 0;
+				uint32_t meshletCount = 0;
+			};
+
+			GeometryPool(VulkanDevice& device, VkDeviceSize vertexCapacity = DEFAULT_VERTEX_CAPACITY, VkDeviceSize indexCapacity = DEFAULT_INDEX_CAPACITY,
+				VkDeviceSize meshletCapacity = DEFAULT_MESHLET_CAPACITY);
+			~GeometryPool();
+
+			GeometryPool(const GeometryPool&) = delete;
+			GeometryPool& operator=(const GeometryPool&) = delete;
+
+			Allocation allocate(uint32_t vertexStride, uint32_t vertexCount, uint32_t indexSize, uint32_t indexCount);
+			// staging memory for an allocation, fill vertexData/indexData and hand it back to endUpload
+			struct Staging {
+				void* vertexData = nullptr;
+				void* indexData = nullptr;
+				StagingAllocation memory{};
+			};
+
+			Staging beginUpload(const Allocation& allocation);
+			UploadTicket endUpload(const Allocation& allocation, const Staging& staging);
+			UploadTicket upload(const Allocation& allocation, const void* vertexData, const void* indexData);
+			void free(const Allocation& allocation);
+
+			// firstIndex and vertexOffset of uploaded meshlets have to be absolute, the culling pass writes them into draws as is
+			MeshletAllocation allocateMeshlets(uint32_t meshletCount);
+			UploadTicket uploadMeshlets(const MeshletAllocation& allocation, const Meshlet* meshlets);
+			void freeMeshlets(const MeshletAllocation& allocation);
+
+			void bind(VkCommandBuffer commandBuffer, VkIndexType indexType = VK_INDEX_TYPE_UINT32) const;
+
+			VkBuffer getVertexBuffer() const { return vertexBuffer->getBuffer(); }
+			VkBuffer getIndexBuffer() const { return indexBuffer->getBuffer(); }
+			VulkanBuffer& getMeshletBuffer() const { return *meshletBuffer; }
+
+			VkDeviceSize getVertexBytesUsed() const { return vertexRanges.getUsed(); }
+			VkDeviceSize getIndexBytesUsed() const { return indexRanges.getUsed(); }
+		private:
+			VulkanDevice& device;
+
+			std::unique_ptr<VulkanBuffer> vertexBuffer;
+			std::unique_ptr<VulkanBuffer> indexBuffer;
+			std::unique_ptr<VulkanBuffer> meshletBuffer;
+
+			RangeAllocator vertexRanges;
+			RangeAllocator indexRanges;
+			RangeAllocator meshletRanges;
+	};
+}
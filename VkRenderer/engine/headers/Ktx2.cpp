@@ -0,0 +1,263 @@
+#include "Ktx2.hpp"
+
+#include "TextureCompression.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace VkRenderer {
+	namespace {
+		constexpr uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 'K', 'T', 'X', ' ', '2', '0', 0xBB, '\r', '\n', 0x1A, '\n' };
+
+		struct Header {
+			uint8_t identifier[12];
+			uint32_t vkFormat;
+			uint32_t typeSize;
+			uint32_t pixelWidth;
+			uint32_t pixelHeight;
+			uint32_t pixelDepth;
+			uint32_t layerCount;
+			uint32_t faceCount;
+			uint32_t levelCount;
+			uint32_t supercompressionScheme;
+			uint32_t dfdByteOffset;
+			uint32_t dfdByteLength;
+			uint32_t kvdByteOffset;
+			uint32_t kvdByteLength;
+			uint64_t sgdByteOffset;
+			uint64_t sgdByteLength;
+		};
+
+		struct LevelIndex {
+			uint64_t byteOffset;
+			uint64_t byteLength;
+			uint64_t uncompressedByteLength;
+		};
+
+		static_assert(sizeof(Header) == 80, "KTX2 header is 80 bytes");
+		static_assert(sizeof(LevelIndex) == 24, "KTX2 level index entries are 24 bytes");
+
+		size_t alignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1) / alignment * alignment;
+		}
+
+		void appendUint32(std::vector<uint8_t>& bytes, uint32_t value)
+		{
+			size_t offset = bytes.size();
+			bytes.resize(offset + sizeof(value));
+			memcpy(bytes.data() + offset, &value, sizeof(value));
+		}
+
+		// basic data format descriptor (Khronos data format spec), what a BC block holds and how its colors are encoded
+		std::vector<uint8_t> createDescriptor(VkFormat format)
+		{
+			enum : uint32_t { MODEL_BC4 = 131, MODEL_BC5 = 132, MODEL_BC6H = 133, MODEL_BC7 = 134 };
+			enum : uint32_t { PRIMARIES_BT709 = 1, TRANSFER_LINEAR = 1, TRANSFER_SRGB = 2 };
+			enum : uint32_t { CHANNEL_FLOAT = 0x80 };
+
+			struct Sample {
+				uint32_t bitOffset, bitLength, channel, lower, upper;
+			};
+
+			uint32_t model = MODEL_BC7;
+			std::vector<Sample> samples;
+
+			switch (format) {
+				case VK_FORMAT_BC4_UNORM_BLOCK:
+					model = MODEL_BC4;
+					samples = { { 0, 64, 0, 0, 0xFFFFFFFF } };
+					break;
+				case VK_FORMAT_BC5_UNORM_BLOCK:
+					model = MODEL_BC5;
+					samples = { { 0, 64, 0, 0, 0xFFFFFFFF }, { 64, 64, 1, 0, 0xFFFFFFFF } };
+					break;
+				case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+					model = MODEL_BC6H;
+					samples = { { 0, 128, CHANNEL_FLOAT, 0, 0x3F800000 } }; // 0.0f to 1.0f
+					break;
+				default:
+					samples = { { 0, 128, 0, 0, 0xFFFFFFFF } };
+					break;
+			}
+
+			uint32_t transfer = format == VK_FORMAT_BC7_SRGB_BLOCK ? TRANSFER_SRGB : TRANSFER_LINEAR;
+			uint32_t blockSize = 24 + 16 * static_cast<uint32_t>(samples.size());
+
+			std::vector<uint8_t> bytes;
+			appendUint32(bytes, 4 + blockSize); // dfdTotalSize
+			appendUint32(bytes, 0); // vendor and descriptor type: khronos basic
+			appendUint32(bytes, 2 | blockSize << 16); // version 2
+			appendUint32(bytes, model | PRIMARIES_BT709 << 8 | transfer << 16);
+			appendUint32(bytes, 3 | 3 << 8); // 4x4 texel blocks, stored as size - 1
+			appendUint32(bytes, getBlockSize(format)); // bytes in plane 0
+			appendUint32(bytes, 0);
+
+			for (const Sample& sample : samples) {
+				appendUint32(bytes, sample.bitOffset | (sample.bitLength - 1) << 16 | sample.channel << 24);
+				appendUint32(bytes, 0); // sample position
+				appendUint32(bytes, sample.lower);
+				appendUint32(bytes, sample.upper);
+			}
+
+			return bytes;
+		}
+	}
+
+	bool Ktx2File::open(const std::string& path)
+	{
+		if (!file.open(path))
+			return false;
+
+		const unsigned char* data = file.data();
+		const size_t size = file.size();
+
+		if (size < sizeof(Header))
+			return false;
+
+		Header header;
+		memcpy(&header, data, sizeof(Header));
+
+		if (memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) != 0)
+			return false;
+
+		// 2D, not an array or a cube, mips stored rather than left to the loader
+		if (header.pixelDepth != 0 || header.layerCount > 1 || header.faceCount != 1 || header.levelCount == 0 || header.supercompressionScheme != 0)
+			return false;
+
+		format = static_cast<VkFormat>(header.vkFormat);
+		width = header.pixelWidth;
+		height = header.pixelHeight;
+
+		if (getBlockSize(format) == 0 || width == 0 || height == 0)
+			return false;
+
+		// a full chain is floor(log2(max(width, height))) + 1 levels, more than that and width >> i runs past 31
+		uint32_t maxLevels = 1;
+		for (uint32_t extent = std::max(width, height); extent > 1; extent >>= 1)
+			maxLevels++;
+
+		if (header.levelCount > maxLevels)
+			return false;
+
+		if (header.levelCount > (size - sizeof(Header)) / sizeof(LevelIndex))
+			return false;
+
+		std::vector<LevelIndex> index(header.levelCount);
+		memcpy(index.data(), data + sizeof(Header), index.size() * sizeof(LevelIndex));
+
+		levels.resize(header.levelCount);
+		for (uint32_t i = 0; i < header.levelCount; i++) {
+			uint32_t levelWidth = std::max(width >> i, 1u);
+			uint32_t levelHeight = std::max(height >> i, 1u);
+
+			if (index[i].byteOffset > size || index[i].byteLength > size - index[i].byteOffset)
+				return false;
+			if (index[i].byteLength != getLevelSize(format, levelWidth, levelHeight))
+				return false;
+
+			levels[i].data = data + index[i].byteOffset;
+			levels[i].size = static_cast<size_t>(index[i].byteLength);
+		}
+
+		if (header.kvdByteOffset > size || header.kvdByteLength > size - header.kvdByteOffset)
+			return false;
+
+		// each pair is its length, the key with a terminating zero, then the value, padded to 4 bytes
+		const unsigned char* kvd = data + header.kvdByteOffset;
+		size_t position = 0;
+		while (position + sizeof(uint32_t) <= header.kvdByteLength) {
+			uint32_t length;
+			memcpy(&length, kvd + position, sizeof(length));
+			position += sizeof(length);
+
+			if (length > header.kvdByteLength - position)
+				return false;
+
+			const char* pair = reinterpret_cast<const char*>(kvd + position);
+			size_t keyLength = strnlen(pair, length);
+			if (keyLength < length) {
+				std::string value(pair + keyLength + 1, length - keyLength - 1);
+				if (!value.empty() && value.back() == '\0')
+					value.pop_back();
+
+				values.emplace_back(std::string(pair, keyLength), std::move(value));
+			}
+
+			position = alignUp(position + length, 4);
+		}
+
+		return true;
+	}
+
+	size_t Ktx2File::getDataSize() const
+	{
+		size_t size = 0;
+		for (const Level& level : levels)
+			size += level.size;
+		return size;
+	}
+
+	std::string Ktx2File::getValue(const std::string& key) const
+	{
+		for (const auto& [name, value] : values)
+			if (name == key)
+				return value;
+		return {};
+	}
+
+	bool writeKtx2(const std::string& path, VkFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels, std::vector<std::pair<std::string, std::string>> values)
+	{
+		uint32_t blockSize = getBlockSize(format);
+		if (blockSize == 0 || levels.empty())
+			return false;
+
+		Header header{};
+		memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+		header.vkFormat = static_cast<uint32_t>(format);
+		header.typeSize = 1;
+		header.pixelWidth = width;
+		header.pixelHeight = height;
+		header.faceCount = 1;
+		header.levelCount = static_cast<uint32_t>(levels.size());
+
+		std::vector<uint8_t> bytes(sizeof(Header) + levels.size() * sizeof(LevelIndex));
+
+		std::vector<uint8_t> descriptor = createDescriptor(format);
+		header.dfdByteOffset = static_cast<uint32_t>(bytes.size());
+		header.dfdByteLength = static_cast<uint32_t>(descriptor.size());
+		bytes.insert(bytes.end(), descriptor.begin(), descriptor.end());
+
+		// keys have to be sorted, the writer key is expected in every file
+		values.emplace_back("KTXwriter", "VulkanTest");
+		std::sort(values.begin(), values.end());
+
+		header.kvdByteOffset = static_cast<uint32_t>(bytes.size());
+		for (const auto& [key, value] : values) {
+			appendUint32(bytes, static_cast<uint32_t>(key.size() + 1 + value.size() + 1));
+			bytes.insert(bytes.end(), key.begin(), key.end());
+			bytes.push_back(0);
+			bytes.insert(bytes.end(), value.begin(), value.end());
+			bytes.push_back(0);
+			bytes.resize(alignUp(bytes.size(), 4));
+		}
+		header.kvdByteLength = static_cast<uint32_t>(bytes.size()) - header.kvdByteOffset;
+
+		// the smallest level comes first in the file, each one starts on a block boundary
+		std::vector<LevelIndex> index(levels.size());
+		for (size_t i = levels.size(); i-- > 0;) {
+			bytes.resize(alignUp(bytes.size(), std::max(blockSize, 4u)));
+
+			index[i].byteOffset = bytes.size();
+			index[i].byteLength = levels[i].size();
+			index[i].uncompressedByteLength = levels[i].size();
+			bytes.insert(bytes.end(), levels[i].begin(), levels[i].end());
+		}
+
+		memcpy(bytes.data(), &header, sizeof(Header));
+		memcpy(bytes.data() + sizeof(Header), index.data(), index.size() * sizeof(LevelIndex));
+
+		return writeFileAtomically(path, bytes);
+	}
+}
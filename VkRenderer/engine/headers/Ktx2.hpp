@@ -0,0 +1,53 @@
+#pragma once
+
+#include "MappedFile.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace VkRenderer {
+	/*
+	 * A KTX2 file mapped into memory. Only what the texture cache writes is accepted: one 2D image with its
+	 * mip chain and no supercompression, levels are pointed at straight in the mapping.
+	 */
+	class Ktx2File
+	{
+		public:
+			struct Level {
+				const unsigned char* data = nullptr;
+				size_t size = 0;
+			};
+
+			// false if the file is missing, truncated or something other than a plain 2D texture
+			bool open(const std::string& path);
+
+			VkFormat getFormat() const { return format; }
+			uint32_t getWidth() const { return width; }
+			uint32_t getHeight() const { return height; }
+
+			// level 0 is the full size one
+			uint32_t getLevelCount() const { return static_cast<uint32_t>(levels.size()); }
+			const Level& getLevel(uint32_t level) const { return levels[level]; }
+			size_t getDataSize() const;
+
+			// value of a key/value pair without the terminating zero, empty if the key isn't there
+			std::string getValue(const std::string& key) const;
+		private:
+			MappedFile file;
+
+			VkFormat format = VK_FORMAT_UNDEFINED;
+			uint32_t width = 0, height = 0;
+			std::vector<Level> levels;
+			std::vector<std::pair<std::string, std::string>> values;
+	};
+
+	// writes levels (largest first, each already encoded in format) as a KTX2 file, only BC formats are supported.
+	// values end up in the key/value data, false if the file couldn't be written
+	bool writeKtx2(const std::string& path, VkFormat format, uint32_t width, uint32_t height,
+		const std::vector<std::vector<uint8_t>>& levels, std::vector<std::pair<std::string, std::string>> values = {});
+}
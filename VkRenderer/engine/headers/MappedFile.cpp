@@ -0,0 +1,143 @@
+#include "MappedFile.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace VkRenderer {
+	MappedFile::~MappedFile()
+	{
+		close();
+	}
+
+#ifdef _WIN32
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+
+		LARGE_INTEGER size{};
+		if (!GetFileSizeEx(file, &size) || size.QuadPart == 0) {
+			CloseHandle(file);
+			return false;
+		}
+
+		HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			CloseHandle(file);
+			return false;
+		}
+
+		void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+		if (view == nullptr) {
+			CloseHandle(mapping);
+			CloseHandle(file);
+			return false;
+		}
+
+		fileHandle = file;
+		mappingHandle = mapping;
+		bytes = static_cast<const unsigned char*>(view);
+		byteSize = static_cast<size_t>(size.QuadPart);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (bytes)
+			UnmapViewOfFile(bytes);
+		if (mappingHandle)
+			CloseHandle(mappingHandle);
+		if (fileHandle)
+			CloseHandle(fileHandle);
+
+		bytes = nullptr;
+		byteSize = 0;
+		mappingHandle = nullptr;
+		fileHandle = nullptr;
+	}
+#else
+	bool MappedFile::open(const std::string& path)
+	{
+		close();
+
+		int file = ::open(path.c_str(), O_RDONLY);
+		if (file < 0)
+			return false;
+
+		struct stat info{};
+		if (fstat(file, &info) != 0 || info.st_size == 0) {
+			::close(file);
+			return false;
+		}
+
+		void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+		if (view == MAP_FAILED) {
+			::close(file);
+			return false;
+		}
+
+		fileDescriptor = file;
+		bytes = static_cast<const unsigned char*>(view);
+		byteSize = static_cast<size_t>(info.st_size);
+		return true;
+	}
+
+	void MappedFile::close()
+	{
+		if (bytes)
+			munmap(const_cast<unsigned char*>(bytes), byteSize);
+		if (fileDescriptor >= 0)
+			::close(fileDescriptor);
+
+		bytes = nullptr;
+		byteSize = 0;
+		fileDescriptor = -1;
+	}
+#endif
+
+	bool writeFileAtomically(const std::string& path, const std::vector<unsigned char>& bytes)
+	{
+		namespace fs = std::filesystem;
+
+		std::error_code error;
+		fs::path parent = fs::path(path).parent_path();
+		if (!parent.empty())
+			fs::create_directories(parent, error);
+
+		// the thread id keeps two threads writing the same file from sharing a temporary
+		std::string temporary = path + "." + std::to_string(std::hash<std::thread::id>{}(std::this_thread::get_id())) + ".tmp";
+		{
+			std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+			if (!file)
+				return false;
+
+			file.write(reinterpret_cast<const char*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+			if (!file)
+				return false;
+		}
+
+		fs::rename(temporary, path, error);
+		if (error) {
+			fs::remove(temporary, error);
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace VkRenderer {
+	// a whole file mapped read only, unmapped again on destruction
+	class MappedFile
+	{
+		public:
+			MappedFile() = default;
+			~MappedFile();
+
+			MappedFile(const MappedFile&) = delete;
+			MappedFile& operator=(const MappedFile&) = delete;
+
+			// false if the file doesn't exist, is empty or can't be mapped
+			bool open(const std::string& path);
+			void close();
+
+			const unsigned char* data() const { return bytes; }
+			size_t size() const { return byteSize; }
+		private:
+			const unsigned char* bytes = nullptr;
+			size_t byteSize = 0;
+
+#ifdef _WIN32
+			void* fileHandle = nullptr;
+			void* mappingHandle = nullptr;
+#else
+			int fileDescriptor = -1;
+#endif
+	};
+
+	// written next to the target and renamed over it, so a reader never maps half a file. creates the parent directory
+	bool writeFileAtomically(const std::string& path, const std::vector<unsigned char>& bytes);
+}
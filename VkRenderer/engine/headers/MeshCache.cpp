@@ -0,0 +1,421 @@
+#include "MeshCache.hpp"
+
+#include "VulkanUtils.hpp"
+
+#include <cstring>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+#include <type_traits>
+
+namespace fs = std::filesystem;
+
+namespace VkRenderer {
+	namespace {
+		constexpr uint32_t CACHE_MAGIC = 0x4D564144; // "DAVM"
+		constexpr size_t CACHE_ALIGNMENT = 16;
+
+		// everything is read in place from the mapping, so the file is just these structs and blobs at 16 byte offsets
+		struct FileHeader {
+			uint32_t magic;
+			uint32_t version;
+			uint64_t settingsHash;
+			uint64_t fileSize;
+
+			uint32_t vertexLayout;
+			uint32_t vertexCount;
+			uint32_t indexType;
+			uint32_t indexCount;
+			uint32_t submeshCount;
+			uint32_t meshletCount;
+			uint32_t lodCount;
+			uint32_t sourceCount;
+			uint32_t imageCount;
+			uint32_t materialCount;
+
+			glm::mat4 dequantization;
+			Bounds bounds;
+			VertexCacheStats cacheStatsBefore;
+			VertexCacheStats cacheStatsAfter;
+
+			uint64_t vertexOffset;
+			uint64_t indexOffset;
+			uint64_t submeshOffset;
+			uint64_t meshletOffset;
+			uint64_t sourceOffset;
+			uint64_t imageOffset;
+			uint64_t materialOffset;
+		};
+
+		struct SourceEntry {
+			uint64_t pathOffset;
+			uint64_t pathLength;
+			uint64_t size;
+			int64_t writeTime;
+			uint64_t hash;
+		};
+
+		struct ImageEntry {
+			uint64_t uriOffset;
+			uint64_t uriLength;
+			uint64_t dataOffset;
+			uint64_t dataSize;
+		};
+
+		struct MaterialEntry {
+			uint64_t nameOffset;
+			uint64_t nameLength;
+			int32_t albedoImage;
+			int32_t normalImage;
+		};
+
+		static_assert(std::is_trivially_copyable_v<VulkanModel::Submesh>, "Submesh is stored as is");
+		static_assert(std::is_trivially_copyable_v<Meshlet>, "Meshlet is stored as is");
+
+		template <typename T>
+		uint64_t hashValue(uint64_t hash, const T& value)
+		{
+			return hashBytes(&value, sizeof(T), hash);
+		}
+
+		// every builder setting that changes what loadModel produces
+		uint64_t hashSettings(const VulkanModel::Builder& settings)
+		{
+			uint64_t hash = hashValue(14695981039346656037ull, MeshCache::VERSION);
+			hash = hashValue(hash, settings.imageMode);
+			hash = hashValue(hash, settings.vertexLayout);
+			hash = hashValue(hash, settings.split16BitIndices);
+			hash = hashValue(hash, settings.optimizeMesh);
+			hash = hashValue(hash, settings.generateMeshlets);
+			hash = hashValue(hash, settings.overdrawThreshold);
+			hash = hashValue(hash, settings.lodCount);
+			hash = hashValue(hash, settings.lodReduction);
+			hash = hashValue(hash, settings.lodTargetError);
+			hash = hashValue(hash, settings.lodNormalWeight);
+			hash = hashValue(hash, settings.lodUvWeight);
+			hash = hashValue(hash, settings.weldMode);
+			hash = hashValue(hash, settings.weldEpsilon);
+			return hash;
+		}
+
+		bool hashFile(const std::string& path, uint64_t& hash)
+		{
+			MappedFile file;
+			if (!file.open(path))
+				return false;
+
+			hash = hashBytes(file.data(), file.size());
+			return true;
+		}
+
+		int64_t writeTimeOf(const fs::path& path, std::error_code& error)
+		{
+			return static_cast<int64_t>(fs::last_write_time(path, error).time_since_epoch().count());
+		}
+
+		// the draws go straight from these ranges to the gpu, so a file that passed every other check but points
+		// outside its own index or vertex data is still treated as a miss
+		bool rangesValid(const FileHeader& header, const unsigned char* data)
+		{
+			if (header.vertexLayout > static_cast<uint32_t>(VulkanModel::VertexLayout::Compact) ||
+				(header.indexType != VK_INDEX_TYPE_UINT16 && header.indexType != VK_INDEX_TYPE_UINT32) ||
+				header.lodCount < 1 || header.lodCount > VulkanModel::MAX_LODS)
+				return false;
+
+			const void* indices = data + header.indexOffset;
+			auto indexAt = [&](uint32_t i) -> uint32_t {
+				if (header.indexType == VK_INDEX_TYPE_UINT16)
+					return static_cast<const uint16_t*>(indices)[i];
+				return static_cast<const uint32_t*>(indices)[i];
+			};
+
+			auto indicesValid = [&](uint32_t firstIndex, uint32_t indexCount, int32_t vertexOffset) {
+				if (uint64_t(firstIndex) + indexCount > header.indexCount || vertexOffset < 0)
+					return false;
+
+				for (uint32_t i = firstIndex; i < firstIndex + indexCount; i++)
+					if (uint64_t(vertexOffset) + indexAt(i) >= header.vertexCount)
+						return false;
+
+				return true;
+			};
+
+			const VulkanModel::Submesh* submeshes = reinterpret_cast<const VulkanModel::Submesh*>(data + header.submeshOffset);
+			for (uint32_t s = 0; s < header.submeshCount; s++) {
+				const VulkanModel::Submesh& submesh = submeshes[s];
+
+				// lods[0] is always the submesh range itself, so it only has to match
+				if (!indicesValid(submesh.firstIndex, submesh.indexCount, submesh.vertexOffset) ||
+					submesh.lods[0].firstIndex != submesh.firstIndex || submesh.lods[0].indexCount != submesh.indexCount ||
+					uint64_t(submesh.firstMeshlet) + submesh.meshletCount > header.meshletCount)
+					return false;
+
+				for (uint32_t lod = 1; lod < header.lodCount; lod++)
+					if (!indicesValid(submesh.lods[lod].firstIndex, submesh.lods[lod].indexCount, submesh.vertexOffset))
+						return false;
+			}
+
+			const Meshlet* meshlets = reinterpret_cast<const Meshlet*>(data + header.meshletOffset);
+			for (uint32_t m = 0; m < header.meshletCount; m++)
+				if (!indicesValid(meshlets[m].firstIndex, meshlets[m].indexCount, meshlets[m].vertexOffset))
+					return false;
+
+			return true;
+		}
+
+		class CacheWriter {
+			public:
+				// room for count Ts at a 16 byte boundary, returns the offset
+				template <typename T>
+				uint64_t reserve(size_t count)
+				{
+					size_t offset = (bytes.size() + CACHE_ALIGNMENT - 1) / CACHE_ALIGNMENT * CACHE_ALIGNMENT;
+					bytes.resize(offset + count * sizeof(T));
+					return offset;
+				}
+
+				uint64_t append(const void* data, size_t size)
+				{
+					uint64_t offset = reserve<unsigned char>(size);
+					if (size > 0)
+						memcpy(bytes.data() + offset, data, size);
+					return offset;
+				}
+
+				void* at(uint64_t offset) { return bytes.data() + offset; }
+
+				std::vector<unsigned char> bytes;
+		};
+	}
+
+	MeshCache::MeshCache(std::string directory)
+		: directory{ std::move(directory) }
+	{}
+
+	std::string MeshCache::getCachePath(const std::string& filepath, const VulkanModel::Builder& settings) const
+	{
+		std::error_code error;
+		fs::path source = fs::weakly_canonical(fs::path(filepath), error);
+		if (error)
+			source = fs::absolute(fs::path(filepath));
+
+		std::string key = source.generic_string();
+		uint64_t hash = hashValue(hashBytes(key.data(), key.size()), hashSettings(settings));
+
+		std::stringstream name;
+		name << fs::path(filepath).stem().string() << "-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".davmesh";
+		return (fs::path(directory) / name.str()).string();
+	}
+
+	std::unique_ptr<CachedMesh> MeshCache::load(const std::string& filepath, const VulkanModel::Builder& settings) const
+	{
+		auto cached = std::make_unique<CachedMesh>();
+		cached->path = getCachePath(filepath, settings);
+
+		if (!cached->file.open(cached->path))
+			return nullptr;
+
+		const unsigned char* data = cached->file.data();
+		const size_t size = cached->file.size();
+
+		if (size < sizeof(FileHeader))
+			return nullptr;
+
+		FileHeader header;
+		memcpy(&header, data, sizeof(FileHeader));
+
+		if (header.magic != CACHE_MAGIC || header.version != VERSION || header.settingsHash != hashSettings(settings) || header.fileSize != size)
+			return nullptr;
+
+		// a file cut short by a crash or disk trouble must not be read past its end
+		auto inside = [&](uint64_t offset, uint64_t count, uint64_t elementSize) {
+			return offset <= size && count <= (size - offset) / elementSize;
+		};
+
+		uint32_t vertexStride = VulkanModel::getVertexStride(static_cast<VulkanModel::VertexLayout>(header.vertexLayout));
+		uint32_t indexSize = header.indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		if (!inside(header.vertexOffset, header.vertexCount, vertexStride) || !inside(header.indexOffset, header.indexCount, indexSize) ||
+			!inside(header.submeshOffset, header.submeshCount, sizeof(VulkanModel::Submesh)) || !inside(header.meshletOffset, header.meshletCount, sizeof(Meshlet)) ||
+			!inside(header.sourceOffset, header.sourceCount, sizeof(SourceEntry)) || !inside(header.imageOffset, header.imageCount, sizeof(ImageEntry)) ||
+			!inside(header.materialOffset, header.materialCount, sizeof(MaterialEntry)))
+			return nullptr;
+
+		auto readString = [&](uint64_t offset, uint64_t length, std::string& out) {
+			if (!inside(offset, length, 1))
+				return false;
+			out.assign(reinterpret_cast<const char*>(data + offset), static_cast<size_t>(length));
+			return true;
+		};
+
+		// size and write time first, the content hash only when they disagree
+		const SourceEntry* sources = reinterpret_cast<const SourceEntry*>(data + header.sourceOffset);
+		for (uint32_t i = 0; i < header.sourceCount; i++) {
+			std::string path;
+			if (!readString(sources[i].pathOffset, sources[i].pathLength, path))
+				return nullptr;
+
+			std::error_code error;
+			uint64_t sourceSize = fs::file_size(path, error);
+			if (error || sourceSize != sources[i].size)
+				return nullptr;
+
+			int64_t writeTime = writeTimeOf(path, error);
+			if (error)
+				return nullptr;
+
+			uint64_t hash = 0;
+			if (writeTime != sources[i].writeTime && (!hashFile(path, hash) || hash != sources[i].hash))
+				return nullptr;
+		}
+
+		if (!rangesValid(header, data))
+			return nullptr;
+
+		VulkanModel::Cooked& cooked = cached->cooked;
+		cooked.vertexLayout = static_cast<VulkanModel::VertexLayout>(header.vertexLayout);
+		cooked.vertexCount = header.vertexCount;
+		cooked.vertexData = data + header.vertexOffset;
+		cooked.indexType = static_cast<VkIndexType>(header.indexType);
+		cooked.indexCount = header.indexCount;
+		cooked.indexData = data + header.indexOffset;
+		cooked.submeshes = reinterpret_cast<const VulkanModel::Submesh*>(data + header.submeshOffset);
+		cooked.submeshCount = header.submeshCount;
+		cooked.meshlets = reinterpret_cast<const Meshlet*>(data + header.meshletOffset);
+		cooked.meshletCount = header.meshletCount;
+		cooked.lodCount = header.lodCount;
+		cooked.dequantization = header.dequantization;
+		cooked.bounds = header.bounds;
+
+		cached->cacheStatsBefore = header.cacheStatsBefore;
+		cached->cacheStatsAfter = header.cacheStatsAfter;
+		cached->directory = fs::path(filepath).parent_path().string();
+
+		const ImageEntry* images = reinterpret_cast<const ImageEntry*>(data + header.imageOffset);
+		cached->images.resize(header.imageCount);
+		for (uint32_t i = 0; i < header.imageCount; i++) {
+			if (!readString(images[i].uriOffset, images[i].uriLength, cached->images[i].uri) || !inside(images[i].dataOffset, images[i].dataSize, 1))
+				return nullptr;
+
+			const unsigned char* bytes = data + images[i].dataOffset;
+			cached->images[i].encoded.assign(bytes, bytes + images[i].dataSize);
+		}
+
+		const MaterialEntry* materials = reinterpret_cast<const MaterialEntry*>(data + header.materialOffset);
+		cached->materials.resize(header.materialCount);
+		for (uint32_t i = 0; i < header.materialCount; i++) {
+			if (!readString(materials[i].nameOffset, materials[i].nameLength, cached->materials[i].name))
+				return nullptr;
+
+			cached->materials[i].albedoImage = materials[i].albedoImage;
+			cached->materials[i].normalImage = materials[i].normalImage;
+		}
+
+		return cached;
+	}
+
+	bool MeshCache::store(const std::string& filepath, const VulkanModel::Builder& builder) const
+	{
+		if (builder.vertices.size() < 3)
+			return false;
+
+		CacheWriter writer;
+		writer.reserve<FileHeader>(1);
+
+		FileHeader header{};
+		header.magic = CACHE_MAGIC;
+		header.version = VERSION;
+		header.settingsHash = hashSettings(builder);
+
+		// the same steps the builder constructor takes, written into the file instead of staging memory
+		VulkanModel::VertexLayout layout = VulkanModel::resolveVertexLayout(builder);
+		VkIndexType indexType = VulkanModel::resolveIndexType(builder);
+		uint32_t vertexStride = VulkanModel::getVertexStride(layout);
+		uint32_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		header.vertexLayout = static_cast<uint32_t>(layout);
+		header.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		header.indexType = static_cast<uint32_t>(indexType);
+		header.indexCount = builder.indices.empty() ? header.vertexCount : static_cast<uint32_t>(builder.indices.size());
+
+		header.vertexOffset = writer.reserve<unsigned char>(size_t(header.vertexCount) * vertexStride);
+		header.dequantization = VulkanModel::writeVertices(layout, builder.vertices, writer.at(header.vertexOffset));
+
+		header.indexOffset = writer.reserve<unsigned char>(size_t(header.indexCount) * indexSize);
+		VulkanModel::writeIndices(builder, indexType, writer.at(header.indexOffset));
+
+		std::vector<VulkanModel::Submesh> submeshes = VulkanModel::resolveSubmeshes(builder, header.lodCount);
+		header.submeshCount = static_cast<uint32_t>(submeshes.size());
+		header.submeshOffset = writer.append(submeshes.data(), submeshes.size() * sizeof(VulkanModel::Submesh));
+
+		std::vector<Meshlet> meshlets = VulkanModel::resolveMeshlets(builder, header.dequantization);
+		header.meshletCount = static_cast<uint32_t>(meshlets.size());
+		header.meshletOffset = writer.append(meshlets.data(), meshlets.size() * sizeof(Meshlet));
+
+		header.bounds = VulkanModel::resolveBounds(builder);
+		header.cacheStatsBefore = builder.cacheStatsBefore;
+		header.cacheStatsAfter = builder.cacheStatsAfter;
+
+		std::vector<SourceEntry> sources(builder.sourceFiles.size());
+		for (size_t i = 0; i < sources.size(); i++) {
+			const std::string& path = builder.sourceFiles[i];
+
+			std::error_code error;
+			sources[i].size = fs::file_size(path, error);
+			if (error)
+				return false;
+
+			sources[i].writeTime = writeTimeOf(path, error);
+			if (error || !hashFile(path, sources[i].hash))
+				return false;
+
+			sources[i].pathOffset = writer.append(path.data(), path.size());
+			sources[i].pathLength = path.size();
+		}
+
+		std::vector<ImageEntry> images(builder.images.size());
+		for (size_t i = 0; i < images.size(); i++) {
+			const VulkanModel::ImageSource& image = builder.images[i];
+
+			images[i].uriOffset = writer.append(image.uri.data(), image.uri.size());
+			images[i].uriLength = image.uri.size();
+
+			if (image.buffer) {
+				images[i].dataOffset = writer.append(image.buffer->data() + image.byteOffset, image.byteLength);
+				images[i].dataSize = image.byteLength;
+			}
+			else {
+				images[i].dataOffset = writer.append(image.encoded.data(), image.encoded.size());
+				images[i].dataSize = image.encoded.size();
+			}
+		}
+
+		std::vector<MaterialEntry> materials(builder.materials.size());
+		for (size_t i = 0; i < materials.size(); i++) {
+			const VulkanModel::MaterialSource& material = builder.materials[i];
+
+			materials[i].nameOffset = writer.append(material.name.data(), material.name.size());
+			materials[i].nameLength = material.name.size();
+			materials[i].albedoImage = material.albedoImage;
+			materials[i].normalImage = material.normalImage;
+		}
+
+		header.sourceCount = static_cast<uint32_t>(sources.size());
+		header.sourceOffset = writer.append(sources.data(), sources.size() * sizeof(SourceEntry));
+		header.imageCount = static_cast<uint32_t>(images.size());
+		header.imageOffset = writer.append(images.data(), images.size() * sizeof(ImageEntry));
+		header.materialCount = static_cast<uint32_t>(materials.size());
+		header.materialOffset = writer.append(materials.data(), materials.size() * sizeof(MaterialEntry));
+
+		header.fileSize = writer.bytes.size();
+		memcpy(writer.bytes.data(), &header, sizeof(FileHeader));
+
+		return writeFileAtomically(getCachePath(filepath, builder), writer.bytes);
+	}
+
+	MeshCache& GetMeshCache()
+	{
+		static MeshCache instance{};
+		return instance;
+	}
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "VulkanModel.hpp"
+#include "MappedFile.hpp"
+
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace VkRenderer {
+	// a cache file mapped into memory. cooked points straight into the mapping, so this has to outlive the upload
+	class CachedMesh
+	{
+		public:
+			VulkanModel::Cooked cooked{};
+			VertexCacheStats cacheStatsBefore{};
+			VertexCacheStats cacheStatsAfter{};
+
+			// what MaterialManager::importMaterials needs, embedded images come back as encoded bytes
+			std::string directory{};
+			std::vector<VulkanModel::ImageSource> images{};
+			std::vector<VulkanModel::MaterialSource> materials{};
+
+			const std::string& getPath() const { return path; }
+		private:
+			friend class MeshCache;
+
+			MappedFile file;
+			std::string path;
+	};
+
+	/*
+	 * Post processed models on disk (.davmesh), one file per source model and set of load settings.
+	 * Vertex and index data are stored in the layout they are uploaded in and 16 byte aligned, so loading
+	 * one is mapping the file and copying the blobs into staging. A file stays current while every source
+	 * file it was cooked from (the model and its buffers) has the size and write time it had then, or at
+	 * least the same content hash if only the write time moved.
+	 */
+	class MeshCache
+	{
+		public:
+			static constexpr uint32_t VERSION = 4;
+
+			explicit MeshCache(std::string directory = "cache/meshes");
+
+			// nullptr unless a current cache file exists. settings has to be configured like the builder that was stored
+			std::unique_ptr<CachedMesh> load(const std::string& filepath, const VulkanModel::Builder& settings) const;
+			// writes a builder that ran loadModel, returns false if the file couldn't be written
+			bool store(const std::string& filepath, const VulkanModel::Builder& builder) const;
+
+			std::string getCachePath(const std::string& filepath, const VulkanModel::Builder& settings) const;
+			const std::string& getDirectory() const { return directory; }
+		private:
+			std::string directory;
+	};
+
+	MeshCache& GetMeshCache();
+}
@@ -0,0 +1,365 @@
+#include "MeshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace VkRenderer {
+	namespace {
+		constexpr uint32_t FORSYTH_CACHE_SIZE = 32;
+		constexpr uint32_t FORSYTH_MAX_VALENCE = 32;
+		constexpr uint32_t OVERDRAW_CACHE_SIZE = 16;
+
+		// fifo cache simulation, a vertex is cached while fewer than cacheSize misses happened since it was loaded
+		struct FifoCache {
+			std::vector<uint32_t> loadedAt;
+			uint32_t cacheSize;
+			uint32_t time;
+
+			FifoCache(size_t vertexCount, uint32_t cacheSize) : loadedAt(vertexCount, 0), cacheSize{ cacheSize }, time{ cacheSize + 1 } {}
+
+			// returns true on a miss
+			bool access(uint32_t vertex)
+			{
+				if (time - loadedAt[vertex] <= cacheSize)
+					return false;
+
+				loadedAt[vertex] = time++;
+				return true;
+			}
+
+			void flush() { time += cacheSize + 1; }
+		};
+
+		void validateTriangles(const uint32_t* indices, size_t indexCount, size_t vertexCount)
+		{
+			if (indexCount % 3 != 0)
+				throw std::runtime_error("Index count is not a multiple of 3");
+
+			for (size_t i = 0; i < indexCount; ++i)
+				if (indices[i] >= vertexCount)
+					throw std::runtime_error("Vertex index out of range");
+		}
+
+		struct ForsythScores {
+			float cache[FORSYTH_CACHE_SIZE];
+			float valence[FORSYTH_MAX_VALENCE + 1];
+
+			ForsythScores()
+			{
+				// the last triangle's vertices get a fixed score so the next one does not just reuse its edge
+				for (uint32_t i = 0; i < FORSYTH_CACHE_SIZE; ++i)
+					cache[i] = i < 3 ? 0.75f : std::pow(1.0f - float(i - 3) / float(FORSYTH_CACHE_SIZE - 3), 1.5f);
+
+				// vertices with few triangles left are finished first so they leave the working set
+				valence[0] = 0.0f;
+				for (uint32_t i = 1; i <= FORSYTH_MAX_VALENCE; ++i)
+					valence[i] = 2.0f / std::sqrt(float(i));
+			}
+
+			float score(int32_t cachePosition, uint32_t liveTriangles) const
+			{
+				if (liveTriangles == 0)
+					return -1.0f;
+
+				float result = valence[std::min(liveTriangles, FORSYTH_MAX_VALENCE)];
+				if (cachePosition >= 0)
+					result += cache[cachePosition];
+
+				return result;
+			}
+		};
+	}
+
+	VertexCacheStats analyzeVertexCache(const uint32_t* indices, size_t indexCount, size_t vertexCount, uint32_t cacheSize)
+	{
+		VertexCacheStats stats{};
+		if (indexCount < 3)
+			return stats;
+
+		validateTriangles(indices, indexCount, vertexCount);
+
+		FifoCache cache(vertexCount, cacheSize);
+		std::vector<bool> referenced(vertexCount, false);
+		size_t misses = 0;
+		size_t uniqueVertices = 0;
+
+		for (size_t i = 0; i < indexCount; ++i) {
+			if (cache.access(indices[i]))
+				misses++;
+
+			if (!referenced[indices[i]]) {
+				referenced[indices[i]] = true;
+				uniqueVertices++;
+			}
+		}
+
+		stats.acmr = float(misses) / float(indexCount / 3);
+		stats.atvr = float(misses) / float(uniqueVertices);
+		return stats;
+	}
+
+	void optimizeVertexCache(uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		if (indexCount < 6)
+			return;
+
+		validateTriangles(indices, indexCount, vertexCount);
+
+		static const ForsythScores scores{};
+		const size_t triangleCount = indexCount / 3;
+
+		// triangles of every vertex, the live ones are kept at the front of each list
+		std::vector<uint32_t> liveTriangles(vertexCount, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			liveTriangles[indices[i]]++;
+
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffsets[v + 1] = adjacencyOffsets[v] + liveTriangles[v];
+
+		std::vector<uint32_t> adjacency(indexCount);
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indexCount; ++i)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		std::vector<int32_t> cachePosition(vertexCount, -1);
+		std::vector<float> vertexScores(vertexCount);
+		for (size_t v = 0; v < vertexCount; ++v)
+			vertexScores[v] = scores.score(-1, liveTriangles[v]);
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> output(indexCount);
+
+		std::vector<uint32_t> cache;
+		std::vector<uint32_t> nextCache;
+		cache.reserve(FORSYTH_CACHE_SIZE + 3);
+		nextCache.reserve(FORSYTH_CACHE_SIZE + 3);
+
+		auto triangleScore = [&](uint32_t triangle) {
+			const uint32_t* corners = indices + size_t(triangle) * 3;
+			return vertexScores[corners[0]] + vertexScores[corners[1]] + vertexScores[corners[2]];
+		};
+
+		// start with the best triangle overall, after that only the ones touching the cache are candidates
+		uint32_t best = 0;
+		float bestScore = triangleScore(0);
+		for (uint32_t t = 1; t < triangleCount; ++t) {
+			float score = triangleScore(t);
+			if (score > bestScore) {
+				best = t;
+				bestScore = score;
+			}
+		}
+
+		size_t cursor = 0;
+
+		for (size_t written = 0; written < triangleCount; ++written) {
+			if (best == ~0u) {
+				// nothing in the cache has triangles left, continue with the next one in input order
+				while (emitted[cursor])
+					cursor++;
+				best = static_cast<uint32_t>(cursor);
+			}
+
+			const uint32_t* corners = indices + size_t(best) * 3;
+			std::memcpy(&output[written * 3], corners, 3 * sizeof(uint32_t));
+			emitted[best] = true;
+
+			for (uint32_t k = 0; k < 3; ++k) {
+				uint32_t vertex = corners[k];
+				uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+				uint32_t* last = list + liveTriangles[vertex] - 1;
+
+				// a degenerate triangle is listed once per corner, every corner removes one entry
+				uint32_t* found = std::find(list, last + 1, best);
+				if (found != last + 1) {
+					std::swap(*found, *last);
+					liveTriangles[vertex]--;
+				}
+			}
+
+			nextCache.assign(corners, corners + 3);
+			for (uint32_t vertex : cache)
+				if (vertex != corners[0] && vertex != corners[1] && vertex != corners[2])
+					nextCache.push_back(vertex);
+
+			for (size_t i = 0; i < nextCache.size(); ++i) {
+				uint32_t vertex = nextCache[i];
+				cachePosition[vertex] = i < FORSYTH_CACHE_SIZE ? static_cast<int32_t>(i) : -1;
+				vertexScores[vertex] = scores.score(cachePosition[vertex], liveTriangles[vertex]);
+			}
+
+			if (nextCache.size() > FORSYTH_CACHE_SIZE)
+				nextCache.resize(FORSYTH_CACHE_SIZE);
+			std::swap(cache, nextCache);
+
+			best = ~0u;
+			bestScore = -1.0f;
+			for (uint32_t vertex : cache) {
+				const uint32_t* list = adjacency.data() + adjacencyOffsets[vertex];
+				for (uint32_t i = 0; i < liveTriangles[vertex]; ++i) {
+					float score = triangleScore(list[i]);
+					if (score > bestScore) {
+						best = list[i];
+						bestScore = score;
+					}
+				}
+			}
+		}
+
+		std::memcpy(indices, output.data(), indexCount * sizeof(uint32_t));
+	}
+
+	void optimizeOverdraw(uint32_t* indices, size_t indexCount, const float* positions, size_t vertexCount, size_t positionStride, float threshold)
+	{
+		if (indexCount < 6)
+			return;
+
+		validateTriangles(indices, indexCount, vertexCount);
+
+		const size_t triangleCount = indexCount / 3;
+
+		// hard boundaries, triangles where all three vertices miss the cache
+		std::vector<size_t> hardClusters;
+		{
+			FifoCache cache(vertexCount, OVERDRAW_CACHE_SIZE);
+			for (size_t t = 0; t < triangleCount; ++t) {
+				uint32_t misses = 0;
+				for (uint32_t k = 0; k < 3; ++k)
+					misses += cache.access(indices[t * 3 + k]);
+
+				if (t == 0 || misses == 3)
+					hardClusters.push_back(t);
+			}
+			hardClusters.push_back(triangleCount);
+		}
+
+		// soft boundaries, split again wherever the piece so far is already about as cache friendly as the whole cluster
+		std::vector<size_t> clusters;
+		{
+			FifoCache cache(vertexCount, OVERDRAW_CACHE_SIZE);
+
+			for (size_t c = 0; c + 1 < hardClusters.size(); ++c) {
+				size_t begin = hardClusters[c];
+				size_t end = hardClusters[c + 1];
+
+				cache.flush();
+				size_t clusterMisses = 0;
+				for (size_t i = begin * 3; i < end * 3; ++i)
+					clusterMisses += cache.access(indices[i]);
+
+				float limit = float(clusterMisses) / float(end - begin) * threshold;
+
+				cache.flush();
+				size_t pieceBegin = begin;
+				size_t pieceMisses = 0;
+				clusters.push_back(begin);
+
+				for (size_t t = begin; t < end; ++t) {
+					for (uint32_t k = 0; k < 3; ++k)
+						pieceMisses += cache.access(indices[t * 3 + k]);
+
+					if (t + 1 < end && float(pieceMisses) / float(t + 1 - pieceBegin) <= limit) {
+						cache.flush();
+						pieceBegin = t + 1;
+						pieceMisses = 0;
+						clusters.push_back(pieceBegin);
+					}
+				}
+			}
+			clusters.push_back(triangleCount);
+		}
+
+		const size_t clusterCount = clusters.size() - 1;
+
+		auto position = [&](uint32_t vertex) { return positions + size_t(vertex) * positionStride; };
+
+		// area weighted centroids and summed normals, accumulated in a fixed order so the result is reproducible
+		std::vector<float> clusterData(clusterCount * 6, 0.0f);
+		std::vector<float> clusterArea(clusterCount, 0.0f);
+		float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+		float meshArea = 0.0f;
+
+		for (size_t c = 0; c < clusterCount; ++c) {
+			float* centroid = &clusterData[c * 6];
+			float* normal = &clusterData[c * 6 + 3];
+
+			for (size_t t = clusters[c]; t < clusters[c + 1]; ++t) {
+				const float* a = position(indices[t * 3 + 0]);
+				const float* b = position(indices[t * 3 + 1]);
+				const float* d = position(indices[t * 3 + 2]);
+
+				float e1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+				float e2[3] = { d[0] - a[0], d[1] - a[1], d[2] - a[2] };
+				float n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+				float area = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+
+				for (uint32_t k = 0; k < 3; ++k) {
+					centroid[k] += (a[k] + b[k] + d[k]) / 3.0f * area;
+					normal[k] += n[k];
+				}
+				clusterArea[c] += area;
+			}
+
+			for (uint32_t k = 0; k < 3; ++k)
+				meshCentroid[k] += centroid[k];
+			meshArea += clusterArea[c];
+
+			if (clusterArea[c] > 0.0f)
+				for (uint32_t k = 0; k < 3; ++k)
+					centroid[k] /= clusterArea[c];
+		}
+
+		if (meshArea > 0.0f)
+			for (uint32_t k = 0; k < 3; ++k)
+				meshCentroid[k] /= meshArea;
+
+		// clusters pointing away from the middle are in front of the rest from most views, so they go first
+		std::vector<float> sortKeys(clusterCount, 0.0f);
+		for (size_t c = 0; c < clusterCount; ++c) {
+			const float* centroid = &clusterData[c * 6];
+			const float* normal = &clusterData[c * 6 + 3];
+
+			float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+			if (length == 0.0f)
+				continue;
+
+			for (uint32_t k = 0; k < 3; ++k)
+				sortKeys[c] += (centroid[k] - meshCentroid[k]) * normal[k] / length;
+		}
+
+		std::vector<uint32_t> order(clusterCount);
+		std::iota(order.begin(), order.end(), 0u);
+		std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return sortKeys[a] > sortKeys[b]; });
+
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+		for (uint32_t c : order)
+			output.insert(output.end(), indices + clusters[c] * 3, indices + clusters[c + 1] * 3);
+
+		std::memcpy(indices, output.data(), indexCount * sizeof(uint32_t));
+	}
+
+	size_t optimizeVertexFetchRemap(uint32_t* remap, uint32_t* indices, size_t indexCount, size_t vertexCount)
+	{
+		std::fill(remap, remap + vertexCount, ~0u);
+
+		uint32_t next = 0;
+		for (size_t i = 0; i < indexCount; ++i) {
+			uint32_t vertex = indices[i];
+			if (vertex >= vertexCount)
+				throw std::runtime_error("Vertex index out of range");
+
+			if (remap[vertex] == ~0u)
+				remap[vertex] = next++;
+
+			indices[i] = remap[vertex];
+		}
+
+		return next;
+	}
+}
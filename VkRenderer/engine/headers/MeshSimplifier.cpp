@@ -0,0 +1,399 @@
+#include "MeshSimplifier.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <stdexcept>
+#include <vector>
+
+namespace VkRenderer {
+	namespace {
+		struct Vector3 {
+			float x, y, z;
+		};
+
+		Vector3 subtract(const Vector3& a, const Vector3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		Vector3 cross(const Vector3& a, const Vector3& b) { return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x }; }
+		float dot(const Vector3& a, const Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+		// sum of area weighted squared plane distances, symmetric so only half of the 4x4 matrix is kept
+		struct Quadric {
+			float a00 = 0, a11 = 0, a22 = 0, a01 = 0, a02 = 0, a12 = 0;
+			float b0 = 0, b1 = 0, b2 = 0;
+			float c = 0;
+			float weight = 0;
+
+			void addPlane(const Vector3& n, float d, float w)
+			{
+				a00 += w * n.x * n.x; a11 += w * n.y * n.y; a22 += w * n.z * n.z;
+				a01 += w * n.x * n.y; a02 += w * n.x * n.z; a12 += w * n.y * n.z;
+				b0 += w * n.x * d; b1 += w * n.y * d; b2 += w * n.z * d;
+				c += w * d * d;
+				weight += w;
+			}
+
+			void add(const Quadric& q)
+			{
+				a00 += q.a00; a11 += q.a11; a22 += q.a22;
+				a01 += q.a01; a02 += q.a02; a12 += q.a12;
+				b0 += q.b0; b1 += q.b1; b2 += q.b2;
+				c += q.c;
+				weight += q.weight;
+			}
+
+			// average squared distance of p to the planes
+			float evaluate(const Vector3& p) const
+			{
+				if (weight <= 0.0f)
+					return 0.0f;
+
+				float rx = a00 * p.x + a01 * p.y + a02 * p.z;
+				float ry = a01 * p.x + a11 * p.y + a12 * p.z;
+				float rz = a02 * p.x + a12 * p.y + a22 * p.z;
+				float error = rx * p.x + ry * p.y + rz * p.z + 2.0f * (b0 * p.x + b1 * p.y + b2 * p.z) + c;
+				return std::fabs(error) / weight;
+			}
+		};
+
+		struct Collapse {
+			uint32_t from; // position groups
+			uint32_t to;
+			float cost;
+			float geometricError;
+		};
+	}
+
+	size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* vertexData, size_t vertexCount, size_t vertexStride,
+		size_t attributeOffset, const float* attributeWeights, size_t attributeCount, size_t targetIndexCount, float targetError, float* resultError)
+	{
+		if (indexCount % 3 != 0)
+			throw std::runtime_error("Index count is not a multiple of 3");
+
+		for (size_t i = 0; i < indexCount; ++i)
+			if (indices[i] >= vertexCount)
+				throw std::runtime_error("Vertex index out of range");
+
+		if (resultError)
+			*resultError = 0.0f;
+
+		std::vector<uint32_t> result(indices, indices + indexCount);
+
+		if (indexCount <= targetIndexCount || indexCount == 0) {
+			std::copy(result.begin(), result.end(), destination);
+			return indexCount;
+		}
+
+		auto readPosition = [&](uint32_t vertex) {
+			const float* v = vertexData + size_t(vertex) * vertexStride;
+			return Vector3{ v[0], v[1], v[2] };
+		};
+
+		// errors are measured with the mesh scaled into a unit box, so targetError means the same for every mesh
+		Vector3 minimum = readPosition(indices[0]);
+		Vector3 maximum = minimum;
+		for (size_t i = 1; i < indexCount; ++i) {
+			Vector3 p = readPosition(indices[i]);
+			minimum = { std::min(minimum.x, p.x), std::min(minimum.y, p.y), std::min(minimum.z, p.z) };
+			maximum = { std::max(maximum.x, p.x), std::max(maximum.y, p.y), std::max(maximum.z, p.z) };
+		}
+
+		float extent = std::max({ maximum.x - minimum.x, maximum.y - minimum.y, maximum.z - minimum.z });
+		float scale = extent > 0.0f ? 1.0f / extent : 1.0f;
+
+		// vertices with the same position (uv seams, hard edges) form one group and collapse as one
+		std::vector<uint32_t> order(vertexCount);
+		std::iota(order.begin(), order.end(), 0);
+		std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+			const float* pa = vertexData + size_t(a) * vertexStride;
+			const float* pb = vertexData + size_t(b) * vertexStride;
+			for (int k = 0; k < 3; ++k)
+				if (pa[k] != pb[k])
+					return pa[k] < pb[k];
+			return a < b;
+		});
+
+		std::vector<uint32_t> group(vertexCount);
+		std::vector<uint32_t> groupFirst;
+		std::vector<Vector3> groupPosition;
+
+		for (size_t i = 0; i < vertexCount; ++i) {
+			uint32_t vertex = order[i];
+			Vector3 p = readPosition(vertex);
+
+			if (groupFirst.empty() || dot(subtract(p, readPosition(order[i - 1])), subtract(p, readPosition(order[i - 1]))) != 0.0f) {
+				groupFirst.push_back(static_cast<uint32_t>(i));
+				groupPosition.push_back({ (p.x - minimum.x) * scale, (p.y - minimum.y) * scale, (p.z - minimum.z) * scale });
+			}
+
+			group[vertex] = static_cast<uint32_t>(groupFirst.size() - 1);
+		}
+
+		const size_t groupCount = groupFirst.size();
+		groupFirst.push_back(static_cast<uint32_t>(vertexCount));
+
+		// triangles without area are dropped up front, every triangle touches three different groups from here on
+		auto degenerate = [&](uint32_t a, uint32_t b, uint32_t c) {
+			return group[a] == group[b] || group[b] == group[c] || group[a] == group[c];
+		};
+
+		size_t kept = 0;
+		for (size_t i = 0; i < indexCount; i += 3) {
+			if (degenerate(result[i + 0], result[i + 1], result[i + 2]))
+				continue;
+
+			result[kept++] = result[i + 0];
+			result[kept++] = result[i + 1];
+			result[kept++] = result[i + 2];
+		}
+		result.resize(kept);
+
+		std::vector<Quadric> quadrics(groupCount);
+		for (size_t i = 0; i < result.size(); i += 3) {
+			const Vector3& p0 = groupPosition[group[result[i + 0]]];
+			const Vector3& p1 = groupPosition[group[result[i + 1]]];
+			const Vector3& p2 = groupPosition[group[result[i + 2]]];
+
+			Vector3 normal = cross(subtract(p1, p0), subtract(p2, p0));
+			float length = std::sqrt(dot(normal, normal));
+			if (length == 0.0f)
+				continue;
+
+			normal = { normal.x / length, normal.y / length, normal.z / length };
+			float d = -dot(normal, p0);
+
+			for (int k = 0; k < 3; ++k)
+				quadrics[group[result[i + k]]].addPlane(normal, d, length * 0.5f);
+		}
+
+		// an edge that isn't shared by exactly two triangles is a border or non manifold, its ends never move
+		std::vector<bool> locked(groupCount, false);
+		{
+			std::vector<std::pair<uint32_t, uint32_t>> edges;
+			edges.reserve(result.size());
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; ++k) {
+					uint32_t a = group[result[i + k]];
+					uint32_t b = group[result[i + (k + 1) % 3]];
+					if (a != b)
+						edges.emplace_back(std::min(a, b), std::max(a, b));
+				}
+			}
+
+			std::sort(edges.begin(), edges.end());
+			for (size_t i = 0; i < edges.size();) {
+				size_t run = 1;
+				while (i + run < edges.size() && edges[i + run] == edges[i])
+					run++;
+
+				if (run != 2)
+					locked[edges[i].first] = locked[edges[i].second] = true;
+				i += run;
+			}
+		}
+
+		auto attributeDistance = [&](uint32_t a, uint32_t b) {
+			const float* va = vertexData + size_t(a) * vertexStride + attributeOffset;
+			const float* vb = vertexData + size_t(b) * vertexStride + attributeOffset;
+			float distance = 0.0f;
+			for (size_t k = 0; k < attributeCount; ++k) {
+				float delta = (va[k] - vb[k]) * attributeWeights[k];
+				distance += delta * delta;
+			}
+			return distance;
+		};
+
+		std::vector<bool> referenced(vertexCount);
+
+		// the wedge of group to that is closest to vertex in attributes
+		auto closestWedge = [&](uint32_t vertex, uint32_t to, float& distance) {
+			uint32_t best = ~0u;
+			distance = 0.0f;
+			for (uint32_t i = groupFirst[to]; i < groupFirst[to + 1]; ++i) {
+				uint32_t wedge = order[i];
+				if (!referenced[wedge])
+					continue;
+
+				float d = attributeDistance(vertex, wedge);
+				if (best == ~0u || d < distance) {
+					best = wedge;
+					distance = d;
+				}
+			}
+			return best;
+		};
+
+		const float errorLimit = targetError * targetError;
+		float maxError = 0.0f;
+
+		std::vector<uint32_t> remap(vertexCount);
+		std::vector<uint32_t> adjacencyOffsets(groupCount + 1);
+		std::vector<uint32_t> adjacency;
+		std::vector<Collapse> collapses;
+		std::vector<bool> touched(groupCount);
+
+		// every pass collapses the cheapest edges that don't share a neighbourhood, then rebuilds the triangles
+		while (result.size() > targetIndexCount) {
+			std::fill(referenced.begin(), referenced.end(), false);
+			for (uint32_t index : result)
+				referenced[index] = true;
+
+			std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+			for (uint32_t index : result)
+				adjacencyOffsets[group[index] + 1]++;
+			for (size_t g = 0; g < groupCount; ++g)
+				adjacencyOffsets[g + 1] += adjacencyOffsets[g];
+
+			adjacency.resize(result.size());
+			std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (size_t i = 0; i < result.size(); ++i)
+				adjacency[fill[group[result[i]]]++] = static_cast<uint32_t>(i / 3);
+
+			collapses.clear();
+			for (size_t i = 0; i < result.size(); i += 3) {
+				for (int k = 0; k < 3; ++k) {
+					uint32_t a = group[result[i + k]];
+					uint32_t b = group[result[i + (k + 1) % 3]];
+					if (a == b)
+						continue;
+
+					if (!locked[a])
+						collapses.push_back({ a, b, 0.0f, 0.0f });
+					if (!locked[b])
+						collapses.push_back({ b, a, 0.0f, 0.0f });
+				}
+			}
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.from != b.from ? a.from < b.from : a.to < b.to;
+			});
+			collapses.erase(std::unique(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				return a.from == b.from && a.to == b.to;
+			}), collapses.end());
+
+			for (Collapse& collapse : collapses) {
+				Quadric quadric = quadrics[collapse.from];
+				quadric.add(quadrics[collapse.to]);
+				collapse.geometricError = quadric.evaluate(groupPosition[collapse.to]);
+
+				// the worst wedge decides, a seam only collapses along itself
+				float attributeError = 0.0f;
+				for (uint32_t i = groupFirst[collapse.from]; i < groupFirst[collapse.from + 1]; ++i) {
+					uint32_t vertex = order[i];
+					if (!referenced[vertex])
+						continue;
+
+					float distance;
+					closestWedge(vertex, collapse.to, distance);
+					attributeError = std::max(attributeError, distance);
+				}
+
+				collapse.cost = collapse.geometricError + attributeError;
+			}
+
+			// only the cheapest way out of every group can win, the others would find it touched
+			size_t cheapest = 0;
+			for (size_t i = 0; i < collapses.size(); ++i) {
+				if (i > 0 && collapses[i].from == collapses[cheapest - 1].from) {
+					if (collapses[i].cost < collapses[cheapest - 1].cost)
+						collapses[cheapest - 1] = collapses[i];
+				}
+				else
+					collapses[cheapest++] = collapses[i];
+			}
+			collapses.resize(cheapest);
+
+			std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) {
+				if (a.cost != b.cost)
+					return a.cost < b.cost;
+				return a.from != b.from ? a.from < b.from : a.to < b.to;
+			});
+
+			std::iota(remap.begin(), remap.end(), 0);
+			std::fill(touched.begin(), touched.end(), false);
+
+			size_t removeGoal = (result.size() - targetIndexCount + 2) / 3;
+			size_t removed = 0;
+			size_t applied = 0;
+
+			for (const Collapse& collapse : collapses) {
+				if (removed >= removeGoal || collapse.cost > errorLimit)
+					break;
+
+				if (touched[collapse.from] || touched[collapse.to])
+					continue;
+
+				// nothing around from may have moved this pass, and no remaining triangle may turn over
+				bool valid = true;
+				for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1] && valid; ++i) {
+					const uint32_t* corners = result.data() + size_t(adjacency[i]) * 3;
+					Vector3 before[3], after[3];
+					bool vanishes = false;
+
+					for (int k = 0; k < 3; ++k) {
+						uint32_t g = group[corners[k]];
+						valid = valid && !touched[g];
+						vanishes = vanishes || g == collapse.to;
+						before[k] = groupPosition[g];
+						after[k] = g == collapse.from ? groupPosition[collapse.to] : before[k];
+					}
+
+					if (!valid || vanishes)
+						continue;
+
+					Vector3 oldNormal = cross(subtract(before[1], before[0]), subtract(before[2], before[0]));
+					Vector3 newNormal = cross(subtract(after[1], after[0]), subtract(after[2], after[0]));
+					valid = dot(oldNormal, newNormal) > 0.0f;
+				}
+
+				if (!valid)
+					continue;
+
+				for (uint32_t i = adjacencyOffsets[collapse.from]; i < adjacencyOffsets[collapse.from + 1]; ++i) {
+					const uint32_t* corners = result.data() + size_t(adjacency[i]) * 3;
+					bool vanishes = false;
+					for (int k = 0; k < 3; ++k) {
+						touched[group[corners[k]]] = true;
+						vanishes = vanishes || group[corners[k]] == collapse.to;
+					}
+					if (vanishes)
+						removed++;
+				}
+
+				for (uint32_t i = groupFirst[collapse.from]; i < groupFirst[collapse.from + 1]; ++i) {
+					uint32_t vertex = order[i];
+					if (!referenced[vertex])
+						continue;
+
+					float distance;
+					remap[vertex] = closestWedge(vertex, collapse.to, distance);
+				}
+
+				quadrics[collapse.to].add(quadrics[collapse.from]);
+				maxError = std::max(maxError, collapse.geometricError);
+				applied++;
+			}
+
+			if (applied == 0)
+				break;
+
+			// triangles that lost their area are gone
+			size_t written = 0;
+			for (size_t i = 0; i < result.size(); i += 3) {
+				uint32_t a = remap[result[i + 0]], b = remap[result[i + 1]], c = remap[result[i + 2]];
+				if (degenerate(a, b, c))
+					continue;
+
+				result[written++] = a;
+				result[written++] = b;
+				result[written++] = c;
+			}
+			result.resize(written);
+		}
+
+		if (resultError)
+			*resultError = std::sqrt(maxError) * extent;
+
+		std::copy(result.begin(), result.end(), destination);
+		return result.size();
+	}
+}
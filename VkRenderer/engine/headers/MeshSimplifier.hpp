@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VkRenderer {
+	/*
+	 * Simplifies a triangle list by collapsing edges in quadric error order (Garland-Heckbert) until it is down to
+	 * targetIndexCount indices or the next collapse would cost more than targetError. Vertices are only ever merged
+	 * into existing ones, so the result indexes the same vertex buffer and can be drawn as an extra index range.
+	 *
+	 * vertexData is read as vertexStride floats per vertex with the position in the first three. attributeCount floats
+	 * starting at attributeOffset (normals, uvs, ...) are compared between merged vertices, scaled by attributeWeights,
+	 * and add to the cost, so seams and hard edges hold up longer than flat areas. Vertices sharing a position move
+	 * together and open borders stay where they are.
+	 *
+	 * targetError is relative to the mesh extent, resultError gets the largest geometric error in model units.
+	 * destination needs room for indexCount indices and may alias indices. Deterministic, returns the new index count.
+	 */
+	size_t simplifyMesh(uint32_t* destination, const uint32_t* indices, size_t indexCount, const float* vertexData, size_t vertexCount, size_t vertexStride,
+		size_t attributeOffset, const float* attributeWeights, size_t attributeCount, size_t targetIndexCount, float targetError, float* resultError = nullptr);
+}
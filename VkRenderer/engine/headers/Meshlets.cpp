@@ -0,0 +1,188 @@
+#include "Meshlets.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace VkRenderer {
+	namespace {
+		glm::vec3 readVec3(const float* data, size_t stride, uint32_t vertex)
+		{
+			const float* v = data + size_t(vertex) * stride;
+			return glm::vec3(v[0], v[1], v[2]);
+		}
+
+		Meshlet computeBounds(const uint32_t* indices, size_t indexCount, const float* positions, const float* normals, size_t stride)
+		{
+			Meshlet meshlet{};
+
+			glm::vec3 minimum = readVec3(positions, stride, indices[0]);
+			glm::vec3 maximum = minimum;
+			for (size_t i = 1; i < indexCount; ++i) {
+				glm::vec3 position = readVec3(positions, stride, indices[i]);
+				minimum = glm::min(minimum, position);
+				maximum = glm::max(maximum, position);
+			}
+
+			glm::vec3 center = (minimum + maximum) * 0.5f;
+			float radius = 0.0f;
+			for (size_t i = 0; i < indexCount; ++i)
+				radius = std::max(radius, glm::length(readVec3(positions, stride, indices[i]) - center));
+
+			meshlet.sphere = glm::vec4(center, radius);
+
+			// face normals, turned to agree with the vertex normals so the winding convention doesn't matter
+			std::vector<glm::vec3> faceNormals;
+			faceNormals.reserve(indexCount / 3);
+			glm::vec3 axis(0.0f);
+
+			for (size_t i = 0; i < indexCount; i += 3) {
+				glm::vec3 a = readVec3(positions, stride, indices[i + 0]);
+				glm::vec3 b = readVec3(positions, stride, indices[i + 1]);
+				glm::vec3 c = readVec3(positions, stride, indices[i + 2]);
+
+				glm::vec3 normal = glm::cross(b - a, c - a);
+				float length = glm::length(normal);
+				if (length == 0.0f)
+					continue;
+
+				normal /= length;
+				if (normals) {
+					glm::vec3 shading = readVec3(normals, stride, indices[i + 0]) + readVec3(normals, stride, indices[i + 1]) + readVec3(normals, stride, indices[i + 2]);
+					if (glm::dot(normal, shading) < 0.0f)
+						normal = -normal;
+				}
+
+				faceNormals.push_back(normal);
+				axis += normal;
+			}
+
+			float axisLength = glm::length(axis);
+			if (faceNormals.empty() || axisLength == 0.0f)
+				return meshlet;
+
+			axis /= axisLength;
+
+			float minDot = 1.0f;
+			for (const glm::vec3& normal : faceNormals)
+				minDot = std::min(minDot, glm::dot(normal, axis));
+
+			// wider than ~85 degrees is almost never culled, not worth the test
+			if (minDot <= 0.1f)
+				return meshlet;
+
+			meshlet.cone = glm::vec4(axis, std::sqrt(1.0f - minDot * minDot));
+			return meshlet;
+		}
+	}
+
+	void buildMeshlets(uint32_t* indices, size_t indexCount, const float* positions, const float* normals, size_t vertexCount, size_t stride,
+		std::vector<Meshlet>& meshlets, uint32_t maxVertices, uint32_t maxTriangles)
+	{
+		if (indexCount % 3 != 0)
+			throw std::runtime_error("Index count is not a multiple of 3");
+
+		if (maxVertices < 3 || maxTriangles < 1)
+			throw std::runtime_error("Meshlet limits are too small");
+
+		for (size_t i = 0; i < indexCount; ++i)
+			if (indices[i] >= vertexCount)
+				throw std::runtime_error("Vertex index out of range");
+
+		const size_t triangleCount = indexCount / 3;
+		if (triangleCount == 0)
+			return;
+
+		// triangles of every vertex
+		std::vector<uint32_t> adjacencyOffsets(vertexCount + 1, 0);
+		for (size_t i = 0; i < indexCount; ++i)
+			adjacencyOffsets[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; ++v)
+			adjacencyOffsets[v + 1] += adjacencyOffsets[v];
+
+		std::vector<uint32_t> adjacency(indexCount);
+		std::vector<uint32_t> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+		for (size_t i = 0; i < indexCount; ++i)
+			adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		std::vector<bool> emitted(triangleCount, false);
+		std::vector<uint32_t> output;
+		output.reserve(indexCount);
+
+		// vertices of the open meshlet, usedBy[v] holds the meshlet id that last took vertex v
+		std::vector<uint32_t> meshletVertices;
+		std::vector<uint32_t> usedBy(vertexCount, ~0u);
+		uint32_t meshletId = 0;
+		size_t meshletBegin = 0;
+		size_t cursor = 0;
+
+		auto newVertexCount = [&](uint32_t triangle) {
+			const uint32_t* corners = indices + size_t(triangle) * 3;
+			uint32_t count = 0;
+			for (uint32_t k = 0; k < 3; ++k) {
+				bool repeated = (k > 0 && corners[k] == corners[0]) || (k > 1 && corners[k] == corners[1]);
+				if (usedBy[corners[k]] != meshletId && !repeated)
+					count++;
+			}
+			return count;
+		};
+
+		auto finishMeshlet = [&]() {
+			Meshlet meshlet = computeBounds(output.data() + meshletBegin, output.size() - meshletBegin, positions, normals, stride);
+			meshlet.firstIndex = static_cast<uint32_t>(meshletBegin);
+			meshlet.indexCount = static_cast<uint32_t>(output.size() - meshletBegin);
+			meshlets.push_back(meshlet);
+
+			meshletBegin = output.size();
+			meshletVertices.clear();
+			meshletId++;
+		};
+
+		for (size_t written = 0; written < triangleCount; ++written) {
+			// the neighbour adding the fewest vertices, ties go to whichever was found first
+			uint32_t best = ~0u;
+			uint32_t bestCost = ~0u;
+
+			for (uint32_t vertex : meshletVertices) {
+				for (uint32_t i = adjacencyOffsets[vertex]; i < adjacencyOffsets[vertex + 1]; ++i) {
+					uint32_t triangle = adjacency[i];
+					if (emitted[triangle])
+						continue;
+
+					uint32_t cost = newVertexCount(triangle);
+					if (cost < bestCost) {
+						best = triangle;
+						bestCost = cost;
+					}
+				}
+			}
+
+			if (best == ~0u) {
+				while (emitted[cursor])
+					cursor++;
+				best = static_cast<uint32_t>(cursor);
+				bestCost = newVertexCount(best);
+			}
+
+			size_t meshletTriangles = (output.size() - meshletBegin) / 3;
+			// a full meshlet is closed and the triangle seeds the next one, which then continues right next to it
+			if (meshletTriangles > 0 && (meshletVertices.size() + bestCost > maxVertices || meshletTriangles >= maxTriangles))
+				finishMeshlet();
+
+			const uint32_t* corners = indices + size_t(best) * 3;
+			for (uint32_t k = 0; k < 3; ++k) {
+				if (usedBy[corners[k]] != meshletId) {
+					usedBy[corners[k]] = meshletId;
+					meshletVertices.push_back(corners[k]);
+				}
+				output.push_back(corners[k]);
+			}
+
+			emitted[best] = true;
+		}
+
+		finishMeshlet();
+
+		std::copy(output.begin(), output.end(), indices);
+	}
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VkRenderer {
+	constexpr uint32_t MESHLET_MAX_VERTICES = 64;
+	constexpr uint32_t MESHLET_MAX_TRIANGLES = 124;
+
+	// a small cluster of triangles that is one contiguous index range. std430, matches Meshlet in meshlet_cull.comp
+	struct Meshlet {
+		glm::vec4 sphere{}; // center, radius
+		glm::vec4 cone{ 0.0f, 0.0f, 0.0f, 1.0f }; // average normal, cutoff. a cutoff of 1 never gets backface culled
+		uint32_t firstIndex = 0;
+		uint32_t indexCount = 0;
+		int32_t vertexOffset = 0;
+		uint32_t padding = 0;
+	};
+
+	/*
+	 * Groups the triangles into meshlets of at most maxVertices unique vertices and maxTriangles triangles and
+	 * reorders the indices so every meshlet is a contiguous range. A meshlet grows into the triangles next to
+	 * the ones it already has, so it stays compact and its bounds stay tight.
+	 * positions and normals are read as 3 floats every stride floats, normals only orient the cone and can be null.
+	 * The meshlets are appended with firstIndex relative to indices and a zero vertexOffset.
+	 */
+	void buildMeshlets(uint32_t* indices, size_t indexCount, const float* positions, const float* normals, size_t vertexCount, size_t stride,
+		std::vector<Meshlet>& meshlets, uint32_t maxVertices = MESHLET_MAX_VERTICES, uint32_t maxTriangles = MESHLET_MAX_TRIANGLES);
+}
@@ -0,0 +1,334 @@
+#include "TangentSpace.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TANGENTS_SSE
+#include <emmintrin.h>
+#endif
+
+namespace VkRenderer {
+	namespace {
+		// vertices per thread pool task, blocks are fixed so the sums don't depend on scheduling
+		constexpr size_t BLOCK_SIZE = 256;
+		constexpr float MIN_LENGTH_SQUARED = 1e-20f;
+		constexpr float PI = 3.14159265358979f;
+
+		struct Vector3 {
+			float x, y, z;
+		};
+
+		Vector3 load(const float* v) { return { v[0], v[1], v[2] }; }
+		Vector3 subtract(const Vector3& a, const Vector3& b) { return { a.x - b.x, a.y - b.y, a.z - b.z }; }
+		Vector3 scale(const Vector3& a, float s) { return { a.x * s, a.y * s, a.z * s }; }
+		float dot(const Vector3& a, const Vector3& b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+		// Abramowitz and Stegun 4.4.46, within 2e-8 of acos and the same on every cpu, unlike the libm one
+		float acosPolynomial(float x)
+		{
+			float a = std::fabs(x);
+			float p = -0.0012624911f;
+			p = p * a + 0.0066700901f;
+			p = p * a - 0.0170881256f;
+			p = p * a + 0.0308918810f;
+			p = p * a - 0.0501743046f;
+			p = p * a + 0.0889789874f;
+			p = p * a - 0.2145988016f;
+			p = p * a + 1.5707963050f;
+			float r = std::sqrt(1.0f - a) * p;
+			return x < 0.0f ? PI - r : r;
+		}
+
+		/*
+		 * Per corner inputs in structure of arrays form. t and b are the triangle's uv directions with the sign of its uv
+		 * area applied (zero without uv area), e1 and e2 the edges leaving the corner, n the corner vertex's normal.
+		 * The contribution is written back into t and b.
+		 */
+		struct CornerStreams {
+			std::vector<float> nx, ny, nz, tx, ty, tz, bx, by, bz, e1x, e1y, e1z, e2x, e2y, e2z;
+
+			void resize(size_t count)
+			{
+				for (std::vector<float>* stream : { &nx, &ny, &nz, &tx, &ty, &tz, &bx, &by, &bz, &e1x, &e1y, &e1z, &e2x, &e2y, &e2z })
+					stream->assign(count, 0.0f);
+			}
+		};
+
+		// t and b projected into the normal plane, normalized and weighted by the corner angle, like mikktspace does
+		void contribution(CornerStreams& s, size_t i)
+		{
+			float lengths = (s.e1x[i] * s.e1x[i] + s.e1y[i] * s.e1y[i] + s.e1z[i] * s.e1z[i]) * (s.e2x[i] * s.e2x[i] + s.e2y[i] * s.e2y[i] + s.e2z[i] * s.e2z[i]);
+			float angle = 0.0f;
+			if (lengths > MIN_LENGTH_SQUARED) {
+				float cosine = (s.e1x[i] * s.e2x[i] + s.e1y[i] * s.e2y[i] + s.e1z[i] * s.e2z[i]) / std::sqrt(lengths);
+				angle = acosPolynomial(std::min(std::max(cosine, -1.0f), 1.0f));
+			}
+
+			float dt = s.nx[i] * s.tx[i] + s.ny[i] * s.ty[i] + s.nz[i] * s.tz[i];
+			float tx = s.tx[i] - s.nx[i] * dt, ty = s.ty[i] - s.ny[i] * dt, tz = s.tz[i] - s.nz[i] * dt;
+			float tLength = tx * tx + ty * ty + tz * tz;
+			float tScale = tLength > MIN_LENGTH_SQUARED ? 1.0f / std::sqrt(tLength) * angle : 0.0f;
+
+			float db = s.nx[i] * s.bx[i] + s.ny[i] * s.by[i] + s.nz[i] * s.bz[i];
+			float bx = s.bx[i] - s.nx[i] * db, by = s.by[i] - s.ny[i] * db, bz = s.bz[i] - s.nz[i] * db;
+			float bLength = bx * bx + by * by + bz * bz;
+			float bScale = bLength > MIN_LENGTH_SQUARED ? 1.0f / std::sqrt(bLength) * angle : 0.0f;
+
+			s.tx[i] = tx * tScale; s.ty[i] = ty * tScale; s.tz[i] = tz * tScale;
+			s.bx[i] = bx * bScale; s.by[i] = by * bScale; s.bz[i] = bz * bScale;
+		}
+
+		// per vertex sums of the contributions, what the orthonormalize step runs over
+		struct VertexBlock {
+			float nx[BLOCK_SIZE], ny[BLOCK_SIZE], nz[BLOCK_SIZE];
+			float tx[BLOCK_SIZE], ty[BLOCK_SIZE], tz[BLOCK_SIZE];
+			float bx[BLOCK_SIZE], by[BLOCK_SIZE], bz[BLOCK_SIZE];
+			float sign[BLOCK_SIZE];
+			bool valid[BLOCK_SIZE];
+		};
+
+		// t -= n * dot(n, t), normalize, sign from which side of cross(n, t) the bitangent is on. writes back into t
+		void orthonormalize(VertexBlock& block, size_t i)
+		{
+			float d = block.nx[i] * block.tx[i] + block.ny[i] * block.ty[i] + block.nz[i] * block.tz[i];
+			float x = block.tx[i] - block.nx[i] * d;
+			float y = block.ty[i] - block.ny[i] * d;
+			float z = block.tz[i] - block.nz[i] * d;
+
+			float lengthSquared = x * x + y * y + z * z;
+			block.valid[i] = lengthSquared > MIN_LENGTH_SQUARED;
+
+			float length = std::sqrt(lengthSquared);
+			x /= length; y /= length; z /= length;
+
+			float cx = block.ny[i] * z - block.nz[i] * y;
+			float cy = block.nz[i] * x - block.nx[i] * z;
+			float cz = block.nx[i] * y - block.ny[i] * x;
+
+			block.tx[i] = x; block.ty[i] = y; block.tz[i] = z;
+			block.sign[i] = cx * block.bx[i] + cy * block.by[i] + cz * block.bz[i] < 0.0f ? -1.0f : 1.0f;
+		}
+
+#ifdef TANGENTS_SSE
+		// the functions above four lanes at a time, op for op so both give the same bits. sqrt and div rather than rsqrt,
+		// the estimate differs between cpus
+		__m128 dot4(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz)
+		{
+			return _mm_add_ps(_mm_add_ps(_mm_mul_ps(ax, bx), _mm_mul_ps(ay, by)), _mm_mul_ps(az, bz));
+		}
+
+		__m128 select4(__m128 mask, __m128 a, __m128 b)
+		{
+			return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+		}
+
+		__m128 acosPolynomial4(__m128 x)
+		{
+			__m128 a = _mm_andnot_ps(_mm_set1_ps(-0.0f), x);
+			__m128 p = _mm_set1_ps(-0.0012624911f);
+			p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0066700901f));
+			p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0170881256f));
+			p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0308918810f));
+			p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0501743046f));
+			p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.0889789874f));
+			p = _mm_sub_ps(_mm_mul_ps(p, a), _mm_set1_ps(0.2145988016f));
+			p = _mm_add_ps(_mm_mul_ps(p, a), _mm_set1_ps(1.5707963050f));
+			__m128 r = _mm_mul_ps(_mm_sqrt_ps(_mm_sub_ps(_mm_set1_ps(1.0f), a)), p);
+			return select4(_mm_cmplt_ps(x, _mm_setzero_ps()), _mm_sub_ps(_mm_set1_ps(PI), r), r);
+		}
+
+		// 1 / |v| * weight where |v|^2 is past the threshold, otherwise 0
+		__m128 inverseLength4(__m128 lengthSquared, __m128 weight)
+		{
+			__m128 inverse = _mm_mul_ps(_mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(lengthSquared)), weight);
+			return _mm_and_ps(_mm_cmpgt_ps(lengthSquared, _mm_set1_ps(MIN_LENGTH_SQUARED)), inverse);
+		}
+
+		void contribution4(CornerStreams& s, size_t i)
+		{
+			__m128 nx = _mm_loadu_ps(&s.nx[i]), ny = _mm_loadu_ps(&s.ny[i]), nz = _mm_loadu_ps(&s.nz[i]);
+			__m128 e1x = _mm_loadu_ps(&s.e1x[i]), e1y = _mm_loadu_ps(&s.e1y[i]), e1z = _mm_loadu_ps(&s.e1z[i]);
+			__m128 e2x = _mm_loadu_ps(&s.e2x[i]), e2y = _mm_loadu_ps(&s.e2y[i]), e2z = _mm_loadu_ps(&s.e2z[i]);
+
+			__m128 lengths = _mm_mul_ps(dot4(e1x, e1y, e1z, e1x, e1y, e1z), dot4(e2x, e2y, e2z, e2x, e2y, e2z));
+			__m128 cosine = _mm_div_ps(dot4(e1x, e1y, e1z, e2x, e2y, e2z), _mm_sqrt_ps(lengths));
+			cosine = _mm_min_ps(_mm_max_ps(cosine, _mm_set1_ps(-1.0f)), _mm_set1_ps(1.0f));
+			__m128 angle = _mm_and_ps(_mm_cmpgt_ps(lengths, _mm_set1_ps(MIN_LENGTH_SQUARED)), acosPolynomial4(cosine));
+
+			__m128 tx = _mm_loadu_ps(&s.tx[i]), ty = _mm_loadu_ps(&s.ty[i]), tz = _mm_loadu_ps(&s.tz[i]);
+			__m128 dt = dot4(nx, ny, nz, tx, ty, tz);
+			tx = _mm_sub_ps(tx, _mm_mul_ps(nx, dt)); ty = _mm_sub_ps(ty, _mm_mul_ps(ny, dt)); tz = _mm_sub_ps(tz, _mm_mul_ps(nz, dt));
+			__m128 tScale = inverseLength4(dot4(tx, ty, tz, tx, ty, tz), angle);
+
+			__m128 bx = _mm_loadu_ps(&s.bx[i]), by = _mm_loadu_ps(&s.by[i]), bz = _mm_loadu_ps(&s.bz[i]);
+			__m128 db = dot4(nx, ny, nz, bx, by, bz);
+			bx = _mm_sub_ps(bx, _mm_mul_ps(nx, db)); by = _mm_sub_ps(by, _mm_mul_ps(ny, db)); bz = _mm_sub_ps(bz, _mm_mul_ps(nz, db));
+			__m128 bScale = inverseLength4(dot4(bx, by, bz, bx, by, bz), angle);
+
+			_mm_storeu_ps(&s.tx[i], _mm_mul_ps(tx, tScale)); _mm_storeu_ps(&s.ty[i], _mm_mul_ps(ty, tScale)); _mm_storeu_ps(&s.tz[i], _mm_mul_ps(tz, tScale));
+			_mm_storeu_ps(&s.bx[i], _mm_mul_ps(bx, bScale)); _mm_storeu_ps(&s.by[i], _mm_mul_ps(by, bScale)); _mm_storeu_ps(&s.bz[i], _mm_mul_ps(bz, bScale));
+		}
+
+		void orthonormalize4(VertexBlock& block, size_t i)
+		{
+			__m128 nx = _mm_loadu_ps(block.nx + i), ny = _mm_loadu_ps(block.ny + i), nz = _mm_loadu_ps(block.nz + i);
+			__m128 tx = _mm_loadu_ps(block.tx + i), ty = _mm_loadu_ps(block.ty + i), tz = _mm_loadu_ps(block.tz + i);
+
+			__m128 d = dot4(nx, ny, nz, tx, ty, tz);
+			__m128 x = _mm_sub_ps(tx, _mm_mul_ps(nx, d));
+			__m128 y = _mm_sub_ps(ty, _mm_mul_ps(ny, d));
+			__m128 z = _mm_sub_ps(tz, _mm_mul_ps(nz, d));
+
+			__m128 lengthSquared = dot4(x, y, z, x, y, z);
+			int valid = _mm_movemask_ps(_mm_cmpgt_ps(lengthSquared, _mm_set1_ps(MIN_LENGTH_SQUARED)));
+
+			__m128 length = _mm_sqrt_ps(lengthSquared);
+			x = _mm_div_ps(x, length); y = _mm_div_ps(y, length); z = _mm_div_ps(z, length);
+
+			__m128 cx = _mm_sub_ps(_mm_mul_ps(ny, z), _mm_mul_ps(nz, y));
+			__m128 cy = _mm_sub_ps(_mm_mul_ps(nz, x), _mm_mul_ps(nx, z));
+			__m128 cz = _mm_sub_ps(_mm_mul_ps(nx, y), _mm_mul_ps(ny, x));
+			__m128 side = dot4(cx, cy, cz, _mm_loadu_ps(block.bx + i), _mm_loadu_ps(block.by + i), _mm_loadu_ps(block.bz + i));
+
+			// -1 where side < 0 by putting the sign bit on 1.0
+			__m128 negative = _mm_and_ps(_mm_cmplt_ps(side, _mm_setzero_ps()), _mm_set1_ps(-0.0f));
+
+			_mm_storeu_ps(block.tx + i, x);
+			_mm_storeu_ps(block.ty + i, y);
+			_mm_storeu_ps(block.tz + i, z);
+			_mm_storeu_ps(block.sign + i, _mm_or_ps(_mm_set1_ps(1.0f), negative));
+
+			for (int lane = 0; lane < 4; lane++)
+				block.valid[i + lane] = (valid >> lane) & 1;
+		}
+#endif
+
+		// for vertices without uvs, any tangent in the normal plane, built off the axis the normal is least aligned with
+		Vector3 perpendicular(const Vector3& n)
+		{
+			Vector3 axis = std::fabs(n.x) < std::fabs(n.y) ? (std::fabs(n.x) < std::fabs(n.z) ? Vector3{ 1, 0, 0 } : Vector3{ 0, 0, 1 })
+				: (std::fabs(n.y) < std::fabs(n.z) ? Vector3{ 0, 1, 0 } : Vector3{ 0, 0, 1 });
+
+			Vector3 t = subtract(axis, scale(n, dot(n, axis)));
+			float lengthSquared = dot(t, t);
+			return lengthSquared > MIN_LENGTH_SQUARED ? scale(t, 1.0f / std::sqrt(lengthSquared)) : Vector3{ 1, 0, 0 };
+		}
+	}
+
+	void generateTangents(float* vertexData, size_t vertexCount, size_t vertexStride, size_t normalOffset, size_t uvOffset, size_t tangentOffset,
+		const uint32_t* indices, size_t indexCount)
+	{
+		size_t cornerCount = indexCount - indexCount % 3;
+
+		// corners of every vertex in index order, a counting sort so each vertex is summed by one thread without atomics
+		std::vector<uint32_t> cornerStart(vertexCount + 1, 0);
+		for (size_t i = 0; i < cornerCount; i++)
+			cornerStart[indices[i] + 1]++;
+		for (size_t v = 0; v < vertexCount; v++)
+			cornerStart[v + 1] += cornerStart[v];
+
+		std::vector<uint32_t> corners(cornerCount);
+		std::vector<uint32_t> cursor(cornerStart.begin(), cornerStart.end() - 1);
+		for (size_t i = 0; i < cornerCount; i++)
+			corners[cursor[indices[i]]++] = static_cast<uint32_t>(i);
+
+		GetThreadPool().parallelFor((vertexCount + BLOCK_SIZE - 1) / BLOCK_SIZE, [&](size_t blockIndex) {
+			size_t first = blockIndex * BLOCK_SIZE;
+			size_t count = std::min(vertexCount, first + BLOCK_SIZE) - first;
+
+			// gather what the block's corners need, the triangle is looked at again for each of its corners
+			uint32_t firstCorner = cornerStart[first];
+			size_t blockCorners = cornerStart[first + count] - firstCorner;
+
+			CornerStreams s;
+			s.resize((blockCorners + 3) & ~size_t(3));
+
+			for (size_t i = 0; i < count; i++) {
+				const float* v0 = vertexData + (first + i) * vertexStride;
+
+				for (uint32_t c = cornerStart[first + i]; c < cornerStart[first + i + 1]; c++) {
+					uint32_t corner = corners[c];
+					uint32_t triangle = corner - corner % 3;
+					size_t k = c - firstCorner;
+
+					// rotated so v0 is this corner
+					const float* v1 = vertexData + indices[triangle + (corner + 1) % 3] * vertexStride;
+					const float* v2 = vertexData + indices[triangle + (corner + 2) % 3] * vertexStride;
+
+					s.nx[k] = v0[normalOffset]; s.ny[k] = v0[normalOffset + 1]; s.nz[k] = v0[normalOffset + 2];
+
+					float du1 = v1[uvOffset] - v0[uvOffset], dv1 = v1[uvOffset + 1] - v0[uvOffset + 1];
+					float du2 = v2[uvOffset] - v0[uvOffset], dv2 = v2[uvOffset + 1] - v0[uvOffset + 1];
+
+					// only the sign of the uv area matters, everything gets normalized. no area, no direction
+					float area = du1 * dv2 - du2 * dv1;
+					if (area == 0.0f || !std::isfinite(area))
+						continue;
+
+					float orientation = area > 0.0f ? 1.0f : -1.0f;
+					Vector3 e1 = subtract(load(v1), load(v0));
+					Vector3 e2 = subtract(load(v2), load(v0));
+					Vector3 t = scale(subtract(scale(e1, dv2), scale(e2, dv1)), orientation);
+					Vector3 b = scale(subtract(scale(e2, du1), scale(e1, du2)), orientation);
+
+					s.tx[k] = t.x; s.ty[k] = t.y; s.tz[k] = t.z;
+					s.bx[k] = b.x; s.by[k] = b.y; s.bz[k] = b.z;
+					s.e1x[k] = e1.x; s.e1y[k] = e1.y; s.e1z[k] = e1.z;
+					s.e2x[k] = e2.x; s.e2y[k] = e2.y; s.e2z[k] = e2.z;
+				}
+			}
+
+			size_t k = 0;
+#ifdef TANGENTS_SSE
+			for (; k + 4 <= blockCorners; k += 4)
+				contribution4(s, k);
+#endif
+			for (; k < blockCorners; k++)
+				contribution(s, k);
+
+			VertexBlock block;
+			for (size_t i = 0; i < count; i++) {
+				const float* normal = vertexData + (first + i) * vertexStride + normalOffset;
+				block.nx[i] = normal[0]; block.ny[i] = normal[1]; block.nz[i] = normal[2];
+				block.tx[i] = block.ty[i] = block.tz[i] = 0.0f;
+				block.bx[i] = block.by[i] = block.bz[i] = 0.0f;
+
+				for (uint32_t c = cornerStart[first + i]; c < cornerStart[first + i + 1]; c++) {
+					k = c - firstCorner;
+					block.tx[i] += s.tx[k]; block.ty[i] += s.ty[k]; block.tz[i] += s.tz[k];
+					block.bx[i] += s.bx[k]; block.by[i] += s.by[k]; block.bz[i] += s.bz[k];
+				}
+			}
+
+			size_t i = 0;
+#ifdef TANGENTS_SSE
+			for (; i + 4 <= count; i += 4)
+				orthonormalize4(block, i);
+#endif
+			for (; i < count; i++)
+				orthonormalize(block, i);
+
+			for (i = 0; i < count; i++) {
+				float* tangent = vertexData + (first + i) * vertexStride + tangentOffset;
+
+				if (block.valid[i]) {
+					tangent[0] = block.tx[i];
+					tangent[1] = block.ty[i];
+					tangent[2] = block.tz[i];
+					tangent[3] = block.sign[i];
+				}
+				else {
+					Vector3 t = perpendicular({ block.nx[i], block.ny[i], block.nz[i] });
+					tangent[0] = t.x;
+					tangent[1] = t.y;
+					tangent[2] = t.z;
+					tangent[3] = 1.0f;
+				}
+			}
+		});
+	}
+}
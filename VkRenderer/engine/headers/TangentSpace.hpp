@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace VkRenderer {
+	/*
+	 * Per vertex tangents the way MikkTSpace builds them: every triangle's uv derivatives are projected into the plane
+	 * of each corner's normal, normalized and summed weighted by the corner angle, then the sum is orthonormalized
+	 * against the normal. w is the bitangent sign, so bitangent = cross(normal, tangent.xyz) * w like glTF expects.
+	 * Triangles with no uv area add nothing and vertices left without a tangent get any direction perpendicular to
+	 * the normal, so the result never has NaNs.
+	 *
+	 * vertexData is read as vertexStride floats per vertex with the position in the first three, the normal at
+	 * normalOffset and the uv at uvOffset. Four floats are written at tangentOffset. Runs on the thread pool and gives
+	 * the same result for any thread count.
+	 */
+	void generateTangents(float* vertexData, size_t vertexCount, size_t vertexStride, size_t normalOffset, size_t uvOffset, size_t tangentOffset,
+		const uint32_t* indices, size_t indexCount);
+}
@@ -0,0 +1,237 @@
+#include "TextureCache.hpp"
+
+#include "TextureCompression.hpp"
+#include "ThreadPool.hpp"
+#include "VulkanUtils.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <iomanip>
+#include <sstream>
+
+namespace fs = std::filesystem;
+
+namespace VkRenderer {
+	namespace {
+		// size and write time of the source image, empty if it can't be read
+		std::string describeSource(const std::string& path)
+		{
+			std::error_code error;
+			uintmax_t size = fs::file_size(path, error);
+			if (error)
+				return {};
+
+			auto writeTime = fs::last_write_time(path, error);
+			if (error)
+				return {};
+
+			return std::to_string(size) + " " + std::to_string(writeTime.time_since_epoch().count());
+		}
+
+		float srgbToLinear(float value)
+		{
+			return value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+		}
+
+		float linearToSrgb(float value)
+		{
+			return value <= 0.0031308f ? value * 12.92f : 1.055f * std::pow(value, 1.0f / 2.4f) - 0.055f;
+		}
+
+		uint8_t toByte(float value)
+		{
+			return static_cast<uint8_t>(std::clamp(value, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+
+		// mips are filtered as floats: linear color, normals as vectors, everything else as is
+		std::vector<float> decodeTexels(const stbi_uc* pixels, size_t count, TextureUsage usage)
+		{
+			std::vector<float> texels(count * 4);
+			for (size_t i = 0; i < count * 4; i++) {
+				float value = pixels[i] / 255.0f;
+
+				if (usage == TextureUsage::Color && i % 4 != 3)
+					value = srgbToLinear(value);
+				else if (usage == TextureUsage::Normal && i % 4 != 3)
+					value = value * 2.0f - 1.0f;
+
+				texels[i] = value;
+			}
+			return texels;
+		}
+
+		std::vector<uint8_t> encodeTexels(const std::vector<float>& texels, TextureUsage usage)
+		{
+			std::vector<uint8_t> pixels(texels.size());
+			for (size_t i = 0; i < texels.size(); i += 4) {
+				const float* texel = &texels[i];
+
+				if (usage == TextureUsage::Color) {
+					for (int c = 0; c < 3; c++)
+						pixels[i + c] = toByte(linearToSrgb(texel[c]));
+				}
+				else if (usage == TextureUsage::Normal) {
+					// averaging shortens them, BC5 only keeps x and y so they have to be unit length again
+					float length = std::sqrt(texel[0] * texel[0] + texel[1] * texel[1] + texel[2] * texel[2]);
+					float scale = length > 0.0f ? 1.0f / length : 0.0f;
+					for (int c = 0; c < 3; c++)
+						pixels[i + c] = toByte(texel[c] * scale * 0.5f + 0.5f);
+				}
+				else {
+					for (int c = 0; c < 3; c++)
+						pixels[i + c] = toByte(texel[c]);
+				}
+
+				pixels[i + 3] = toByte(texel[3]);
+			}
+			return pixels;
+		}
+
+		// 2x2 box filter, odd edges reuse the last row/column
+		std::vector<float> downsample(const std::vector<float>& texels, uint32_t width, uint32_t height)
+		{
+			uint32_t nextWidth = std::max(width / 2, 1u);
+			uint32_t nextHeight = std::max(height / 2, 1u);
+			std::vector<float> next(static_cast<size_t>(nextWidth) * nextHeight * 4);
+
+			GetThreadPool().parallelFor(nextHeight, [&](size_t y) {
+				size_t y0 = std::min<size_t>(y * 2, height - 1);
+				size_t y1 = std::min<size_t>(y * 2 + 1, height - 1);
+
+				for (size_t x = 0; x < nextWidth; x++) {
+					size_t x0 = std::min<size_t>(x * 2, width - 1);
+					size_t x1 = std::min<size_t>(x * 2 + 1, width - 1);
+
+					for (int c = 0; c < 4; c++) {
+						next[(y * nextWidth + x) * 4 + c] = 0.25f * (
+							texels[(y0 * width + x0) * 4 + c] + texels[(y0 * width + x1) * 4 + c] +
+							texels[(y1 * width + x0) * 4 + c] + texels[(y1 * width + x1) * 4 + c]);
+					}
+				}
+			});
+
+			return next;
+		}
+	}
+
+	VkFormat getSourceFormat(TextureUsage usage)
+	{
+		switch (usage) {
+			case TextureUsage::Color:
+				return VK_FORMAT_R8G8B8A8_SRGB;
+			case TextureUsage::Hdr:
+				return VK_FORMAT_R32G32B32A32_SFLOAT;
+			default:
+				return VK_FORMAT_R8G8B8A8_UNORM;
+		}
+	}
+
+	VkFormat getCookedFormat(TextureUsage usage)
+	{
+		switch (usage) {
+			case TextureUsage::Normal:
+				return VK_FORMAT_BC5_UNORM_BLOCK;
+			case TextureUsage::Mask:
+				return VK_FORMAT_BC4_UNORM_BLOCK;
+			case TextureUsage::Hdr:
+				return VK_FORMAT_BC6H_UFLOAT_BLOCK;
+			default:
+				return VK_FORMAT_BC7_SRGB_BLOCK;
+		}
+	}
+
+	TextureCache::TextureCache(std::string directory)
+		: directory{ std::move(directory) }
+	{}
+
+	std::string TextureCache::getCachePath(const std::string& filepath, TextureUsage usage, bool flip) const
+	{
+		std::error_code error;
+		fs::path source = fs::weakly_canonical(fs::path(filepath), error);
+		if (error)
+			source = fs::absolute(fs::path(filepath));
+
+		std::string key = source.generic_string();
+		uint64_t hash = hashBytes(key.data(), key.size());
+		hash = hashBytes(&VERSION, sizeof(VERSION), hash);
+		hash = hashBytes(&usage, sizeof(usage), hash);
+		hash = hashBytes(&flip, sizeof(flip), hash);
+
+		std::stringstream name;
+		name << fs::path(filepath).stem().string() << "-" << std::hex << std::setw(16) << std::setfill('0') << hash << ".ktx2";
+		return (fs::path(directory) / name.str()).string();
+	}
+
+	std::unique_ptr<Ktx2File> TextureCache::load(const std::string& filepath, TextureUsage usage, bool flip) const
+	{
+		auto file = std::make_unique<Ktx2File>();
+		if (!file->open(getCachePath(filepath, usage, flip)))
+			return nullptr;
+
+		std::string source = describeSource(filepath);
+		if (source.empty() || file->getValue("DAVsource") != source || file->getFormat() != getCookedFormat(usage))
+			return nullptr;
+
+		return file;
+	}
+
+	bool TextureCache::cook(const std::string& filepath, TextureUsage usage, bool flip) const
+	{
+		std::string source = describeSource(filepath);
+		if (source.empty())
+			return false;
+
+		int width = 0, height = 0;
+		std::vector<float> texels;
+
+		// per thread, so it doesn't matter what else the pool decodes meanwhile
+		stbi_set_flip_vertically_on_load_thread(flip);
+
+		if (usage == TextureUsage::Hdr) {
+			float* pixels = stbi_loadf(filepath.c_str(), &width, &height, nullptr, 4);
+			if (pixels == nullptr)
+				return false;
+
+			texels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+			stbi_image_free(pixels);
+		}
+		else {
+			stbi_uc* pixels = stbi_load(filepath.c_str(), &width, &height, nullptr, STBI_rgb_alpha);
+			if (pixels == nullptr)
+				return false;
+
+			texels = decodeTexels(pixels, static_cast<size_t>(width) * height, usage);
+			stbi_image_free(pixels);
+		}
+
+		VkFormat format = getCookedFormat(usage);
+		std::vector<std::vector<uint8_t>> levels;
+
+		uint32_t levelWidth = static_cast<uint32_t>(width);
+		uint32_t levelHeight = static_cast<uint32_t>(height);
+		for (;;) {
+			if (usage == TextureUsage::Hdr)
+				levels.push_back(compressImage(format, texels.data(), levelWidth, levelHeight));
+			else
+				levels.push_back(compressImage(format, encodeTexels(texels, usage).data(), levelWidth, levelHeight));
+
+			if (levelWidth == 1 && levelHeight == 1)
+				break;
+
+			texels = downsample(texels, levelWidth, levelHeight);
+			levelWidth = std::max(levelWidth / 2, 1u);
+			levelHeight = std::max(levelHeight / 2, 1u);
+		}
+
+		return writeKtx2(getCachePath(filepath, usage, flip), format, width, height, levels, { { "DAVsource", source } });
+	}
+
+	TextureCache& GetTextureCache()
+	{
+		static TextureCache instance{};
+		return instance;
+	}
+}
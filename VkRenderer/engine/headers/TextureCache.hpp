@@ -0,0 +1,45 @@
+#pragma once
+
+#include "Ktx2.hpp"
+
+#include <memory>
+#include <string>
+
+namespace VkRenderer {
+	// what an image is used for, picks its compressed format and how its mips are filtered
+	enum class TextureUsage {
+		Color,  // srgb albedo, BC7
+		Normal, // tangent space normals, BC5 keeps x and y and the shader rebuilds z
+		Mask,   // one channel of linear data like roughness or occlusion, BC4
+		Hdr     // float rgb, BC6H
+	};
+
+	// what the decoded image is uploaded as when there's no cooked file
+	VkFormat getSourceFormat(TextureUsage usage);
+	VkFormat getCookedFormat(TextureUsage usage);
+
+	/*
+	 * Block compressed copies of image files on disk (.ktx2), one per source image, usage and orientation.
+	 * Every mip is encoded up front so loading one is a single copy with no blits. A file stays current
+	 * while the image it was cooked from has the size and write time stored in its key/value data.
+	 */
+	class TextureCache
+	{
+		public:
+			static constexpr uint32_t VERSION = 1;
+
+			explicit TextureCache(std::string directory = "cache/textures");
+
+			// nullptr unless a current cooked file exists. flip has to match the cook, like stbi's vertical flip
+			std::unique_ptr<Ktx2File> load(const std::string& filepath, TextureUsage usage, bool flip) const;
+			// decodes the image, builds its mips and compresses them. false if it couldn't be read or written
+			bool cook(const std::string& filepath, TextureUsage usage, bool flip) const;
+
+			std::string getCachePath(const std::string& filepath, TextureUsage usage, bool flip) const;
+			const std::string& getDirectory() const { return directory; }
+		private:
+			std::string directory;
+	};
+
+	TextureCache& GetTextureCache();
+}
@@ -0,0 +1,457 @@
+#include "TextureCompression.hpp"
+
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace VkRenderer {
+	namespace {
+		constexpr int WEIGHTS4[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		// BC6H and BC7 blocks are one 128 bit little endian number, filled from the lowest bit up
+		class BlockWriter {
+			public:
+				explicit BlockWriter(uint8_t* out) : out{ out } { memset(out, 0, 16); }
+
+				void write(uint32_t value, uint32_t count)
+				{
+					for (uint32_t i = 0; i < count; i++, position++)
+						if (value & (1u << i))
+							out[position >> 3] |= static_cast<uint8_t>(1u << (position & 7));
+				}
+			private:
+				uint8_t* out;
+				uint32_t position = 0;
+		};
+
+		// line along the principal axis of the texels, from the lowest to the highest projection
+		template <int N>
+		void fitLine(const float (*texels)[N], float* start, float* end)
+		{
+			float mean[N] = {};
+			for (int i = 0; i < 16; i++)
+				for (int c = 0; c < N; c++)
+					mean[c] += texels[i][c] / 16.0f;
+
+			float covariance[N][N] = {};
+			for (int i = 0; i < 16; i++)
+				for (int r = 0; r < N; r++)
+					for (int c = 0; c < N; c++)
+						covariance[r][c] += (texels[i][r] - mean[r]) * (texels[i][c] - mean[c]);
+
+			// power iteration from the channel with the largest spread
+			int widest = 0;
+			for (int c = 1; c < N; c++)
+				if (covariance[c][c] > covariance[widest][widest])
+					widest = c;
+
+			float axis[N];
+			for (int c = 0; c < N; c++)
+				axis[c] = covariance[widest][c];
+
+			for (int iteration = 0; iteration < 8; iteration++) {
+				float next[N] = {};
+				float largest = 0.0f;
+				for (int r = 0; r < N; r++) {
+					for (int c = 0; c < N; c++)
+						next[r] += covariance[r][c] * axis[c];
+					largest = std::max(largest, std::abs(next[r]));
+				}
+
+				if (largest <= 0.0f)
+					break;
+
+				for (int c = 0; c < N; c++)
+					axis[c] = next[c] / largest;
+			}
+
+			float length = 0.0f;
+			for (int c = 0; c < N; c++)
+				length += axis[c] * axis[c];
+
+			// a flat block
+			if (length <= 0.0f) {
+				for (int c = 0; c < N; c++)
+					start[c] = end[c] = mean[c];
+				return;
+			}
+
+			length = std::sqrt(length);
+			float lowest = std::numeric_limits<float>::max(), highest = -std::numeric_limits<float>::max();
+			for (int i = 0; i < 16; i++) {
+				float t = 0.0f;
+				for (int c = 0; c < N; c++)
+					t += (texels[i][c] - mean[c]) * axis[c] / length;
+
+				lowest = std::min(lowest, t);
+				highest = std::max(highest, t);
+			}
+
+			for (int c = 0; c < N; c++) {
+				start[c] = mean[c] + axis[c] / length * lowest;
+				end[c] = mean[c] + axis[c] / length * highest;
+			}
+		}
+
+		// the endpoints with the least squared error for the weights the texels picked, false if they all picked the same one
+		template <int N>
+		bool refineLine(const float (*texels)[N], const uint8_t* indices, float* start, float* end)
+		{
+			float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+			float ax[N] = {}, bx[N] = {};
+
+			for (int i = 0; i < 16; i++) {
+				float t = WEIGHTS4[indices[i]] / 64.0f;
+				float s = 1.0f - t;
+
+				aa += s * s;
+				ab += s * t;
+				bb += t * t;
+				for (int c = 0; c < N; c++) {
+					ax[c] += s * texels[i][c];
+					bx[c] += t * texels[i][c];
+				}
+			}
+
+			float determinant = aa * bb - ab * ab;
+			if (std::abs(determinant) < 1e-6f)
+				return false;
+
+			for (int c = 0; c < N; c++) {
+				start[c] = (bb * ax[c] - ab * bx[c]) / determinant;
+				end[c] = (aa * bx[c] - ab * ax[c]) / determinant;
+			}
+			return true;
+		}
+
+		int interpolate(int a, int b, int weight)
+		{
+			return (a * (64 - weight) + b * weight + 32) >> 6;
+		}
+
+		struct BC7Candidate {
+			int endpoints[2][4]; // 7 bits
+			int pbits[2];
+			uint8_t indices[16];
+			float error = std::numeric_limits<float>::max();
+		};
+
+		// quantizes the line with every p-bit pair and keeps whichever beats best
+		void evaluateBC7(const float (*texels)[4], const float* start, const float* end, BC7Candidate& best)
+		{
+			for (int p0 = 0; p0 < 2; p0++) {
+				for (int p1 = 0; p1 < 2; p1++) {
+					BC7Candidate candidate{};
+					candidate.pbits[0] = p0;
+					candidate.pbits[1] = p1;
+
+					int expanded[2][4];
+					for (int c = 0; c < 4; c++) {
+						candidate.endpoints[0][c] = std::clamp(static_cast<int>(std::lround((start[c] - p0) / 2.0f)), 0, 127);
+						candidate.endpoints[1][c] = std::clamp(static_cast<int>(std::lround((end[c] - p1) / 2.0f)), 0, 127);
+						expanded[0][c] = (candidate.endpoints[0][c] << 1) | p0;
+						expanded[1][c] = (candidate.endpoints[1][c] << 1) | p1;
+					}
+
+					int palette[16][4];
+					for (int w = 0; w < 16; w++)
+						for (int c = 0; c < 4; c++)
+							palette[w][c] = interpolate(expanded[0][c], expanded[1][c], WEIGHTS4[w]);
+
+					candidate.error = 0.0f;
+					for (int i = 0; i < 16; i++) {
+						float nearest = std::numeric_limits<float>::max();
+						for (int w = 0; w < 16; w++) {
+							float error = 0.0f;
+							for (int c = 0; c < 4; c++) {
+								float d = texels[i][c] - palette[w][c];
+								error += d * d;
+							}
+
+							if (error < nearest) {
+								nearest = error;
+								candidate.indices[i] = static_cast<uint8_t>(w);
+							}
+						}
+						candidate.error += nearest;
+					}
+
+					if (candidate.error < best.error)
+						best = candidate;
+				}
+			}
+		}
+
+		uint16_t toHalf(float value)
+		{
+			if (!(value > 0.0f)) // negatives and nans, the unsigned format has neither
+				return 0;
+			value = std::min(value, 65504.0f);
+
+			uint32_t bits;
+			memcpy(&bits, &value, sizeof(bits));
+
+			int exponent = static_cast<int>((bits >> 23) & 0xFF) - 127 + 15;
+			uint32_t mantissa = bits & 0x7FFFFF;
+
+			if (exponent <= 0) {
+				if (exponent < -10)
+					return 0;
+
+				uint32_t shift = static_cast<uint32_t>(14 - exponent);
+				return static_cast<uint16_t>(((mantissa | 0x800000) + (1u << (shift - 1))) >> shift);
+			}
+
+			uint32_t half = (static_cast<uint32_t>(exponent) << 10 | mantissa >> 13) + ((mantissa >> 12) & 1);
+			return static_cast<uint16_t>(std::min(half, 0x7BFFu));
+		}
+
+		// mode 11 endpoints are 10 bits, this is what the decoder widens them to before interpolating
+		int unquantizeBC6H(int value)
+		{
+			if (value == 0)
+				return 0;
+			if (value == 1023)
+				return 0xFFFF;
+			return ((value << 16) + 0x8000) >> 10;
+		}
+
+		struct BC6HCandidate {
+			int endpoints[2][3];
+			uint8_t indices[16];
+			float error = std::numeric_limits<float>::max();
+		};
+
+		// texels and line are in half float bit patterns, which is close enough to a log scale to compare errors in
+		void evaluateBC6H(const float (*texels)[3], const float* start, const float* end, BC6HCandidate& best)
+		{
+			BC6HCandidate candidate{};
+
+			int expanded[2][3];
+			for (int c = 0; c < 3; c++) {
+				candidate.endpoints[0][c] = std::clamp(static_cast<int>(std::lround((start[c] - 15.0f) / 31.0f)), 0, 1023);
+				candidate.endpoints[1][c] = std::clamp(static_cast<int>(std::lround((end[c] - 15.0f) / 31.0f)), 0, 1023);
+				expanded[0][c] = unquantizeBC6H(candidate.endpoints[0][c]);
+				expanded[1][c] = unquantizeBC6H(candidate.endpoints[1][c]);
+			}
+
+			float palette[16][3];
+			for (int w = 0; w < 16; w++)
+				for (int c = 0; c < 3; c++)
+					palette[w][c] = static_cast<float>((interpolate(expanded[0][c], expanded[1][c], WEIGHTS4[w]) * 31) >> 6);
+
+			candidate.error = 0.0f;
+			for (int i = 0; i < 16; i++) {
+				float nearest = std::numeric_limits<float>::max();
+				for (int w = 0; w < 16; w++) {
+					float error = 0.0f;
+					for (int c = 0; c < 3; c++) {
+						float d = texels[i][c] - palette[w][c];
+						error += d * d;
+					}
+
+					if (error < nearest) {
+						nearest = error;
+						candidate.indices[i] = static_cast<uint8_t>(w);
+					}
+				}
+				candidate.error += nearest;
+			}
+
+			if (candidate.error < best.error)
+				best = candidate;
+		}
+
+		// the first index loses its top bit, so the endpoints are swapped when it's set
+		template <typename Candidate>
+		void fixAnchor(Candidate& candidate)
+		{
+			if (candidate.indices[0] < 8)
+				return;
+
+			std::swap(candidate.endpoints[0], candidate.endpoints[1]);
+			for (auto& index : candidate.indices)
+				index = static_cast<uint8_t>(15 - index);
+		}
+
+		void writeIndices(BlockWriter& writer, const uint8_t* indices)
+		{
+			writer.write(indices[0], 3);
+			for (int i = 1; i < 16; i++)
+				writer.write(indices[i], 4);
+		}
+	}
+
+	uint32_t getBlockSize(VkFormat format)
+	{
+		switch (format) {
+			case VK_FORMAT_BC4_UNORM_BLOCK:
+				return 8;
+			case VK_FORMAT_BC5_UNORM_BLOCK:
+			case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+			case VK_FORMAT_BC7_UNORM_BLOCK:
+			case VK_FORMAT_BC7_SRGB_BLOCK:
+				return 16;
+			default:
+				return 0;
+		}
+	}
+
+	VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height)
+	{
+		uint32_t blockSize = getBlockSize(format);
+		if (blockSize == 0)
+			throw std::runtime_error("not a block compressed format");
+
+		return static_cast<VkDeviceSize>((width + 3) / 4) * ((height + 3) / 4) * blockSize;
+	}
+
+	void encodeBC4Block(const uint8_t* values, size_t stride, uint8_t* out)
+	{
+		int lowest = 255, highest = 0;
+		for (int i = 0; i < 16; i++) {
+			lowest = std::min<int>(lowest, values[i * stride]);
+			highest = std::max<int>(highest, values[i * stride]);
+		}
+
+		// the 8 value mode needs the first endpoint to be the larger one, a flat block decodes fine either way
+		out[0] = static_cast<uint8_t>(highest);
+		out[1] = static_cast<uint8_t>(lowest);
+
+		int palette[8] = { highest, lowest };
+		for (int i = 2; i < 8; i++)
+			palette[i] = ((8 - i) * highest + (i - 1) * lowest) / 7;
+
+		uint64_t bits = 0;
+		for (int i = 0; i < 16; i++) {
+			int value = values[i * stride];
+
+			uint64_t index = 0;
+			for (int p = 1; p < 8; p++)
+				if (std::abs(palette[p] - value) < std::abs(palette[index] - value))
+					index = p;
+
+			bits |= index << (3 * i);
+		}
+
+		for (int i = 0; i < 6; i++)
+			out[2 + i] = static_cast<uint8_t>(bits >> (8 * i));
+	}
+
+	void encodeBC5Block(const uint8_t* rgba, uint8_t* out)
+	{
+		encodeBC4Block(rgba, 4, out);
+		encodeBC4Block(rgba + 1, 4, out + 8);
+	}
+
+	void encodeBC7Block(const uint8_t* rgba, uint8_t* out)
+	{
+		float texels[16][4];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 4; c++)
+				texels[i][c] = rgba[i * 4 + c];
+
+		float start[4], end[4];
+		fitLine<4>(texels, start, end);
+
+		BC7Candidate best{};
+		evaluateBC7(texels, start, end, best);
+		if (refineLine<4>(texels, best.indices, start, end))
+			evaluateBC7(texels, start, end, best);
+
+		if (best.indices[0] >= 8)
+			std::swap(best.pbits[0], best.pbits[1]);
+		fixAnchor(best);
+
+		BlockWriter writer(out);
+		writer.write(1u << 6, 7); // mode 6
+
+		for (int c = 0; c < 4; c++) {
+			writer.write(best.endpoints[0][c], 7);
+			writer.write(best.endpoints[1][c], 7);
+		}
+		writer.write(best.pbits[0], 1);
+		writer.write(best.pbits[1], 1);
+
+		writeIndices(writer, best.indices);
+	}
+
+	void encodeBC6HBlock(const float* rgba, uint8_t* out)
+	{
+		float texels[16][3];
+		for (int i = 0; i < 16; i++)
+			for (int c = 0; c < 3; c++)
+				texels[i][c] = toHalf(rgba[i * 4 + c]);
+
+		float start[3], end[3];
+		fitLine<3>(texels, start, end);
+
+		BC6HCandidate best{};
+		evaluateBC6H(texels, start, end, best);
+		if (refineLine<3>(texels, best.indices, start, end))
+			evaluateBC6H(texels, start, end, best);
+
+		fixAnchor(best);
+
+		BlockWriter writer(out);
+		writer.write(0x03, 5); // mode 11
+
+		for (int e = 0; e < 2; e++)
+			for (int c = 0; c < 3; c++)
+				writer.write(best.endpoints[e][c], 10);
+
+		writeIndices(writer, best.indices);
+	}
+
+	std::vector<uint8_t> compressImage(VkFormat format, const void* pixels, uint32_t width, uint32_t height)
+	{
+		uint32_t blockSize = getBlockSize(format);
+		if (blockSize == 0)
+			throw std::runtime_error("not a block compressed format");
+
+		uint32_t blocksX = (width + 3) / 4;
+		uint32_t blocksY = (height + 3) / 4;
+		std::vector<uint8_t> blocks(static_cast<size_t>(blocksX) * blocksY * blockSize);
+
+		GetThreadPool().parallelFor(blocksY, [&](size_t blockY) {
+			uint8_t texels[64];
+			float hdrTexels[64];
+
+			for (uint32_t blockX = 0; blockX < blocksX; blockX++) {
+				for (uint32_t y = 0; y < 4; y++) {
+					for (uint32_t x = 0; x < 4; x++) {
+						size_t source = static_cast<size_t>(std::min<uint32_t>(static_cast<uint32_t>(blockY) * 4 + y, height - 1)) * width
+							+ std::min(blockX * 4 + x, width - 1);
+
+						if (format == VK_FORMAT_BC6H_UFLOAT_BLOCK)
+							memcpy(&hdrTexels[(y * 4 + x) * 4], static_cast<const float*>(pixels) + source * 4, 4 * sizeof(float));
+						else
+							memcpy(&texels[(y * 4 + x) * 4], static_cast<const uint8_t*>(pixels) + source * 4, 4);
+					}
+				}
+
+				uint8_t* out = blocks.data() + (blockY * blocksX + blockX) * blockSize;
+				switch (format) {
+					case VK_FORMAT_BC4_UNORM_BLOCK:
+						encodeBC4Block(texels, 4, out);
+						break;
+					case VK_FORMAT_BC5_UNORM_BLOCK:
+						encodeBC5Block(texels, out);
+						break;
+					case VK_FORMAT_BC6H_UFLOAT_BLOCK:
+						encodeBC6HBlock(hdrTexels, out);
+						break;
+					default:
+						encodeBC7Block(texels, out);
+						break;
+				}
+			}
+		});
+
+		return blocks;
+	}
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VkRenderer {
+	// bytes per 4x4 block of the BC formats below, 0 for anything else
+	uint32_t getBlockSize(VkFormat format);
+	// bytes of one mip level, BC formats are rounded up to whole blocks
+	VkDeviceSize getLevelSize(VkFormat format, uint32_t width, uint32_t height);
+
+	/*
+	 * Block encoders, each one takes the 16 texels of a 4x4 block row by row. They aim for a fast offline cook
+	 * rather than the best possible quality: endpoints come from the principal axis of the block and one least
+	 * squares pass, every block is written in a single mode.
+	 */
+
+	// 8 bytes, one 8 bit channel read every stride bytes
+	void encodeBC4Block(const uint8_t* values, size_t stride, uint8_t* out);
+	// 16 bytes, red and green of rgba8 texels as two BC4 blocks
+	void encodeBC5Block(const uint8_t* rgba, uint8_t* out);
+	// 16 bytes, rgba8 texels in mode 6 (one subset, 7 bit endpoints with a p-bit, 4 bit indices)
+	void encodeBC7Block(const uint8_t* rgba, uint8_t* out);
+	// 16 bytes, rgba32f texels (alpha ignored, negatives clamped) in unsigned mode 11 (10 bit endpoints, 4 bit indices)
+	void encodeBC6HBlock(const float* rgba, uint8_t* out);
+
+	// a whole image into BC4/BC5/BC7 from rgba8 or BC6H from rgba32f, block rows are encoded on the thread pool.
+	// edges that aren't a multiple of 4 repeat the last row/column
+	std::vector<uint8_t> compressImage(VkFormat format, const void* pixels, uint32_t width, uint32_t height);
+}
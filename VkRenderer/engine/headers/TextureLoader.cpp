@@ -0,0 +1,144 @@
+#include "TextureLoader.hpp"
+
+#include "ThreadPool.hpp"
+
+#include "stb_image.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace VkRenderer {
+	TextureLoader::TextureLoader(VulkanDevice& device)
+		: device{ device }
+	{}
+
+	TextureLoader::~TextureLoader()
+	{
+		// decode tasks write into the queue, so they have to be done before it goes
+		std::unique_lock<std::mutex> lock{ mutex };
+		idle.wait(lock, [this]() { return decoding == 0; });
+
+		for (auto& image : decoded)
+			stbi_image_free(image.pixels);
+	}
+
+	void TextureLoader::load(const std::string& path, TextureUsage usage, Callback onLoaded)
+	{
+		submit(Decoded{ path, usage, std::move(onLoaded), usage == TextureUsage::Hdr });
+	}
+
+	void TextureLoader::loadEncoded(const std::string& name, std::shared_ptr<const void> owner, const unsigned char* data, size_t size,
+		TextureUsage usage, bool flip, Callback onLoaded)
+	{
+		Decoded image{ name, usage, std::move(onLoaded), flip };
+		image.encodedOwner = std::move(owner);
+		image.encodedData = data;
+		image.encodedSize = size;
+
+		submit(std::move(image));
+	}
+
+	void TextureLoader::submit(Decoded image)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			decoding++;
+		}
+
+		GetThreadPool().submit([this, image = std::move(image)]() mutable {
+			decode(image);
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			decoded.push_back(std::move(image));
+
+			if (--decoding == 0)
+				idle.notify_all();
+		});
+	}
+
+	void TextureLoader::decode(Decoded& image)
+	{
+		bool flip = image.flip;
+
+		if (device.features.textureCompressionBC && image.encodedData == nullptr) {
+			image.cooked = GetTextureCache().load(image.path, image.usage, flip);
+			if (image.cooked) {
+				// only the mip tail goes up in upload(), the rest is streamed by whoever owns the texture
+				image.size = std::min<VkDeviceSize>(image.cooked->getDataSize(), VulkanTexture::STREAMING_TAIL_SIZE);
+				return;
+			}
+		}
+
+		// the flip is per thread and other pool work sets it too, so it's set for every image
+		stbi_set_flip_vertically_on_load_thread(flip);
+
+		if (image.encodedData != nullptr) {
+			image.pixels = stbi_load_from_memory(image.encodedData, static_cast<int>(image.encodedSize), &image.width, &image.height, nullptr, STBI_rgb_alpha);
+			image.size = static_cast<VkDeviceSize>(image.width) * image.height * 4;
+			image.encodedOwner.reset();
+		}
+		else if (image.usage == TextureUsage::Hdr) {
+			image.pixels = stbi_loadf(image.path.c_str(), &image.width, &image.height, nullptr, 4);
+			image.size = static_cast<VkDeviceSize>(image.width) * image.height * 4 * sizeof(float);
+		}
+		else {
+			image.pixels = stbi_load(image.path.c_str(), &image.width, &image.height, nullptr, STBI_rgb_alpha);
+			image.size = static_cast<VkDeviceSize>(image.width) * image.height * 4;
+		}
+
+		if (image.pixels == nullptr)
+			std::cerr << "Failed to load image: " << image.path << " (" << stbi_failure_reason() << ")\n";
+	}
+
+	uint32_t TextureLoader::upload(VkDeviceSize budget)
+	{
+		std::deque<Decoded> batch;
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+
+			VkDeviceSize staged = 0;
+			while (!decoded.empty() && (batch.empty() || staged + decoded.front().size <= budget)) {
+				staged += decoded.front().size;
+				batch.push_back(std::move(decoded.front()));
+				decoded.pop_front();
+			}
+		}
+
+		// callbacks run without the lock, they are free to request more images
+		for (Decoded& image : batch) {
+			if (image.cooked) {
+				auto texture = std::make_unique<VulkanTexture>(device, image.cooked->getFormat());
+				texture->loadKtx2(std::move(image.cooked), VulkanTexture::STREAMING_TAIL_SIZE);
+
+				image.onLoaded(std::move(texture));
+				continue;
+			}
+
+			if (image.pixels == nullptr) {
+				image.onLoaded(nullptr);
+				continue;
+			}
+
+			auto texture = std::make_unique<VulkanTexture>(device, getSourceFormat(image.usage));
+			texture->width = image.width;
+			texture->height = image.height;
+
+			void* staging = texture->beginLoad();
+			memcpy(staging, image.pixels, static_cast<size_t>(image.size));
+			texture->endLoad();
+
+			stbi_image_free(image.pixels);
+			image.onLoaded(std::move(texture));
+		}
+
+		return static_cast<uint32_t>(batch.size());
+	}
+
+	uint32_t TextureLoader::getPendingCount() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return decoding + static_cast<uint32_t>(decoded.size());
+	}
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "VulkanDevice.hpp"
+#include "VulkanTexture.hpp"
+#include "TextureCache.hpp"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace VkRenderer {
+	/*
+	 * Decodes image files on the thread pool. Decoded images wait in a queue until the world thread takes them with
+	 * upload(), which creates the textures in batches so one frame never stages more than its budget.
+	 * A current cooked file from the texture cache is mapped instead of decoding the image, when the device
+	 * can sample BC formats, only its mip tail is uploaded and the texture streams the rest (see VulkanTexture::streamLevel).
+	 * Hdr files are flipped like VulkanObject::createTexture does. Images that are already in memory (embedded in a
+	 * model file, or read to hash them) go through loadEncoded() and skip the cache.
+	 */
+	class TextureLoader
+	{
+		public:
+			static constexpr VkDeviceSize DEFAULT_UPLOAD_BUDGET = 32ull * 1024 * 1024; // half the staging ring
+
+			// runs in upload(), the texture is null when the file couldn't be decoded. its upload still has to finish, see VulkanTexture::isReady
+			using Callback = std::function<void(std::unique_ptr<VulkanTexture> texture)>;
+
+			TextureLoader(VulkanDevice& device);
+			~TextureLoader();
+
+			TextureLoader(const TextureLoader&) = delete;
+			TextureLoader& operator=(const TextureLoader&) = delete;
+
+			// safe from any thread
+			void load(const std::string& path, TextureUsage usage, Callback onLoaded);
+			// owner keeps data alive until the decode is done, name is only for errors
+			void loadEncoded(const std::string& name, std::shared_ptr<const void> owner, const unsigned char* data, size_t size,
+				TextureUsage usage, bool flip, Callback onLoaded);
+
+			// world thread. always takes at least one image so a single large one can't get stuck, returns how many it took
+			uint32_t upload(VkDeviceSize budget = DEFAULT_UPLOAD_BUDGET);
+
+			// requested and not through upload yet
+			uint32_t getPendingCount() const;
+		private:
+			struct Decoded {
+				std::string path;
+				TextureUsage usage;
+				Callback onLoaded;
+				bool flip = false;
+
+				// set for loadEncoded, decoded from here instead of reading path
+				std::shared_ptr<const void> encodedOwner;
+				const unsigned char* encodedData = nullptr;
+				size_t encodedSize = 0;
+
+				int width = 0, height = 0;
+				void* pixels = nullptr; // from stbi, freed after the upload
+				std::unique_ptr<Ktx2File> cooked; // mapped instead of pixels
+				VkDeviceSize size = 0;
+			};
+
+			void submit(Decoded image);
+			void decode(Decoded& image);
+
+			VulkanDevice& device;
+
+			mutable std::mutex mutex;
+			std::condition_variable idle;
+			std::deque<Decoded> decoded;
+			uint32_t decoding = 0;
+	};
+}
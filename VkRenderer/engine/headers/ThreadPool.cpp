@@ -0,0 +1,125 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+
+namespace VkRenderer {
+	uint32_t ThreadPool::defaultThreadCount()
+	{
+		// leave one core for the main thread
+		uint32_t hardwareThreads = std::thread::hardware_concurrency();
+		return std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+	}
+
+	ThreadPool::ThreadPool(uint32_t threadCount)
+	{
+		workers.reserve(threadCount);
+		for (uint32_t i = 0; i < threadCount; i++)
+			workers.emplace_back([this]() { workerLoop(); });
+	}
+
+	ThreadPool::~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			stopping = true;
+		}
+
+		condition.notify_all();
+
+		for (auto& worker : workers)
+			worker.join();
+	}
+
+	void ThreadPool::enqueue(std::function<void()> task)
+	{
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+			tasks.push(std::move(task));
+		}
+
+		condition.notify_one();
+	}
+
+	void ThreadPool::workerLoop()
+	{
+		for (;;) {
+			std::function<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock{ mutex };
+				condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+
+				if (stopping && tasks.empty())
+					return;
+
+				task = std::move(tasks.front());
+				tasks.pop();
+			}
+
+			task();
+		}
+	}
+
+	void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& fn)
+	{
+		if (count == 0)
+			return;
+
+		if (count == 1) {
+			fn(0);
+			return;
+		}
+
+		struct Shared {
+			std::atomic<size_t> next{ 0 };
+			std::atomic<size_t> finished{ 0 };
+			std::exception_ptr error;
+			std::mutex mutex;
+			std::condition_variable done;
+		};
+
+		auto shared = std::make_shared<Shared>();
+
+		// helpers only ever take indices while running, so waiting on "finished" below can't deadlock
+		// even when every worker is busy (or is the one calling us)
+		auto work = [shared, count, &fn]() {
+			for (;;) {
+				size_t i = shared->next.fetch_add(1);
+				if (i >= count)
+					return;
+
+				try {
+					fn(i);
+				}
+				catch (...) {
+					std::lock_guard<std::mutex> lock{ shared->mutex };
+					if (!shared->error)
+						shared->error = std::current_exception();
+				}
+
+				if (shared->finished.fetch_add(1) + 1 == count) {
+					std::lock_guard<std::mutex> lock{ shared->mutex };
+					shared->done.notify_all();
+				}
+			}
+		};
+
+		size_t helpers = std::min<size_t>(workers.size(), count - 1);
+		for (size_t i = 0; i < helpers; i++)
+			enqueue(work);
+
+		work();
+
+		std::unique_lock<std::mutex> lock{ shared->mutex };
+		shared->done.wait(lock, [&]() { return shared->finished.load() == count; });
+
+		if (shared->error)
+			std::rethrow_exception(shared->error);
+	}
+
+	ThreadPool& GetThreadPool()
+	{
+		static ThreadPool instance{};
+		return instance;
+	}
+}
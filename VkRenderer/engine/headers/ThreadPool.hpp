@@ -0,0 +1,62 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace VkRenderer {
+	/*
+	 * Fixed set of worker threads for asset loading and other cpu side batch work.
+	 * parallelFor lets the calling thread work along, so it can be nested from inside a task
+	 * without starving the pool.
+	 */
+	class ThreadPool
+	{
+		public:
+			ThreadPool(uint32_t threadCount = defaultThreadCount());
+			~ThreadPool();
+
+			ThreadPool(const ThreadPool&) = delete;
+			ThreadPool& operator=(const ThreadPool&) = delete;
+
+			template <typename F>
+			auto submit(F&& task) -> std::future<std::invoke_result_t<F>>
+			{
+				using Result = std::invoke_result_t<F>;
+
+				auto packaged = std::make_shared<std::packaged_task<Result()>>(std::forward<F>(task));
+				std::future<Result> future = packaged->get_future();
+
+				enqueue([packaged]() { (*packaged)(); });
+				return future;
+			}
+
+			// runs fn(i) for every i in [0, count), returns once all of them finished. rethrows the first exception
+			void parallelFor(size_t count, const std::function<void(size_t)>& fn);
+
+			uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+
+			static uint32_t defaultThreadCount();
+		private:
+			void enqueue(std::function<void()> task);
+			void workerLoop();
+
+			std::vector<std::thread> workers;
+			std::queue<std::function<void()>> tasks;
+
+			std::mutex mutex;
+			std::condition_variable condition;
+			bool stopping = false;
+	};
+
+	ThreadPool& GetThreadPool();
+}
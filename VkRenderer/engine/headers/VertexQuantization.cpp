@@ -0,0 +1,77 @@
+#include "VertexQuantization.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace VkRenderer {
+	int16_t quantizeSnorm16(float value)
+	{
+		value = std::clamp(value, -1.0f, 1.0f);
+		return static_cast<int16_t>(std::lround(value * 32767.0f));
+	}
+
+	uint16_t floatToHalf(float value)
+	{
+		uint32_t bits;
+		std::memcpy(&bits, &value, sizeof(bits));
+
+		uint32_t sign = (bits >> 16) & 0x8000u;
+		uint32_t exponent = (bits >> 23) & 0xFFu;
+		uint32_t mantissa = bits & 0x7FFFFFu;
+
+		// nan stays nan, inf stays inf
+		if (exponent == 0xFFu)
+			return static_cast<uint16_t>(sign | 0x7C00u | (mantissa ? 0x200u : 0u));
+
+		int32_t halfExponent = static_cast<int32_t>(exponent) - 127 + 15;
+
+		if (halfExponent >= 31)
+			return static_cast<uint16_t>(sign | 0x7C00u);
+
+		if (halfExponent <= 0) {
+			// subnormal half or zero
+			if (halfExponent < -10)
+				return static_cast<uint16_t>(sign);
+
+			mantissa |= 0x800000u;
+			uint32_t shift = static_cast<uint32_t>(14 - halfExponent);
+			uint32_t half = mantissa >> shift;
+			uint32_t remainder = mantissa & ((1u << shift) - 1u);
+			uint32_t halfway = 1u << (shift - 1u);
+
+			if (remainder > halfway || (remainder == halfway && (half & 1u)))
+				half++;
+
+			return static_cast<uint16_t>(sign | half);
+		}
+
+		uint32_t half = sign | (static_cast<uint32_t>(halfExponent) << 10) | (mantissa >> 13);
+		uint32_t remainder = mantissa & 0x1FFFu;
+
+		// a carry out of the mantissa bumps the exponent, which is still the right rounding
+		if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+			half++;
+
+		return static_cast<uint16_t>(half);
+	}
+
+	glm::vec2 octEncode(glm::vec3 direction)
+	{
+		float length = std::abs(direction.x) + std::abs(direction.y) + std::abs(direction.z);
+		if (length == 0.0f)
+			return glm::vec2(0.0f);
+
+		direction /= length;
+
+		glm::vec2 encoded(direction.x, direction.y);
+		if (direction.z < 0.0f) {
+			encoded = glm::vec2(
+				(1.0f - std::abs(direction.y)) * (direction.x >= 0.0f ? 1.0f : -1.0f),
+				(1.0f - std::abs(direction.x)) * (direction.y >= 0.0f ? 1.0f : -1.0f)
+			);
+		}
+
+		return encoded;
+	}
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+#include <glm/glm.hpp>
+
+#include <cstdint>
+
+namespace VkRenderer {
+	// helpers for packing vertex attributes into the compact vertex layout, decoding lives in shader.vert
+
+	// [-1, 1] -> snorm16, matches VK_FORMAT_R16_SNORM
+	int16_t quantizeSnorm16(float value);
+
+	// float32 -> IEEE half, round to nearest even. matches VK_FORMAT_R16_SFLOAT
+	uint16_t floatToHalf(float value);
+
+	// unit vector -> octahedral [-1, 1]^2
+	glm::vec2 octEncode(glm::vec3 direction);
+}
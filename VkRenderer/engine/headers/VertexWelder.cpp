@@ -0,0 +1,160 @@
+#include "VertexWelder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <numeric>
+#include <stdexcept>
+
+namespace VkRenderer {
+	namespace {
+		uint32_t mixWord(uint32_t hash, uint32_t word)
+		{
+			word *= 0xcc9e2d51u;
+			word = (word << 15) | (word >> 17);
+			word *= 0x1b873593u;
+
+			hash ^= word;
+			hash = (hash << 13) | (hash >> 19);
+			return hash * 5u + 0xe6546b64u;
+		}
+
+		uint32_t finalize(uint32_t hash)
+		{
+			hash ^= hash >> 16;
+			hash *= 0x85ebca6bu;
+			hash ^= hash >> 13;
+			hash *= 0xc2b2ae35u;
+			hash ^= hash >> 16;
+			return hash;
+		}
+
+		// -0 and +0 are the same position, everything else (including nan payloads) compares bitwise
+		uint32_t keyBits(float value)
+		{
+			if (value == 0.0f)
+				value = 0.0f;
+
+			uint32_t word;
+			std::memcpy(&word, &value, sizeof(word));
+			return word;
+		}
+	}
+
+	VertexWelder::VertexWelder(Mode mode, float epsilon) : mode{ mode }
+	{
+		if (mode == Mode::Epsilon && epsilon <= 0.0f)
+			throw std::runtime_error("Weld epsilon must be positive");
+
+		invEpsilon = 1.0f / epsilon;
+	}
+
+	void VertexWelder::weld(const float* rows, size_t rowCount, uint32_t stride, uint32_t keyFloats,
+		const uint32_t* indices, size_t indexCount,
+		std::vector<uint32_t>& uniqueRows, std::vector<uint32_t>& outIndices)
+	{
+		if (keyFloats > stride)
+			throw std::runtime_error("Weld key is larger than the vertex");
+
+		uniqueRows.clear();
+		outIndices.clear();
+
+		if (!indices)
+			indexCount = rowCount;
+
+		if (mode == Mode::TrustSourceIndices && indices) {
+			uniqueRows.resize(rowCount);
+			std::iota(uniqueRows.begin(), uniqueRows.end(), 0u);
+
+			outIndices.resize(indexCount);
+			for (size_t i = 0; i < indexCount; ++i) {
+				if (indices[i] >= rowCount)
+					throw std::runtime_error("Vertex index out of range");
+				outIndices[i] = indices[i];
+			}
+			return;
+		}
+
+		this->keyFloats = keyFloats;
+
+		// at most rowCount unique vertices, keeping the load under half means the table never grows
+		size_t capacity = 16;
+		while (capacity < rowCount * 2)
+			capacity <<= 1;
+		const size_t mask = capacity - 1;
+
+		slots.assign(capacity, EMPTY);
+		slotHashes.resize(capacity);
+		remap.assign(rowCount, EMPTY);
+
+		outIndices.resize(indexCount);
+
+		for (size_t i = 0; i < indexCount; ++i) {
+			uint32_t src = indices ? indices[i] : static_cast<uint32_t>(i);
+			if (src >= rowCount)
+				throw std::runtime_error("Vertex index out of range");
+
+			if (remap[src] == EMPTY) {
+				const float* row = rows + size_t(src) * stride;
+				uint32_t hash = hashRow(row);
+
+				size_t slot = hash & mask;
+				while (slots[slot] != EMPTY) {
+					if (slotHashes[slot] == hash && equalRows(rows + size_t(uniqueRows[slots[slot]]) * stride, row))
+						break;
+					slot = (slot + 1) & mask;
+				}
+
+				if (slots[slot] == EMPTY) {
+					slots[slot] = static_cast<uint32_t>(uniqueRows.size());
+					slotHashes[slot] = hash;
+					uniqueRows.push_back(src);
+				}
+
+				remap[src] = slots[slot];
+			}
+
+			outIndices[i] = remap[src];
+		}
+	}
+
+	uint32_t VertexWelder::hashRow(const float* row) const
+	{
+		uint32_t hash = 0;
+
+		for (uint32_t i = 0; i < keyFloats; ++i) {
+			uint32_t word;
+			if (mode == Mode::Epsilon) {
+				int32_t q = quantize(row[i]);
+				std::memcpy(&word, &q, sizeof(word));
+			}
+			else
+				word = keyBits(row[i]);
+
+			hash = mixWord(hash, word);
+		}
+
+		return finalize(hash ^ keyFloats);
+	}
+
+	bool VertexWelder::equalRows(const float* a, const float* b) const
+	{
+		for (uint32_t i = 0; i < keyFloats; ++i) {
+			bool equal = mode == Mode::Epsilon ? quantize(a[i]) == quantize(b[i]) : keyBits(a[i]) == keyBits(b[i]);
+			if (!equal)
+				return false;
+		}
+
+		return true;
+	}
+
+	int32_t VertexWelder::quantize(float value) const
+	{
+		// nan gets a cell of its own and huge values pile up in the end cells instead of overflowing the cast
+		double cell = std::floor(double(value) * invEpsilon + 0.5);
+		if (std::isnan(cell))
+			return INT32_MIN;
+
+		return static_cast<int32_t>(std::clamp(cell, double(INT32_MIN + 1), double(INT32_MAX)));
+	}
+}
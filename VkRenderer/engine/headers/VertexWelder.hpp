@@ -0,0 +1,50 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace VkRenderer {
+	/*
+	 * Merges identical vertices into one index buffer. Vertices are seen as rows of floats and only
+	 * the leading keyFloats of every row are compared, so derived data (tangents) can sit behind it.
+	 * Uses an open addressing table sized up front, so there is no per vertex allocation and every
+	 * source vertex is hashed at most once.
+	 */
+	class VertexWelder
+	{
+		public:
+			enum class Mode {
+				Exact,              // bitwise equal keys are merged
+				TrustSourceIndices, // indexed input is taken as is, only unindexed input gets welded
+				Epsilon             // keys that snap to the same epsilon grid cell are merged, first one wins
+			};
+
+			VertexWelder(Mode mode = Mode::Exact, float epsilon = 1e-5f);
+
+			/*
+			 * indices can be null, the rows are then walked in order.
+			 * uniqueRows receives the source row of every output vertex, outIndices the remapped indices.
+			 */
+			void weld(const float* rows, size_t rowCount, uint32_t stride, uint32_t keyFloats,
+				const uint32_t* indices, size_t indexCount,
+				std::vector<uint32_t>& uniqueRows, std::vector<uint32_t>& outIndices);
+
+			Mode getMode() const { return mode; }
+		private:
+			static constexpr uint32_t EMPTY = ~0u;
+
+			uint32_t hashRow(const float* row) const;
+			bool equalRows(const float* a, const float* b) const;
+			int32_t quantize(float value) const;
+
+			Mode mode;
+			float invEpsilon;
+			uint32_t keyFloats = 0;
+
+			// slot -> index into uniqueRows, hashes are kept next to them for a cheap reject
+			std::vector<uint32_t> slots;
+			std::vector<uint32_t> slotHashes;
+			std::vector<uint32_t> remap;
+	};
+}
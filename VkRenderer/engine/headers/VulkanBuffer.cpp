@@ -48,13 +48,15 @@ namespace VkRenderer {
 
     VulkanBuffer::~VulkanBuffer() {
         unmap();
-        vkDestroyBuffer(device.device(), buffer, nullptr);
-        vkFreeMemory(device.device(), memory, nullptr);
+        device.destroyBuffer(buffer, memory);
     }
 
     /**
      * Map a memory range of this buffer. If successful, mapped points to the specified buffer range.
      *
+     * @note Host visible memory blocks stay mapped for their whole lifetime, this only hands out
+     * the pointer into the block
+     *
      * @param size (Optional) Size of the memory range to map. Pass VK_WHOLE_SIZE to map the complete
      * buffer range.
      * @param offset (Optional) Byte offset from beginning
@@ -62,20 +64,22 @@ namespace VkRenderer {
      * @return VkResult of the buffer mapping call
      */
     VkResult VulkanBuffer::map(VkDeviceSize size, VkDeviceSize offset) {
-        assert(buffer && memory && "Called map on buffer before create");
-        return vkMapMemory(device.device(), memory, offset, size, 0, &mapped);
+        assert(buffer && memory.isValid() && "Called map on buffer before create");
+
+        if (!memory.mapped)
+            return VK_ERROR_MEMORY_MAP_FAILED;
+
+        mapped = static_cast<char*>(memory.mapped) + offset;
+        return VK_SUCCESS;
     }
 
     /**
      * Unmap a mapped memory range
      *
-     * @note Does not return a result as vkUnmapMemory can't fail
+     * @note The block itself stays mapped, see map()
      */
     void VulkanBuffer::unmap() {
-        if (mapped) {
-            vkUnmapMemory(device.device(), memory);
-            mapped = nullptr;
-        }
+        mapped = nullptr;
     }
 
     /**
@@ -112,12 +116,7 @@ namespace VkRenderer {
      * @return VkResult of the flush call
      */
     VkResult VulkanBuffer::flush(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkFlushMappedMemoryRanges(device.device(), 1, &mappedRange);
+        return device.getAllocator().flush(memory, size, offset);
     }
 
     /**
@@ -132,12 +131,7 @@ namespace VkRenderer {
      * @return VkResult of the invalidate call
      */
     VkResult VulkanBuffer::invalidate(VkDeviceSize size, VkDeviceSize offset) {
-        VkMappedMemoryRange mappedRange = {};
-        mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-        mappedRange.memory = memory;
-        mappedRange.offset = offset;
-        mappedRange.size = size;
-        return vkInvalidateMappedMemoryRanges(device.device(), 1, &mappedRange);
+        return device.getAllocator().invalidate(memory, size, offset);
     }
 
     /**
@@ -39,7 +39,7 @@ namespace VkRenderer {
         VulkanDevice& device;
         void* mapped = nullptr;
         VkBuffer buffer = VK_NULL_HANDLE;
-        VkDeviceMemory memory = VK_NULL_HANDLE;
+        VulkanAllocation memory{};
 
         VkDeviceSize bufferSize;
         uint32_t instanceCount;
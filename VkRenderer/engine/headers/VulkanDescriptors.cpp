@@ -207,18 +207,18 @@ namespace VkRenderer {
         return *this;
     }
 
-    VulkanDescriptorWriter& VulkanDescriptorWriter::writeImageArray(uint32_t binding, VkDescriptorImageInfo* images, uint32_t count)
+    VulkanDescriptorWriter& VulkanDescriptorWriter::writeImageArray(uint32_t binding, VkDescriptorImageInfo* images, uint32_t count, uint32_t firstElement)
     {
         assert(setLayout.bindings.count(binding) == 1 && "Layout does not contain specified binding");
         
         auto& bindingDescription = setLayout.bindings[binding];
-        assert(bindingDescription.descriptorCount >= count && "Too many images for binding");
+        assert(bindingDescription.descriptorCount >= firstElement + count && "Too many images for binding");
         assert(bindingDescription.descriptorType == VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER && "Wrong descriptor type");
         
         VkWriteDescriptorSet write{};
         write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
         write.dstBinding = binding;
-        write.dstArrayElement = 0;
+        write.dstArrayElement = firstElement;
         write.descriptorCount = count;
         write.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
         write.pImageInfo = images;
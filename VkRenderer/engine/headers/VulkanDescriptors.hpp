@@ -1,3 +1,4 @@
+#pragma once
 
 #include "VulkanDevice.hpp"
 
@@ -109,7 +110,7 @@ namespace VkRenderer {
         VulkanDescriptorWriter& writeBuffer(uint32_t binding, VkDescriptorBufferInfo* bufferInfo);
         VulkanDescriptorWriter& writeBuffers(std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings, VkDescriptorBufferInfo* bufferInfo);
         VulkanDescriptorWriter& writeImage(uint32_t binding, VkDescriptorImageInfo* imageInfo);
-        VulkanDescriptorWriter& writeImageArray(uint32_t binding, VkDescriptorImageInfo* images, uint32_t count);
+        VulkanDescriptorWriter& writeImageArray(uint32_t binding, VkDescriptorImageInfo* images, uint32_t count, uint32_t firstElement = 0);
 
         bool build(VkDescriptorSet& set);
         void overwrite(VkDescriptorSet& set);
@@ -2,11 +2,14 @@
 
 #include "VulkanCamera.hpp"
 #include "VulkanObject.h"
+#include "VulkanBuffer.hpp"
 
 #include <vulkan/vulkan.h>
 
 namespace VkRenderer {
 	constexpr int MAX_LIGHTS = 10;
+	constexpr int MAX_OBJECTS = 65536;
+	constexpr int MAX_INSTANCES = 262144; // submesh instances, a model usually has more than one
 
 	struct PointLight {
 		glm::vec4 position{};
@@ -27,6 +30,18 @@ namespace VkRenderer {
 		bool sunVisible;
 	};
 
+	// std430 layout, matches ObjectData in shader.vert
+	struct ObjectData {
+		glm::mat4 modelMatrix{ 1.f };
+		glm::mat4 normalMatrix{ 1.f };
+	};
+
+	// one per drawn instance of a submesh, indexed with gl_InstanceIndex. matches InstanceData in shader.vert
+	struct InstanceData {
+		uint32_t objectIndex;
+		uint32_t materialIndex;
+	};
+
 	struct FrameInfo {
 		int frameIndex;
 		float deltaTime;
@@ -34,6 +49,8 @@ namespace VkRenderer {
 		VulkanCamera& camera;
 		VkDescriptorSet globalDescriptorSet;
 		VulkanObject::Map& objects;
+		VulkanBuffer& objectBuffer;
+		VulkanBuffer& instanceBuffer;
 	};
 
 	struct LightingData {
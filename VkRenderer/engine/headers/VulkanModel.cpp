@@ -1,130 +1,547 @@
 #include "VulkanModel.hpp"
 
 #include "VulkanUtils.hpp"
+#include "ThreadPool.hpp"
+#include "VertexQuantization.hpp"
+#include "TangentSpace.hpp"
+#include "MeshCache.hpp"
+#include "managers/material_manager.hpp"
 
 #define TINYGLTF_NO_STB_IMAGE_WRITE
+#define TINYGLTF_NO_EXTERNAL_IMAGE // image files are read by MaterialManager::importMaterials, if at all
 #define TINYGLTF_IMPLEMENTATION
 #include "tiny_gltf.h"
 
-#define GLM_ENABLE_EXPERIMENTAL
-#include <glm/gtx/hash.hpp>
 #include <glm/gtc/type_ptr.hpp>
+#include <glm/gtc/matrix_transform.hpp>
 
 #include "openfbx/ofbx.h"
 
 #include <cassert>
+#include <cmath>
+#include <cstddef>
 #include <cstring>
 #include <filesystem>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <utility>
 namespace fs = std::filesystem;
 
-namespace std {
-	template <>
-	struct hash<VkRenderer::VulkanModel::Vertex> {
-		size_t operator()(VkRenderer::VulkanModel::Vertex const& vertex) const {
-			size_t seed = 0;
-			VkRenderer::hashCombine(seed, vertex.position, vertex.color, vertex.normal, vertex.uv);
-			return seed;
+namespace VkRenderer {
+	namespace {
+		struct DecodedPrimitive {
+			std::vector<VulkanModel::Vertex> vertices;
+			std::vector<uint32_t> indices; // local to this primitive
+		};
+
+		// runs on the thread pool, only reads from the model
+		DecodedPrimitive decodePrimitive(const tinygltf::Model& model, const tinygltf::Primitive& prim, VertexWelder& welder)
+		{
+			using Vertex = VulkanModel::Vertex;
+
+			// the welder sees vertices as rows of floats and compares everything in front of the tangent
+			static_assert(sizeof(Vertex) % sizeof(float) == 0, "Vertex must be tightly packed floats");
+			static_assert(offsetof(Vertex, tangent) + sizeof(glm::vec4) == sizeof(Vertex), "tangent must be the last vertex member");
+
+			DecodedPrimitive result;
+
+			if (prim.mode != -1 && prim.mode != TINYGLTF_MODE_TRIANGLES)
+				return result;
+
+			std::vector<glm::vec3> positions, normals;
+			std::vector<glm::vec2> uvs;
+
+			auto extractVec3 = [&](const std::string& attr, auto& out) {
+				if (!prim.attributes.count(attr)) return;
+				auto& acc = model.accessors[prim.attributes.at(attr)];
+				auto& bv = model.bufferViews[acc.bufferView];
+				auto& buf = model.buffers[bv.buffer];
+				const float* data = reinterpret_cast<const float*>(
+					buf.data.data() + bv.byteOffset + acc.byteOffset
+					);
+				for (size_t i = 0; i < acc.count; ++i)
+					out.emplace_back(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2]);
+				};
+			auto extractVec2 = [&](const std::string& attr, auto& out) {
+				if (!prim.attributes.count(attr)) return;
+				auto& acc = model.accessors[prim.attributes.at(attr)];
+				auto& bv = model.bufferViews[acc.bufferView];
+				auto& buf = model.buffers[bv.buffer];
+				const float* data = reinterpret_cast<const float*>(
+					buf.data.data() + bv.byteOffset + acc.byteOffset
+					);
+				for (size_t i = 0; i < acc.count; ++i)
+					out.emplace_back(data[i * 2 + 0], data[i * 2 + 1]);
+				};
+
+			extractVec3("POSITION", positions);
+			extractVec3("NORMAL", normals);
+			extractVec2("TEXCOORD_0", uvs);
+
+			auto makeVertex = [&](size_t srcIdx) {
+				Vertex v{};
+				v.position = positions[srcIdx];
+				v.normal = (srcIdx < normals.size() ? normals[srcIdx] : glm::vec3(0.0f));
+				v.uv = (srcIdx < uvs.size()
+					? glm::vec2(uvs[srcIdx].x, 1.0f - uvs[srcIdx].y)
+					: glm::vec2(0.0f));
+				v.color = glm::vec3(1.0f);
+				return v;
+				};
+
+			std::vector<Vertex> source(positions.size());
+			for (size_t i = 0; i < positions.size(); ++i)
+				source[i] = makeVertex(i);
+
+			std::vector<uint32_t> sourceIndices;
+
+			if (prim.indices >= 0) {
+				auto& acc = model.accessors[prim.indices];
+				auto& bv = model.bufferViews[acc.bufferView];
+				auto& buf = model.buffers[bv.buffer];
+				const uint8_t* idxData = buf.data.data() + bv.byteOffset + acc.byteOffset;
+
+				sourceIndices.resize(acc.count);
+
+				for (size_t i = 0; i < acc.count; ++i) {
+					switch (acc.componentType) {
+					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
+						sourceIndices[i] = reinterpret_cast<const uint8_t*>(idxData)[i]; break;
+					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
+						sourceIndices[i] = reinterpret_cast<const uint16_t*>(idxData)[i]; break;
+					case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
+						sourceIndices[i] = reinterpret_cast<const uint32_t*>(idxData)[i]; break;
+					default:
+						throw std::runtime_error("Unsupported index type");
+					}
+				}
+			}
+
+			std::vector<uint32_t> uniqueRows;
+			welder.weld(reinterpret_cast<const float*>(source.data()), source.size(),
+				sizeof(Vertex) / sizeof(float), offsetof(Vertex, tangent) / sizeof(float),
+				prim.indices >= 0 ? sourceIndices.data() : nullptr, sourceIndices.size(),
+				uniqueRows, result.indices);
+
+			result.vertices.resize(uniqueRows.size());
+			for (size_t i = 0; i < uniqueRows.size(); ++i)
+				result.vertices[i] = source[uniqueRows[i]];
+
+			return result;
 		}
-	};
-}
 
-namespace VkRenderer {
-	VulkanModel::VulkanModel(VulkanDevice& device, const VulkanModel::Builder &builder)
-		: device{device}
+		void collectMaterials(tinygltf::Model& model, VulkanModel::Builder& builder)
+		{
+			// geometry is decoded at this point, so the buffers can be handed over to the images that live in them
+			std::vector<std::shared_ptr<const std::vector<unsigned char>>> buffers(model.buffers.size());
+
+			builder.images.resize(model.images.size());
+			for (size_t i = 0; i < model.images.size(); ++i) {
+				auto& image = model.images[i];
+
+				if (!image.uri.empty())
+					tinygltf::URIDecode(image.uri, &builder.images[i].uri, nullptr);
+
+				if (image.bufferView >= 0) {
+					auto& bv = model.bufferViews[image.bufferView];
+					if (!buffers[bv.buffer])
+						buffers[bv.buffer] = std::make_shared<const std::vector<unsigned char>>(std::move(model.buffers[bv.buffer].data));
+
+					builder.images[i].buffer = buffers[bv.buffer];
+					builder.images[i].byteOffset = bv.byteOffset;
+					builder.images[i].byteLength = bv.byteLength;
+				}
+				else
+					builder.images[i].encoded = std::move(image.image);
+			}
+
+			auto textureImage = [&](int texture) {
+				return texture >= 0 && texture < static_cast<int>(model.textures.size()) ? model.textures[texture].source : -1;
+			};
+
+			for (auto& material : model.materials) {
+				VulkanModel::MaterialSource source{};
+				source.name = material.name;
+				source.albedoImage = textureImage(material.pbrMetallicRoughness.baseColorTexture.index);
+				source.normalImage = textureImage(material.normalTexture.index);
+				builder.materials.push_back(std::move(source));
+			}
+		}
+
+		// the full level of every submesh as drawn, so it holds up after the passes that move or split the index ranges
+		VertexCacheStats analyzeSubmeshCache(const VulkanModel::Builder& builder)
+		{
+			if (builder.submeshes.empty())
+				return analyzeVertexCache(builder.indices.data(), builder.indices.size(), builder.vertices.size());
+
+			std::vector<uint32_t> drawn;
+			for (const VulkanModel::Submesh& submesh : builder.submeshes)
+				for (uint32_t i = 0; i < submesh.indexCount; i++)
+					drawn.push_back(builder.indices[submesh.firstIndex + i] + submesh.vertexOffset);
+
+			return analyzeVertexCache(drawn.data(), drawn.size(), builder.vertices.size());
+		}
+	}
+
+	VulkanModel::VulkanModel(VulkanDevice& device, GeometryPool& geometryPool, const VulkanModel::Builder &builder)
+		: device{device}, geometryPool{geometryPool}
 	{
-		createVertexBuffers(builder.vertices);
-		createIndexBuffers(builder.indices);
+		vertexCount = static_cast<uint32_t>(builder.vertices.size());
+		assert(vertexCount >= 3 && "Vertex count must be atleast 3");
+
+		// every model is drawn indexed so the indirect path can treat them all the same
+		indexCount = builder.indices.empty() ? vertexCount : static_cast<uint32_t>(builder.indices.size());
+
+		vertexLayout = resolveVertexLayout(builder);
+		indexType = resolveIndexType(builder);
+		uint32_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		allocation = geometryPool.allocate(getVertexStride(vertexLayout), vertexCount, indexSize, indexCount);
+
+		// straight into staging memory, no intermediate copies
+		GeometryPool::Staging staging = geometryPool.beginUpload(allocation);
+		dequantization = writeVertices(vertexLayout, builder.vertices, staging.vertexData);
+		writeIndices(builder, indexType, staging.indexData);
+		uploadTicket = geometryPool.endUpload(allocation, staging);
+
+		uploadMeshlets(resolveMeshlets(builder, dequantization));
+
+		submeshes = resolveSubmeshes(builder, lodCount);
+		bounds = resolveBounds(builder);
+		computeLodErrors();
 	}
 
-	VulkanModel::~VulkanModel() {}
+	VulkanModel::VulkanModel(VulkanDevice& device, GeometryPool& geometryPool, const Cooked& cooked)
+		: device{ device }, geometryPool{ geometryPool }
+	{
+		vertexCount = cooked.vertexCount;
+		indexCount = cooked.indexCount;
+		assert(vertexCount >= 3 && "Vertex count must be atleast 3");
+
+		vertexLayout = cooked.vertexLayout;
+		indexType = cooked.indexType;
+		uint32_t indexSize = indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+
+		// already in the uploaded layout, a plain copy into staging
+		allocation = geometryPool.allocate(getVertexStride(vertexLayout), vertexCount, indexSize, indexCount);
+		uploadTicket = geometryPool.upload(allocation, cooked.vertexData, cooked.indexData);
+
+		dequantization = cooked.dequantization;
+		uploadMeshlets(std::vector<Meshlet>(cooked.meshlets, cooked.meshlets + cooked.meshletCount));
 
-	std::unique_ptr<VulkanModel> VulkanModel::createModelFromFile(VulkanDevice& device, const std::string& filepath)
+		submeshes.assign(cooked.submeshes, cooked.submeshes + cooked.submeshCount);
+		lodCount = std::clamp(cooked.lodCount, 1u, MAX_LODS);
+		bounds = cooked.bounds;
+		computeLodErrors();
+	}
+
+	VulkanModel::~VulkanModel() 
+	{
+		geometryPool.freeMeshlets(meshletAllocation);
+		geometryPool.free(allocation);
+	}
+
+	VulkanModel::VertexLayout VulkanModel::resolveVertexLayout(const Builder& builder)
+	{
+		if (builder.vertexLayout != VertexLayout::Compact)
+			return builder.vertexLayout;
+
+		bool usesColor = std::any_of(builder.vertices.begin(), builder.vertices.end(), [](const Vertex& v) { return v.color != glm::vec3(1.0f); });
+		return usesColor ? VertexLayout::Full : VertexLayout::Compact;
+	}
+
+	VkIndexType VulkanModel::resolveIndexType(const Builder& builder)
+	{
+		// 16 bit whenever every index fits, which is most props and everything run through splitFor16BitIndices
+		uint32_t maxIndex = builder.indices.empty()
+			? static_cast<uint32_t>(builder.vertices.size()) - 1
+			: *std::max_element(builder.indices.begin(), builder.indices.end());
+		return maxIndex <= UINT16_MAX ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+	}
+
+	glm::mat4 VulkanModel::writeVertices(VertexLayout layout, const std::vector<Vertex>& vertices, void* destination)
 	{
-		Builder builder{};
+		if (layout == VertexLayout::Compact)
+			return writeCompactVertices(vertices, destination);
+
+		memcpy(destination, vertices.data(), vertices.size() * sizeof(Vertex));
+		return glm::mat4(1.f);
+	}
+
+	void VulkanModel::writeIndices(const Builder& builder, VkIndexType indexType, void* destination)
+	{
+		bool generateIndices = builder.indices.empty();
+		size_t count = generateIndices ? builder.vertices.size() : builder.indices.size();
+
+		if (indexType == VK_INDEX_TYPE_UINT16) {
+			uint16_t* indices = static_cast<uint16_t*>(destination);
+			if (generateIndices)
+				std::iota(indices, indices + count, uint16_t(0));
+			else
+				std::transform(builder.indices.begin(), builder.indices.end(), indices, [](uint32_t index) { return static_cast<uint16_t>(index); });
+		}
+		else {
+			uint32_t* indices = static_cast<uint32_t*>(destination);
+			if (generateIndices)
+				std::iota(indices, indices + count, 0);
+			else
+				memcpy(indices, builder.indices.data(), count * sizeof(uint32_t));
+		}
+	}
+
+	std::vector<VulkanModel::Submesh> VulkanModel::resolveSubmeshes(const Builder& builder, uint32_t& lodCount)
+	{
+		std::vector<Submesh> submeshes = builder.submeshes;
+		if (submeshes.empty())
+			submeshes.push_back({ 0, builder.indices.empty() ? static_cast<uint32_t>(builder.vertices.size()) : static_cast<uint32_t>(builder.indices.size()), 0, -1 });
+
+		// levels createLods left out repeat the one before, so every submesh has every level
+		lodCount = std::clamp(builder.lodCount, 1u, MAX_LODS);
+		for (Submesh& submesh : submeshes) {
+			submesh.lods[0] = { submesh.firstIndex, submesh.indexCount, 0.0f };
+			for (uint32_t lod = 1; lod < lodCount; lod++)
+				if (submesh.lods[lod].indexCount == 0)
+					submesh.lods[lod] = submesh.lods[lod - 1];
+
+			if (submesh.bounds.isEmpty())
+				submesh.bounds = computeSubmeshBounds(builder, submesh);
+		}
+
+		return submeshes;
+	}
+
+	std::vector<Meshlet> VulkanModel::resolveMeshlets(const Builder& builder, const glm::mat4& dequantization)
+	{
+		// centers go into the same space as the stored positions so the culling pass can use the object matrix,
+		// radii stay in model units and get scaled by the object transform
+		glm::mat4 quantization = glm::inverse(dequantization);
+
+		std::vector<Meshlet> meshlets = builder.meshlets;
+		for (Meshlet& meshlet : meshlets)
+			meshlet.sphere = glm::vec4(glm::vec3(quantization * glm::vec4(glm::vec3(meshlet.sphere), 1.0f)), meshlet.sphere.w);
+
+		return meshlets;
+	}
+
+	Bounds VulkanModel::resolveBounds(const Builder& builder)
+	{
+		if (!builder.bounds.isEmpty())
+			return builder.bounds;
+
+		return computeBounds(reinterpret_cast<const float*>(builder.vertices.data()), builder.vertices.size(), sizeof(Vertex) / sizeof(float));
+	}
+
+	Bounds VulkanModel::computeSubmeshBounds(const Builder& builder, const Submesh& submesh)
+	{
+		const float* vertexData = reinterpret_cast<const float*>(builder.vertices.data());
+		constexpr size_t stride = sizeof(Vertex) / sizeof(float);
+
+		// without indices the ranges go straight over the vertices
+		if (builder.indices.empty())
+			return computeBounds(vertexData + size_t(submesh.firstIndex) * stride, submesh.indexCount, stride);
+
+		return computeBounds(vertexData, builder.vertices.size(), stride, builder.indices.data() + submesh.firstIndex, submesh.indexCount, submesh.vertexOffset);
+	}
+
+	void VulkanModel::uploadMeshlets(std::vector<Meshlet> meshlets)
+	{
+		if (meshlets.empty())
+			return;
+
+		for (Meshlet& meshlet : meshlets) {
+			meshlet.firstIndex += allocation.firstIndex;
+			meshlet.vertexOffset += allocation.vertexOffset;
+		}
+
+		meshletAllocation = geometryPool.allocateMeshlets(static_cast<uint32_t>(meshlets.size()));
+		uploadTicket = std::max(uploadTicket, geometryPool.uploadMeshlets(meshletAllocation, meshlets.data()));
+	}
+
+	void VulkanModel::computeLodErrors()
+	{
+		for (const Submesh& submesh : submeshes)
+			for (uint32_t lod = 1; lod < lodCount; lod++)
+				lodErrors[lod] = std::max(lodErrors[lod], submesh.lods[lod].error);
+	}
+
+	void VulkanModel::configureFileBuilder(Builder& builder, bool materials)
+	{
+		builder.imageMode = materials ? ImageMode::Defer : ImageMode::Skip;
+		builder.vertexLayout = VertexLayout::Compact;
+		builder.split16BitIndices = true;
+		builder.optimizeMesh = true;
+		builder.generateMeshlets = true;
+		builder.lodCount = MAX_LODS;
+	}
+
+	VulkanModel::FileData::~FileData() = default;
+
+	std::unique_ptr<VulkanModel> VulkanModel::createModelFromFile(VulkanDevice& device, GeometryPool& geometryPool, const std::string& filepath, MaterialManager* materialManager)
+	{
+		std::unique_ptr<FileData> file = loadFile(filepath, materialManager != nullptr);
+		return createModel(device, geometryPool, *file, materialManager);
+	}
+
+	std::unique_ptr<VulkanModel::FileData> VulkanModel::loadFile(const std::string& filepath, bool materials)
+	{
+		auto file = std::make_unique<FileData>();
+		file->filepath = filepath;
+
+		Builder& builder = file->builder;
+		configureFileBuilder(builder, materials);
+
+		// a current cache file skips the whole import, the geometry goes from the mapped file to staging
+		if ((file->cached = GetMeshCache().load(filepath, builder))) {
+			std::cout << "Model '" << filepath << "' loaded from " << file->cached->getPath() << "\n";
+
+			builder.directory = file->cached->directory;
+			builder.images = std::move(file->cached->images);
+			builder.materials = std::move(file->cached->materials);
+			return file;
+		}
+
 		builder.loadModel(filepath);
 
-		return std::make_unique<VulkanModel>(device, builder);
+		std::cout << "Model '" << filepath << "' acmr " << builder.cacheStatsBefore.acmr << " -> " << builder.cacheStatsAfter.acmr
+			<< ", atvr " << builder.cacheStatsBefore.atvr << " -> " << builder.cacheStatsAfter.atvr << "\n";
+
+		// stored before the material ids are filled in, they belong to this run's material manager
+		if (!GetMeshCache().store(filepath, builder))
+			std::cerr << "Failed to write the mesh cache for '" << filepath << "'\n";
+
+		return file;
 	}
 
-	void VulkanModel::bind(VkCommandBuffer commandBuffer)
+	std::unique_ptr<VulkanModel> VulkanModel::createModel(VulkanDevice& device, GeometryPool& geometryPool, FileData& file, MaterialManager* materialManager)
 	{
-		VkBuffer buffers[] = { vertexBuffer->getBuffer()};
-		VkDeviceSize offsets[] = { 0 };
-		vkCmdBindVertexBuffers(commandBuffer, 0, 1, buffers, offsets);
+		Builder& builder = file.builder;
+
+		auto assignMaterials = [&](std::vector<Submesh>& submeshes) {
+			if (materialManager == nullptr || builder.materials.empty())
+				return;
+
+			std::vector<uint32_t> materialIds = materialManager->importMaterials(builder, fs::path(file.filepath).filename().string());
+
+			for (auto& submesh : submeshes) {
+				if (submesh.material >= 0 && submesh.material < static_cast<int32_t>(materialIds.size()))
+					submesh.materialId = static_cast<int32_t>(materialIds[submesh.material]);
+			}
+		};
+
+		if (file.cached) {
+			const Cooked& cached = file.cached->cooked;
+			std::vector<Submesh> submeshes(cached.submeshes, cached.submeshes + cached.submeshCount);
+			assignMaterials(submeshes);
 
-		if (hasIndexBuffer) {
-			vkCmdBindIndexBuffer(commandBuffer, indexBuffer->getBuffer(), 0, VK_INDEX_TYPE_UINT32);
+			Cooked cooked = cached;
+			cooked.submeshes = submeshes.data();
+			return std::make_unique<VulkanModel>(device, geometryPool, cooked);
 		}
+
+		assignMaterials(builder.submeshes);
+
+		return std::make_unique<VulkanModel>(device, geometryPool, builder);
+	}
+
+	void VulkanModel::bind(VkCommandBuffer commandBuffer)
+	{
+		geometryPool.bind(commandBuffer, indexType);
 	}
 
 	void VulkanModel::draw(VkCommandBuffer commandBuffer)
 	{
-		if (hasIndexBuffer) 
-			vkCmdDrawIndexed(commandBuffer, indexCount, 1, 0, 0, 0);
-		else
-			vkCmdDraw(commandBuffer, vertexCount, 1, 0, 0);
+		// per submesh since split models need their vertex offsets and the lod ranges sit behind the full mesh
+		for (size_t submesh = 0; submesh < submeshes.size(); submesh++)
+			drawSubmesh(commandBuffer, submesh);
 	}
 
-	void VulkanModel::createVertexBuffers(const std::vector<Vertex>& vertices)
+	void VulkanModel::drawSubmesh(VkCommandBuffer commandBuffer, size_t submesh, uint32_t lod)
 	{
-		vertexCount = static_cast<uint32_t>(vertices.size());
-		assert(vertexCount >= 3 && "Vertex count must be atleast 3");
+		const Submesh& range = submeshes[submesh];
+		const Lod& level = range.lods[std::min(lod, lodCount - 1)];
+		vkCmdDrawIndexed(commandBuffer, level.indexCount, 1, allocation.firstIndex + level.firstIndex, allocation.vertexOffset + range.vertexOffset, 0);
+	}
+
+	glm::mat4 VulkanModel::writeCompactVertices(const std::vector<Vertex>& vertices, void* destination)
+	{
+		glm::vec3 minimum = vertices[0].position;
+		glm::vec3 maximum = vertices[0].position;
+		for (auto& vertex : vertices) {
+			minimum = glm::min(minimum, vertex.position);
+			maximum = glm::max(maximum, vertex.position);
+		}
 
-		VkDeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
-		uint32_t vertexSize = sizeof(vertices[0]);
+		// snorm covers [-1, 1], so the bounds are stored as center and half extent
+		glm::vec3 center = (minimum + maximum) * 0.5f;
+		glm::vec3 extent = glm::max((maximum - minimum) * 0.5f, glm::vec3(1e-6f));
 
-		VulkanBuffer stagingBuffer{
-			device,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+		glm::mat4 dequantization = glm::scale(glm::translate(glm::mat4(1.f), center), extent);
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)vertices.data());
+		CompactVertex* out = static_cast<CompactVertex*>(destination);
+		for (size_t i = 0; i < vertices.size(); i++) {
+			const Vertex& vertex = vertices[i];
+			CompactVertex& packed = out[i];
 
-		vertexBuffer = std::make_unique<VulkanBuffer>(
-			device,
-			vertexSize,
-			vertexCount,
-			VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-		);
-	
-		device.copyBuffer(stagingBuffer.getBuffer(), vertexBuffer->getBuffer(), bufferSize);
+			glm::vec3 position = (vertex.position - center) / extent;
+			packed.position[0] = quantizeSnorm16(position.x);
+			packed.position[1] = quantizeSnorm16(position.y);
+			packed.position[2] = quantizeSnorm16(position.z);
+			packed.position[3] = vertex.tangent.w < 0.0f ? -32767 : 32767;
+
+			glm::vec2 normal = octEncode(vertex.normal);
+			packed.normal[0] = quantizeSnorm16(normal.x);
+			packed.normal[1] = quantizeSnorm16(normal.y);
+
+			glm::vec2 tangent = octEncode(glm::vec3(vertex.tangent));
+			packed.tangent[0] = quantizeSnorm16(tangent.x);
+			packed.tangent[1] = quantizeSnorm16(tangent.y);
+
+			packed.uv[0] = floatToHalf(vertex.uv.x);
+			packed.uv[1] = floatToHalf(vertex.uv.y);
+		}
+
+		return dequantization;
 	}
 
-	void VulkanModel::createIndexBuffers(const std::vector<uint32_t>& indices)
+	static_assert(sizeof(VulkanModel::CompactVertex) == 20, "CompactVertex has to stay tightly packed");
+
+	uint32_t VulkanModel::getVertexStride(VertexLayout layout)
 	{
-		indexCount = static_cast<uint32_t>(indices.size());
-		hasIndexBuffer = indexCount > 0;
+		return layout == VertexLayout::Compact ? sizeof(CompactVertex) : sizeof(Vertex);
+	}
 
-		if (!hasIndexBuffer) return;
+	std::vector<VkVertexInputBindingDescription> VulkanModel::getBindingDescriptions(VertexLayout layout)
+	{
+		return layout == VertexLayout::Compact ? CompactVertex::getBindingDescriptions() : Vertex::getBindingDescriptions();
+	}
 
-		VkDeviceSize bufferSize = sizeof(indices[0]) * indexCount;
-		uint32_t indexSize = sizeof(indices[0]);
+	std::vector<VkVertexInputAttributeDescription> VulkanModel::getAttributeDescriptions(VertexLayout layout)
+	{
+		return layout == VertexLayout::Compact ? CompactVertex::getAttributeDescriptions() : Vertex::getAttributeDescriptions();
+	}
 
-		VulkanBuffer stagingBuffer{
-			device,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
+	std::vector<VkVertexInputBindingDescription> VulkanModel::CompactVertex::getBindingDescriptions()
+	{
+		std::vector<VkVertexInputBindingDescription> bindingDescriptions(1);
+		bindingDescriptions[0].binding = 0;
+		bindingDescriptions[0].stride = sizeof(CompactVertex);
+		bindingDescriptions[0].inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescriptions;
+	}
 
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer((void*)indices.data());
+	std::vector<VkVertexInputAttributeDescription> VulkanModel::CompactVertex::getAttributeDescriptions()
+	{
+		std::vector<VkVertexInputAttributeDescription> attributeDescriptions{};
 
-		indexBuffer = std::make_unique<VulkanBuffer>(
-			device,
-			indexSize,
-			indexCount,
-			VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-		);
+		// no color at location 1, the shader variant assumes white
+		attributeDescriptions.push_back({ 0, 0, VK_FORMAT_R16G16B16A16_SNORM, offsetof(CompactVertex, position) });
+		attributeDescriptions.push_back({ 2, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, normal) });
+		attributeDescriptions.push_back({ 3, 0, VK_FORMAT_R16G16_SFLOAT, offsetof(CompactVertex, uv) });
+		attributeDescriptions.push_back({ 4, 0, VK_FORMAT_R16G16_SNORM, offsetof(CompactVertex, tangent) });
 
-		device.copyBuffer(stagingBuffer.getBuffer(), indexBuffer->getBuffer(), bufferSize);
+		return attributeDescriptions;
 	}
 
 	std::vector<VkVertexInputBindingDescription> VulkanModel::Vertex::getBindingDescriptions()
@@ -153,7 +570,11 @@ namespace VkRenderer {
     void VulkanModel::Builder::loadModel(const std::string& filepath) {
         vertices.clear();
         indices.clear();
-        std::unordered_map<Vertex, uint32_t> uniqueVertices{};
+        submeshes.clear();
+        images.clear();
+        materials.clear();
+        directory = fs::path(filepath).parent_path().string();
+        sourceFiles = { filepath };
 
         const std::string extension = fs::path(filepath).extension().string();
 
@@ -162,91 +583,76 @@ namespace VkRenderer {
             tinygltf::TinyGLTF loader;
             std::string err, warn;
 
+            // never decode here. buffer view images are picked up from the buffer later, only data uris need their bytes copied
+            loader.SetImageLoader([](tinygltf::Image* image, const int, std::string*, std::string*, int, int, const unsigned char* bytes, int size, void* userData) {
+                ImageMode mode = *static_cast<const ImageMode*>(userData);
+                if (mode == ImageMode::Defer && image->bufferView < 0)
+                    image->image.assign(bytes, bytes + size);
+                return true;
+            }, &imageMode);
+
             bool ok = (extension == ".glb")
                 ? loader.LoadBinaryFromFile(&model, &err, &warn, filepath)
                 : loader.LoadASCIIFromFile(&model, &err, &warn, filepath);
             if (!ok)
                 throw std::runtime_error("Failed to load glTF: " + warn + err);
 
-            for (auto& mesh : model.meshes) {
-                for (auto& prim : mesh.primitives) {
-                    std::vector<glm::vec3> positions, normals;
-                    std::vector<glm::vec2> uvs;
-
-                    auto extractVec3 = [&](const std::string& attr, auto& out) {
-                        if (!prim.attributes.count(attr)) return;
-                        auto& acc = model.accessors[prim.attributes.at(attr)];
-                        auto& bv = model.bufferViews[acc.bufferView];
-                        auto& buf = model.buffers[bv.buffer];
-                        const float* data = reinterpret_cast<const float*>(
-                            buf.data.data() + bv.byteOffset + acc.byteOffset
-                            );
-                        for (size_t i = 0; i < acc.count; ++i)
-                            out.emplace_back(data[i * 3 + 0], data[i * 3 + 1], data[i * 3 + 2]);
-                        };
-                    auto extractVec2 = [&](const std::string& attr, auto& out) {
-                        if (!prim.attributes.count(attr)) return;
-                        auto& acc = model.accessors[prim.attributes.at(attr)];
-                        auto& bv = model.bufferViews[acc.bufferView];
-                        auto& buf = model.buffers[bv.buffer];
-                        const float* data = reinterpret_cast<const float*>(
-                            buf.data.data() + bv.byteOffset + acc.byteOffset
-                            );
-                        for (size_t i = 0; i < acc.count; ++i)
-                            out.emplace_back(data[i * 2 + 0], data[i * 2 + 1]);
-                        };
-
-                    extractVec3("POSITION", positions);
-                    extractVec3("NORMAL", normals);
-                    extractVec2("TEXCOORD_0", uvs);
-
-                    for (size_t i = 0; i < positions.size(); ++i) {
-                        Vertex v{};
-                        v.position = positions[i];
-                        v.normal = (i < normals.size() ? normals[i] : glm::vec3(0.0f));
-                        v.uv = (i < uvs.size() ? glm::vec2(uvs[i].x, 1.0f - uvs[i].y)
-                            : glm::vec2(0.0f));
-                        v.color = glm::vec3(1.0f);
-
-                        if (!uniqueVertices.count(v)) {
-                            uniqueVertices[v] = (uint32_t)vertices.size();
-                            vertices.push_back(v);
-                        }
-                    }
+            for (auto& buffer : model.buffers) {
+                if (buffer.uri.empty() || tinygltf::IsDataURI(buffer.uri))
+                    continue;
 
-                    auto& acc = model.accessors[prim.indices];
-                    auto& bv = model.bufferViews[acc.bufferView];
-                    auto& buf = model.buffers[bv.buffer];
-                    const uint8_t* idxData = buf.data.data() + bv.byteOffset + acc.byteOffset;
-
-                    for (size_t i = 0; i < acc.count; ++i) {
-                        uint32_t srcIdx;
-                        switch (acc.componentType) {
-                        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_BYTE:
-                            srcIdx = reinterpret_cast<const uint8_t*>(idxData)[i]; break;
-                        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_SHORT:
-                            srcIdx = reinterpret_cast<const uint16_t*>(idxData)[i]; break;
-                        case TINYGLTF_COMPONENT_TYPE_UNSIGNED_INT:
-                            srcIdx = reinterpret_cast<const uint32_t*>(idxData)[i]; break;
-                        default:
-                            throw std::runtime_error("Unsupported index type");
-                        }
+                std::string uri;
+                tinygltf::URIDecode(buffer.uri, &uri, nullptr);
+                sourceFiles.push_back((fs::path(directory) / uri).string());
+            }
 
-                        Vertex v{};
-                        v.position = positions[srcIdx];
-                        v.normal = (srcIdx < normals.size() ? normals[srcIdx] : glm::vec3(0.0f));
-                        v.uv = (srcIdx < uvs.size()
-                            ? glm::vec2(uvs[srcIdx].x, 1.0f - uvs[srcIdx].y)
-                            : glm::vec2(0.0f));
-                        v.color = glm::vec3(1.0f);
-
-                        auto it = uniqueVertices.find(v);
-                        if (it == uniqueVertices.end())
-                            throw std::runtime_error("Vertex dedupe mismatch");
-                        indices.push_back(it->second);
-                    }
-                }
+            // flatten so every primitive can be decoded on its own
+            std::vector<const tinygltf::Primitive*> primitives;
+            for (auto& mesh : model.meshes)
+                for (auto& prim : mesh.primitives)
+                    primitives.push_back(&prim);
+
+            std::vector<DecodedPrimitive> decoded(primitives.size());
+            GetThreadPool().parallelFor(primitives.size(), [&](size_t i) {
+                VertexWelder welder(weldMode, weldEpsilon);
+                decoded[i] = decodePrimitive(model, *primitives[i], welder);
+            });
+
+            // prefix sums over the per primitive counts give every primitive a fixed spot, so the
+            // merged result is the same no matter which thread finished first
+            std::vector<size_t> vertexBase(decoded.size() + 1, 0);
+            std::vector<size_t> indexBase(decoded.size() + 1, 0);
+            for (size_t i = 0; i < decoded.size(); ++i) {
+                vertexBase[i + 1] = vertexBase[i] + decoded[i].vertices.size();
+                indexBase[i + 1] = indexBase[i] + decoded[i].indices.size();
             }
+
+            vertices.resize(vertexBase.back());
+            indices.resize(indexBase.back());
+
+            for (size_t i = 0; i < decoded.size(); ++i) {
+                if (decoded[i].indices.empty())
+                    continue;
+
+                submeshes.push_back({
+                    static_cast<uint32_t>(indexBase[i]),
+                    static_cast<uint32_t>(decoded[i].indices.size()),
+                    0,
+                    primitives[i]->material
+                });
+            }
+
+            GetThreadPool().parallelFor(decoded.size(), [&](size_t i) {
+                auto& prim = decoded[i];
+                std::copy(prim.vertices.begin(), prim.vertices.end(), vertices.begin() + vertexBase[i]);
+
+                uint32_t base = static_cast<uint32_t>(vertexBase[i]);
+                for (size_t j = 0; j < prim.indices.size(); ++j)
+                    indices[indexBase[i] + j] = prim.indices[j] + base;
+            });
+
+            if (imageMode == ImageMode::Defer)
+                collectMaterials(model, *this);
         }
         /*else if (extension == ".fbx") {
             std::ifstream file(filepath, std::ios::binary | std::ios::ate);
@@ -327,35 +733,306 @@ namespace VkRenderer {
             throw std::runtime_error("Unsupported model format: " + extension);
 
         // Tangents
-        std::vector<glm::vec3> tangents(vertices.size(), glm::vec3(0.0f));
-        for (size_t i = 0; i < indices.size(); i += 3) {
-            auto i0 = indices[i + 0], i1 = indices[i + 1], i2 = indices[i + 2];
-            auto& p0 = vertices[i0].position;
-            auto& p1 = vertices[i1].position;
-            auto& p2 = vertices[i2].position;
-            auto& uv0 = vertices[i0].uv;
-            auto& uv1 = vertices[i1].uv;
-            auto& uv2 = vertices[i2].uv;
-
-            auto edge1 = p1 - p0;
-            auto edge2 = p2 - p0;
-            auto duv1 = uv1 - uv0;
-            auto duv2 = uv2 - uv0;
-
-            float f = 1.0f / (duv1.x * duv2.y - duv2.x * duv1.y);
-            glm::vec3 tangent = f * (duv2.y * edge1 - duv1.y * edge2);
-
-            tangents[i0] += tangent;
-            tangents[i1] += tangent;
-            tangents[i2] += tangent;
-        }
+        generateTangents(reinterpret_cast<float*>(vertices.data()), vertices.size(), sizeof(Vertex) / sizeof(float),
+            offsetof(Vertex, normal) / sizeof(float), offsetof(Vertex, uv) / sizeof(float), offsetof(Vertex, tangent) / sizeof(float),
+            indices.data(), indices.size());
 
-        for (size_t i = 0; i < vertices.size(); ++i) {
-            auto& N = vertices[i].normal;
-            auto& T = tangents[i];
-            glm::vec3 t = glm::normalize(T - N * glm::dot(N, T));
-            float handed = (glm::dot(glm::cross(N, T), glm::cross(N, t)) < 0.0f) ? -1.0f : 1.0f;
-            vertices[i].tangent = glm::vec4(t, handed);
-        }
+        if (optimizeMesh)
+            optimize();
+
+        if (split16BitIndices)
+            splitFor16BitIndices();
+
+        if (generateMeshlets)
+            createMeshlets();
+
+        if (lodCount > 1)
+            createLods();
+
+        if (optimizeMesh)
+            cacheStatsAfter = analyzeSubmeshCache(*this);
+
+        // after every pass that could split or move the submeshes
+        computeBounds();
     }
-}
\ No newline at end of file
+
+	void VulkanModel::Builder::splitFor16BitIndices()
+	{
+		constexpr uint32_t MAX_CHUNK_VERTICES = UINT16_MAX + 1;
+
+		if (vertices.size() <= MAX_CHUNK_VERTICES || indices.empty())
+			return;
+
+		if (submeshes.empty())
+			submeshes.push_back({ 0, static_cast<uint32_t>(indices.size()) });
+
+		std::vector<Vertex> outVertices;
+		std::vector<uint32_t> outIndices;
+		std::vector<Submesh> outSubmeshes;
+		outVertices.reserve(vertices.size());
+		outIndices.reserve(indices.size());
+
+		// remap[v] is the chunk local index of vertex v, only valid while stamp[v] is the current chunk
+		std::vector<uint32_t> remap(vertices.size());
+		std::vector<uint32_t> stamp(vertices.size(), 0);
+		uint32_t chunk = 0;
+		uint32_t chunkVertexCount = 0;
+
+		for (const Submesh& submesh : submeshes) {
+			Submesh current = submesh;
+
+			auto startChunk = [&]() {
+				chunk++;
+				chunkVertexCount = 0;
+				current.firstIndex = static_cast<uint32_t>(outIndices.size());
+				current.indexCount = 0;
+				current.vertexOffset = static_cast<int32_t>(outVertices.size());
+			};
+
+			startChunk();
+
+			// whole triangles only, a chunk is closed as soon as the next one would not fit
+			for (uint32_t i = 0; i + 2 < submesh.indexCount; i += 3) {
+				uint32_t triangle[3];
+				uint32_t newVertices = 0;
+
+				for (uint32_t k = 0; k < 3; k++) {
+					triangle[k] = indices[submesh.firstIndex + i + k] + submesh.vertexOffset;
+
+					bool seen = stamp[triangle[k]] == chunk;
+					for (uint32_t j = 0; j < k; j++)
+						seen = seen || triangle[j] == triangle[k];
+
+					if (!seen)
+						newVertices++;
+				}
+
+				if (chunkVertexCount + newVertices > MAX_CHUNK_VERTICES) {
+					outSubmeshes.push_back(current);
+					startChunk();
+				}
+
+				for (uint32_t vertex : triangle) {
+					if (stamp[vertex] != chunk) {
+						stamp[vertex] = chunk;
+						remap[vertex] = chunkVertexCount++;
+						outVertices.push_back(vertices[vertex]);
+					}
+
+					outIndices.push_back(remap[vertex]);
+					current.indexCount++;
+				}
+			}
+
+			if (current.indexCount > 0)
+				outSubmeshes.push_back(current);
+		}
+
+		vertices = std::move(outVertices);
+		indices = std::move(outIndices);
+		submeshes = std::move(outSubmeshes);
+	}
+
+	void VulkanModel::Builder::optimize()
+	{
+		if (indices.empty())
+			return;
+
+		// back to model wide indices, the fetch pass reorders vertices across submeshes
+		for (Submesh& submesh : submeshes) {
+			for (uint32_t i = 0; i < submesh.indexCount; i++)
+				indices[submesh.firstIndex + i] += submesh.vertexOffset;
+			submesh.vertexOffset = 0;
+		}
+
+		std::vector<std::pair<uint32_t, uint32_t>> ranges;
+		for (const Submesh& submesh : submeshes)
+			ranges.emplace_back(submesh.firstIndex, submesh.indexCount);
+		if (ranges.empty())
+			ranges.emplace_back(0, static_cast<uint32_t>(indices.size()));
+
+		cacheStatsBefore = analyzeVertexCache(indices.data(), indices.size(), vertices.size());
+
+		// submeshes are drawn on their own, so every one is optimized on its own and they can run in parallel
+		GetThreadPool().parallelFor(ranges.size(), [&](size_t r) {
+			uint32_t* first = indices.data() + ranges[r].first;
+			uint32_t* last = first + ranges[r].second;
+			if (first == last)
+				return;
+
+			// rebase onto the vertices the submesh uses, the loader keeps them together
+			auto [minIndex, maxIndex] = std::minmax_element(first, last);
+			uint32_t base = *minIndex;
+			size_t vertexCount = size_t(*maxIndex) - base + 1;
+
+			std::vector<uint32_t> local(first, last);
+			for (uint32_t& index : local)
+				index -= base;
+
+			optimizeVertexCache(local.data(), local.size(), vertexCount);
+			optimizeOverdraw(local.data(), local.size(), &vertices[base].position.x, vertexCount, sizeof(Vertex) / sizeof(float), overdrawThreshold);
+
+			for (size_t i = 0; i < local.size(); i++)
+				first[i] = local[i] + base;
+		});
+
+		std::vector<uint32_t> remap(vertices.size());
+		size_t vertexCount = optimizeVertexFetchRemap(remap.data(), indices.data(), indices.size(), vertices.size());
+
+		std::vector<Vertex> fetchOrder(vertexCount);
+		for (size_t v = 0; v < vertices.size(); v++)
+			if (remap[v] != ~0u)
+				fetchOrder[remap[v]] = vertices[v];
+		vertices = std::move(fetchOrder);
+	}
+
+	void VulkanModel::Builder::createMeshlets()
+	{
+		meshlets.clear();
+		if (indices.empty())
+			return;
+
+		if (submeshes.empty())
+			submeshes.push_back({ 0, static_cast<uint32_t>(indices.size()) });
+
+		std::vector<std::vector<Meshlet>> submeshMeshlets(submeshes.size());
+
+		GetThreadPool().parallelFor(submeshes.size(), [&](size_t s) {
+			const Submesh& submesh = submeshes[s];
+			uint32_t* first = indices.data() + submesh.firstIndex;
+			uint32_t* last = first + submesh.indexCount;
+			if (first == last)
+				return;
+
+			auto [minIndex, maxIndex] = std::minmax_element(first, last);
+			uint32_t base = *minIndex;
+			size_t vertexCount = size_t(*maxIndex) - base + 1;
+
+			for (uint32_t* index = first; index != last; index++)
+				*index -= base;
+
+			const Vertex& baseVertex = vertices[submesh.vertexOffset + base];
+			buildMeshlets(first, submesh.indexCount, &baseVertex.position.x, &baseVertex.normal.x, vertexCount, sizeof(Vertex) / sizeof(float), submeshMeshlets[s]);
+
+			// the meshlets regroup the triangles, so the cache order optimize made is redone inside every one of them.
+			// each gets its own few vertices, the pass allocates per vertex
+			if (optimizeMesh) {
+				std::vector<uint32_t> localIndex(vertexCount, ~0u);
+				std::vector<uint32_t> meshletVertices;
+				std::vector<uint32_t> local;
+
+				for (const Meshlet& meshlet : submeshMeshlets[s]) {
+					uint32_t* meshletFirst = first + meshlet.firstIndex;
+					meshletVertices.clear();
+					local.resize(meshlet.indexCount);
+
+					for (uint32_t i = 0; i < meshlet.indexCount; i++) {
+						uint32_t vertex = meshletFirst[i];
+						if (localIndex[vertex] == ~0u) {
+							localIndex[vertex] = static_cast<uint32_t>(meshletVertices.size());
+							meshletVertices.push_back(vertex);
+						}
+						local[i] = localIndex[vertex];
+					}
+
+					optimizeVertexCache(local.data(), local.size(), meshletVertices.size());
+
+					for (uint32_t i = 0; i < meshlet.indexCount; i++)
+						meshletFirst[i] = meshletVertices[local[i]];
+					for (uint32_t vertex : meshletVertices)
+						localIndex[vertex] = ~0u;
+				}
+			}
+
+			for (uint32_t* index = first; index != last; index++)
+				*index += base;
+
+			for (Meshlet& meshlet : submeshMeshlets[s]) {
+				meshlet.firstIndex += submesh.firstIndex;
+				meshlet.vertexOffset = submesh.vertexOffset;
+			}
+		});
+
+		for (size_t s = 0; s < submeshes.size(); s++) {
+			submeshes[s].firstMeshlet = static_cast<uint32_t>(meshlets.size());
+			submeshes[s].meshletCount = static_cast<uint32_t>(submeshMeshlets[s].size());
+			meshlets.insert(meshlets.end(), submeshMeshlets[s].begin(), submeshMeshlets[s].end());
+		}
+	}
+
+	void VulkanModel::Builder::computeBounds()
+	{
+		bounds = VkRenderer::computeBounds(reinterpret_cast<const float*>(vertices.data()), vertices.size(), sizeof(Vertex) / sizeof(float));
+
+		GetThreadPool().parallelFor(submeshes.size(), [&](size_t s) {
+			submeshes[s].bounds = computeSubmeshBounds(*this, submeshes[s]);
+		});
+	}
+
+	void VulkanModel::Builder::createLods()
+	{
+		lodCount = std::clamp(lodCount, 1u, MAX_LODS);
+		if (indices.empty() || lodCount == 1)
+			return;
+
+		if (submeshes.empty())
+			submeshes.push_back({ 0, static_cast<uint32_t>(indices.size()) });
+
+		// normal and uv sit right behind each other, so they are compared as one run of attributes
+		static_assert(offsetof(Vertex, uv) == offsetof(Vertex, normal) + sizeof(glm::vec3), "uv must follow the normal");
+		const float attributeWeights[5] = { lodNormalWeight, lodNormalWeight, lodNormalWeight, lodUvWeight, lodUvWeight };
+
+		// per submesh, the levels back to back with firstIndex relative to the start of the vector for now
+		std::vector<std::vector<uint32_t>> lodIndices(submeshes.size());
+
+		GetThreadPool().parallelFor(submeshes.size(), [&](size_t s) {
+			Submesh& submesh = submeshes[s];
+			const uint32_t* first = indices.data() + submesh.firstIndex;
+			const uint32_t* last = first + submesh.indexCount;
+			if (first == last)
+				return;
+
+			auto [minIndex, maxIndex] = std::minmax_element(first, last);
+			uint32_t base = *minIndex;
+			size_t vertexCount = size_t(*maxIndex) - base + 1;
+
+			std::vector<uint32_t> local(first, last);
+			for (uint32_t& index : local)
+				index -= base;
+
+			const Vertex& baseVertex = vertices[submesh.vertexOffset + base];
+			std::vector<uint32_t> simplified(local.size());
+			size_t previousCount = local.size();
+
+			// every level starts from the full submesh so its error is measured against the real surface
+			for (uint32_t lod = 1; lod < lodCount; lod++) {
+				size_t targetCount = size_t(float(local.size()) * std::pow(lodReduction, float(lod))) / 3 * 3;
+
+				float error = 0.0f;
+				size_t count = simplifyMesh(simplified.data(), local.data(), local.size(), &baseVertex.position.x, vertexCount, sizeof(Vertex) / sizeof(float),
+					offsetof(Vertex, normal) / sizeof(float), attributeWeights, 5, targetCount, lodTargetError, &error);
+
+				// not worth the index memory, and the levels after it won't get any further
+				if (count == 0 || count > previousCount * 9 / 10)
+					break;
+
+				optimizeVertexCache(simplified.data(), count, vertexCount);
+
+				submesh.lods[lod] = { static_cast<uint32_t>(lodIndices[s].size()), static_cast<uint32_t>(count), error };
+				for (size_t i = 0; i < count; i++)
+					lodIndices[s].push_back(simplified[i] + base);
+
+				previousCount = count;
+			}
+		});
+
+		for (size_t s = 0; s < submeshes.size(); s++) {
+			uint32_t offset = static_cast<uint32_t>(indices.size());
+			for (uint32_t lod = 1; lod < lodCount; lod++)
+				if (submeshes[s].lods[lod].indexCount > 0)
+					submeshes[s].lods[lod].firstIndex += offset;
+
+			indices.insert(indices.end(), lodIndices[s].begin(), lodIndices[s].end());
+		}
+	}
+}
@@ -2,15 +2,24 @@
 
 #include "VulkanDevice.hpp"
 #include "VulkanBuffer.hpp"
+#include "GeometryPool.hpp"
+#include "VertexWelder.hpp"
+#include "MeshOptimizer.hpp"
+#include "MeshSimplifier.hpp"
+#include "Bounds.hpp"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 #include <glm/glm.hpp>
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace VkRenderer {
+	class MaterialManager;
+	class CachedMesh;
+
 	class VulkanModel
 	{
 		public:
@@ -29,34 +38,234 @@ namespace VkRenderer {
 				}
 			};
 
+			enum class VertexLayout : uint32_t {
+				Full,   // Vertex as is, 60 bytes
+				Compact // CompactVertex, 20 bytes. drops the vertex color
+			};
+
+			/*
+			 * position is snorm16 inside the mesh bounds (see getDequantization) with the tangent sign in w,
+			 * normal and tangent are octahedral snorm16, uv is half float. decoded in shader.vert with COMPACT_VERTEX
+			 */
+			struct CompactVertex {
+				int16_t position[4];
+				int16_t normal[2];
+				int16_t tangent[2];
+				uint16_t uv[2];
+
+				static std::vector<VkVertexInputBindingDescription> getBindingDescriptions();
+				static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+			};
+
+			static uint32_t getVertexStride(VertexLayout layout);
+			static std::vector<VkVertexInputBindingDescription> getBindingDescriptions(VertexLayout layout);
+			static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions(VertexLayout layout);
+
+			static constexpr uint32_t MAX_LODS = 4;
+
+			// a simplified index range over the submesh vertices
+			struct Lod {
+				uint32_t firstIndex = 0;
+				uint32_t indexCount = 0;
+				float error = 0.0f; // how far the surface moved from the full submesh, in model units
+			};
+
+			// one per glTF primitive, index ranges are relative to the model
+			struct Submesh {
+				uint32_t firstIndex;
+				uint32_t indexCount;
+				int32_t vertexOffset = 0; // added to every index of the submesh, lets large models use 16 bit indices
+				int32_t material = -1; // glTF material index, -1 if the primitive has none
+				int32_t materialId = -1; // MaterialManager id once the file materials are imported
+
+				// range in Builder::meshlets, relative to the model's first meshlet once uploaded
+				uint32_t firstMeshlet = 0;
+				uint32_t meshletCount = 0;
+
+				// lods[0] is the submesh itself, getLodCount levels are valid once the model is created
+				Lod lods[MAX_LODS]{};
+
+				Bounds bounds{}; // of the vertices the full submesh uses, in model units
+			};
+
+			// material data pulled out of the file, turned into textures by MaterialManager::importMaterials
+			struct ImageSource {
+				std::string uri; // relative to the model directory, empty for embedded images
+				std::vector<unsigned char> encoded; // data uri bytes, not decoded yet
+
+				// images inside a buffer view point into the file buffer instead of copying it
+				std::shared_ptr<const std::vector<unsigned char>> buffer;
+				size_t byteOffset = 0;
+				size_t byteLength = 0;
+			};
+
+			enum class ImageMode {
+				Defer, // keep uris and buffer views of the images, MaterialManager reads and decodes them later
+				Skip   // geometry only, images and materials are dropped
+			};
+
+			struct MaterialSource {
+				std::string name;
+				int albedoImage = -1; // index into images
+				int normalImage = -1;
+			};
+
 			struct Builder {
 				std::vector<Vertex> vertices{};
 				std::vector<uint32_t> indices{};
+				std::vector<Submesh> submeshes{}; // left empty, the whole model becomes one submesh
+
+				ImageMode imageMode = ImageMode::Defer;
+				std::string directory{};
+				std::vector<std::string> sourceFiles{}; // the model file and every buffer file it read, for cache invalidation
+				std::vector<ImageSource> images{};
+				std::vector<MaterialSource> materials{};
+
+				VertexLayout vertexLayout = VertexLayout::Full; // compact falls back to full if the vertex colors are used
+				bool split16BitIndices = false; // let loadModel split models over 65536 vertices, see splitFor16BitIndices
+				bool optimizeMesh = false; // run optimize at the end of loadModel
+				bool generateMeshlets = false; // run createMeshlets at the end of loadModel
+				float overdrawThreshold = 1.05f; // acmr the overdraw pass may give up, see optimizeOverdraw
+				uint32_t lodCount = 1; // levels per submesh including the full one, up to MAX_LODS. more than one runs createLods
+				float lodReduction = 0.5f; // share of the triangles every level keeps from the one before
+				float lodTargetError = 0.05f; // relative to the submesh size, a level stops short of its triangle count before going over
+				float lodNormalWeight = 0.5f; // how much normal and uv differences count against a collapse, see simplifyMesh
+				float lodUvWeight = 0.5f;
+				VertexWelder::Mode weldMode = VertexWelder::Mode::Exact;
+				float weldEpsilon = 1e-5f;
+
+				// filled in by optimize and at the end of loadModel once the meshlets are cut, with a 16 entry fifo cache
+				VertexCacheStats cacheStatsBefore{};
+				VertexCacheStats cacheStatsAfter{};
+
+				std::vector<Meshlet> meshlets{}; // firstIndex and vertexOffset relative to the model
+
+				Bounds bounds{}; // of every vertex, filled in by computeBounds
 
 				void loadModel(const std::string& filepath);
+
+				// reorders the triangles of every submesh for the vertex cache and overdraw, then the vertices for fetch order.
+				// deterministic, run it before splitFor16BitIndices
+				void optimize();
+
+				// gives every submesh its own vertex offset and splits the ones referencing more than 65536 vertices,
+				// so the whole model can be drawn with 16 bit indices. indices become relative to the submesh vertex offset
+				void splitFor16BitIndices();
+
+				// cuts every submesh into meshlets, reordering the triangles inside it. run it after the other passes, with optimizeMesh
+				// the triangles inside every meshlet are put back into cache order
+				void createMeshlets();
+
+				// simplifies every submesh into lodCount - 1 coarser levels, appended to indices and sharing the vertices.
+				// a level that would barely shrink is left out and the one before stands in for it
+				void createLods();
+
+				// bounds of the model and of every submesh, loadModel runs it last. models built by hand get theirs
+				// computed by the constructor
+				void computeBounds();
 			};
 
-			VulkanModel(VulkanDevice& device, const VulkanModel::Builder &builder);
+			// a model in the layout it is uploaded in, which is what MeshCache stores. only has to live through the constructor
+			struct Cooked {
+				VertexLayout vertexLayout = VertexLayout::Full;
+				uint32_t vertexCount = 0;
+				const void* vertexData = nullptr;
+				VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+				uint32_t indexCount = 0;
+				const void* indexData = nullptr;
+				const Submesh* submeshes = nullptr; // as resolveSubmeshes returns them
+				uint32_t submeshCount = 0;
+				const Meshlet* meshlets = nullptr; // as resolveMeshlets returns them
+				uint32_t meshletCount = 0;
+				uint32_t lodCount = 1;
+				glm::mat4 dequantization{ 1.f };
+				Bounds bounds{};
+			};
+
+			VulkanModel(VulkanDevice& device, GeometryPool& geometryPool, const VulkanModel::Builder &builder);
+			VulkanModel(VulkanDevice& device, GeometryPool& geometryPool, const Cooked& cooked);
 			~VulkanModel();
 
 			VulkanModel(const VulkanModel&) = delete;
 			VulkanModel& operator=(const VulkanModel&) = delete;
 
-			static std::unique_ptr<VulkanModel> createModelFromFile(VulkanDevice& device, const std::string& filepath);
+			// with a material manager the file materials and textures are imported and assigned to the submeshes
+			// goes through GetMeshCache(), a current cache file skips loadModel entirely
+			static std::unique_ptr<VulkanModel> createModelFromFile(VulkanDevice& device, GeometryPool& geometryPool, const std::string& filepath, MaterialManager* materialManager = nullptr);
+
+			// createModelFromFile in two halves. loadFile does the disk and cpu work and is fine on any thread,
+			// createModel imports materials and records the upload, so it runs where uploads are recorded
+			struct FileData {
+				std::string filepath;
+				Builder builder{};
+				std::unique_ptr<CachedMesh> cached; // set when the mesh cache had the file, builder then only carries materials
+
+				~FileData();
+			};
+
+			static std::unique_ptr<FileData> loadFile(const std::string& filepath, bool materials);
+			static std::unique_ptr<VulkanModel> createModel(VulkanDevice& device, GeometryPool& geometryPool, FileData& file, MaterialManager* materialManager = nullptr);
+
+			// the settings createModelFromFile loads with, the cache key depends on them
+			static void configureFileBuilder(Builder& builder, bool materials);
+
+			// the steps the builder constructor takes, for writing the uploaded data without a device (MeshCache)
+			static VertexLayout resolveVertexLayout(const Builder& builder);
+			static VkIndexType resolveIndexType(const Builder& builder);
+			static glm::mat4 writeVertices(VertexLayout layout, const std::vector<Vertex>& vertices, void* destination); // returns the dequantization
+			static void writeIndices(const Builder& builder, VkIndexType indexType, void* destination);
+			static std::vector<Submesh> resolveSubmeshes(const Builder& builder, uint32_t& lodCount);
+			static std::vector<Meshlet> resolveMeshlets(const Builder& builder, const glm::mat4& dequantization);
+			static Bounds resolveBounds(const Builder& builder);
 
 			void bind(VkCommandBuffer commandBuffer);
 			void draw(VkCommandBuffer commandBuffer);
+			void drawSubmesh(VkCommandBuffer commandBuffer, size_t submesh, uint32_t lod = 0);
+
+			GeometryPool& getGeometryPool() const { return geometryPool; }
+			uint32_t getIndexCount() const { return indexCount; }
+			VkIndexType getIndexType() const { return indexType; }
+			uint32_t getFirstIndex() const { return allocation.firstIndex; }
+			int32_t getVertexOffset() const { return allocation.vertexOffset; }
+			const std::vector<Submesh>& getSubmeshes() const { return submeshes; }
+
+			uint32_t getLodCount() const { return lodCount; }
+			// worst error of the level over all submeshes, in model units
+			float getLodError(uint32_t lod) const { return lodErrors[lod]; }
+			// model space, around every vertex. the submeshes carry their own
+			const Bounds& getBounds() const { return bounds; }
+			const glm::vec4& getBoundingSphere() const { return bounds.sphere; }
+
+			bool hasMeshlets() const { return meshletAllocation.meshletCount > 0; }
+			uint32_t getFirstMeshlet() const { return meshletAllocation.firstMeshlet; }
+			// batch the vertices, indices and meshlets went out with, frames drawing the model before it completes wait on it
+			UploadTicket getUploadTicket() const { return uploadTicket; }
+
+			VertexLayout getVertexLayout() const { return vertexLayout; }
+			// maps the stored positions back to model space, identity unless the layout is compact
+			const glm::mat4& getDequantization() const { return dequantization; }
 		private:
-			void createVertexBuffers(const std::vector<Vertex>& vertices);
-			void createIndexBuffers(const std::vector<uint32_t>& indices);
+			static glm::mat4 writeCompactVertices(const std::vector<Vertex>& vertices, void* destination);
+			static Bounds computeSubmeshBounds(const Builder& builder, const Submesh& submesh);
+			void uploadMeshlets(std::vector<Meshlet> meshlets);
+			void computeLodErrors();
 
 			VulkanDevice& device;
+			GeometryPool& geometryPool;
 
-			std::unique_ptr<VulkanBuffer> vertexBuffer;
+			GeometryPool::Allocation allocation{};
 			uint32_t vertexCount;
-
-			bool hasIndexBuffer = false;
-			std::unique_ptr<VulkanBuffer> indexBuffer;
 			uint32_t indexCount;
+			VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+			GeometryPool::MeshletAllocation meshletAllocation{};
+			UploadTicket uploadTicket = 0;
+
+			std::vector<Submesh> submeshes;
+			uint32_t lodCount = 1;
+			float lodErrors[MAX_LODS]{};
+			Bounds bounds{};
+
+			VertexLayout vertexLayout = VertexLayout::Full;
+			glm::mat4 dequantization{ 1.f };
 	};
 }
\ No newline at end of file
@@ -52,6 +52,24 @@ namespace VkRenderer {
 		return glm::transpose(glm::inverse(glm::mat3(model)));
 	}
 
+	WorldBounds VulkanObject::getWorldBounds()
+	{
+		return transformBounds(model ? model->getBounds() : Bounds{}, transform.mat4());
+	}
+
+	void VulkanObject::getSubmeshWorldBounds(std::vector<WorldBounds>& out)
+	{
+		out.clear();
+		if (model == nullptr)
+			return;
+
+		const auto& submeshes = model->getSubmeshes();
+		out.resize(submeshes.size());
+
+		if (!submeshes.empty())
+			transformBounds(&submeshes[0].bounds, submeshes.size(), transform.mat4(), out.data(), sizeof(VulkanModel::Submesh));
+	}
+
 	VulkanObject VulkanObject::makePointLight(float intensity, float radius, glm::vec3 color)
 	{
 		VulkanObject object = VulkanObject::create();
@@ -68,12 +86,12 @@ namespace VkRenderer {
 		VulkanTexture* texture = new VulkanTexture(device, format);
 
 		if (path == nullptr) {
-			uint32_t whitePixel = 0xFFFFFFFF;
-			unsigned char* white = reinterpret_cast<unsigned char*>(&whitePixel);
-
 			texture->width = 1;
 			texture->height = 1;
-			texture->load(white);
+
+			uint32_t* white = static_cast<uint32_t*>(texture->beginLoad());
+			*white = 0xFFFFFFFF;
+			texture->endLoad();
 
 			return texture;
 		}
@@ -81,7 +99,11 @@ namespace VkRenderer {
 			const int width = 256;
 			const int height = 256;
 
-			std::vector<uint8_t> pixelData(width * height * 4);
+			texture->width = width;
+			texture->height = height;
+
+			// generated straight into staging memory
+			uint8_t* pixelData = static_cast<uint8_t*>(texture->beginLoad());
 
 			for (int y = 0; y < height; ++y) {
 				for (int x = 0; x < width; ++x) {
@@ -93,11 +115,7 @@ namespace VkRenderer {
 				}
 			}
 
-			unsigned char* normalData = reinterpret_cast<unsigned char*>(pixelData.data());
-
-			texture->width = width;
-			texture->height = height;
-			texture->load(normalData);
+			texture->endLoad();
 
 			return texture;
 		}
@@ -7,6 +7,7 @@
 
 #include <memory>
 #include <unordered_map>
+#include <vector>
 
 namespace VkRenderer {
 	struct TransformComponent {
@@ -44,11 +45,27 @@ namespace VkRenderer {
 
 		id_t getId() const { return id; }
 
+		// explicit override first, then whatever the model file assigned, then the object material
+		uint32_t getSubmeshMaterial(size_t submesh) const {
+			if (submesh < submeshMaterials.size())
+				return submeshMaterials[submesh];
+
+			int32_t imported = model ? model->getSubmeshes()[submesh].materialId : -1;
+			return imported >= 0 ? static_cast<uint32_t>(imported) : material;
+		}
+
+		// model bounds under the current transform, empty at the object position without a model
+		WorldBounds getWorldBounds();
+		// one per submesh, indexed like model->getSubmeshes()
+		void getSubmeshWorldBounds(std::vector<WorldBounds>& out);
+
 		std::shared_ptr<VulkanModel> model{};
 		uint32_t material = NULL;
+		std::vector<uint32_t> submeshMaterials{}; // per submesh override of material, indexed like model->getSubmeshes()
 		glm::vec3 color{};
 		TransformComponent transform{};
 		std::unique_ptr<PointLightComponent> pointLight = nullptr;
+		uint32_t lod = 0; // level of detail drawn last frame, the renderer only moves away from it past a margin
 	private:
 		VulkanObject(id_t objId) : id(objId) {};
 
@@ -1,39 +1,41 @@
 #include "VulkanTexture.hpp"
-#include "VulkanBuffer.hpp"
 #include "VulkanUtils.hpp"
+#include "TextureCompression.hpp"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <stdexcept>
 #include <utility>
+#include <vector>
 
 namespace VkRenderer {
 	VulkanTexture::VulkanTexture(VulkanDevice& device, VkFormat _format)
 		: device{ device }, format{ _format }, layout{ VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL },
-		image(VK_NULL_HANDLE), memory(VK_NULL_HANDLE), imageView(VK_NULL_HANDLE), sampler(VK_NULL_HANDLE)
+		image(VK_NULL_HANDLE), memory{}, imageView(VK_NULL_HANDLE), sampler(VK_NULL_HANDLE)
 	{}
 	
 	VulkanTexture::~VulkanTexture() {
-		if (sampler != VK_NULL_HANDLE)
-			vkDestroySampler(device.device(), sampler, nullptr);
+		// the image could still be getting copied into, a streamed level is always the later batch
+		if (UploadTicket ticket = std::max(uploadTicket, pendingTicket); ticket != 0)
+			device.getUploadContext().wait(ticket);
+
 		if (imageView != VK_NULL_HANDLE)
 			vkDestroyImageView(device.device(), imageView, nullptr);
 		if (image != VK_NULL_HANDLE)
-			vkDestroyImage(device.device(), image, nullptr);
-		if (memory != VK_NULL_HANDLE)
-			vkFreeMemory(device.device(), memory, nullptr);
+			device.destroyImage(image, memory);
 	}
 
 
 	void VulkanTexture::load(void* data)
 	{
-		createImageInfo(data);
-		createSamplerInfo();
-		createImageViewInfo();
+		void* pixels = beginLoad();
+		memcpy(pixels, data, static_cast<size_t>(width) * height * getPixelSize());
+		endLoad();
 	}
 
-	void VulkanTexture::transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout)
+	void VulkanTexture::transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t baseLevel, uint32_t levelCount)
 	{
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.oldLayout = oldLayout;
@@ -43,8 +45,8 @@ namespace VkRenderer {
 		barrier.image = image;
 
 		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		barrier.subresourceRange.baseMipLevel = 0;
-		barrier.subresourceRange.levelCount = mipLevels;
+		barrier.subresourceRange.baseMipLevel = baseLevel;
+		barrier.subresourceRange.levelCount = levelCount;
 		barrier.subresourceRange.baseArrayLayer = 0;
 		barrier.subresourceRange.layerCount = 1;
 
@@ -88,11 +90,9 @@ namespace VkRenderer {
 		}
 	
 		vkCmdPipelineBarrier(commandBuffer, srcStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		device.endSingleTimeCommands(commandBuffer);
 	}
 
-	void VulkanTexture::generateMipmaps()
+	void VulkanTexture::generateMipmaps(VkCommandBuffer commandBuffer)
 	{
 		VkFormatProperties formatProperties;
 		vkGetPhysicalDeviceFormatProperties(device.physical(), format, &formatProperties);
@@ -100,8 +100,6 @@ namespace VkRenderer {
 		if (!(formatProperties.optimalTilingFeatures & VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT))
 			throw std::runtime_error("texture format doesn't support linear blitting");
 
-		VkCommandBuffer commandBuffer = device.beginSingleTimeCommands();
-
 		VkImageMemoryBarrier barrier{};
 		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
 		barrier.image = image;
@@ -161,41 +159,145 @@ namespace VkRenderer {
 		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
 
 		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
-
-		device.endSingleTimeCommands(commandBuffer);
 	}
 
-	void VulkanTexture::createImageInfo(void* data)
+	uint32_t VulkanTexture::getPixelSize() const
 	{
-		mipLevels = std::floor(std::log2(std::max(width, height))) + 1;
-
-		uint32_t pixelSize = 4; 
-
 		switch (format) {
 			case VK_FORMAT_R32G32B32A32_SFLOAT:
-				pixelSize = 16;
-				break;
+				return 16;
 			case VK_FORMAT_R16G16B16A16_SFLOAT:
-				pixelSize = 8;
-				break;
+				return 8;
 			case VK_FORMAT_R8G8B8A8_UNORM:
 			case VK_FORMAT_B8G8R8A8_UNORM:
 			default:
-				pixelSize = 4;
-				break;
+				return 4;
 		}
+	}
 
-		VulkanBuffer stagingBuffer{
-			device,
-			pixelSize,
-			static_cast<uint32_t>(width * height),
-			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-		};
-		
-		stagingBuffer.map();
-		stagingBuffer.writeToBuffer(data);
+	void* VulkanTexture::beginLoad()
+	{
+		assert(staging.data == nullptr && "beginLoad called twice");
 
+		VkDeviceSize size = static_cast<VkDeviceSize>(width) * height * getPixelSize();
+		staging = device.getUploadContext().stage(size, getPixelSize());
+
+		return staging.data;
+	}
+
+	void VulkanTexture::endLoad()
+	{
+		assert(staging.data != nullptr && "endLoad called without beginLoad");
+
+		createImageInfo();
+		createSamplerInfo();
+		createImageViewInfo();
+
+		staging = {};
+	}
+
+	void VulkanTexture::loadKtx2(std::shared_ptr<const Ktx2File> file, VkDeviceSize tailSize, bool trimmed)
+	{
+		assert(staging.data == nullptr && "loadKtx2 called during beginLoad");
+
+		if (file->getFormat() != format)
+			throw std::runtime_error("ktx2 file format doesn't match the texture");
+
+		// the tail is whatever fits counting up from the smallest level
+		uint32_t levelCount = file->getLevelCount();
+		uint32_t tailLevel = levelCount - 1;
+		VkDeviceSize tail = file->getLevel(tailLevel).size;
+		while (tailLevel > 0 && tail + file->getLevel(tailLevel - 1).size <= tailSize)
+			tail += file->getLevel(--tailLevel).size;
+
+		// the image gets the whole chain unless it's trimmed, then it starts at the tail
+		baseLevel = trimmed ? tailLevel : 0;
+		residentLevel = tailLevel - baseLevel;
+
+		width = static_cast<int>(std::max(file->getWidth() >> baseLevel, 1u));
+		height = static_cast<int>(std::max(file->getHeight() >> baseLevel, 1u));
+		mipLevels = static_cast<int>(levelCount - baseLevel);
+
+		createImage(VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		uploadLevels(*file, tailLevel, levelCount);
+		uploadTicket = device.getUploadContext().currentTicket();
+
+		this->file = std::move(file);
+
+		createSamplerInfo();
+		createImageViewInfo();
+	}
+
+	void VulkanTexture::uploadLevels(const Ktx2File& file, uint32_t firstLevel, uint32_t endLevel)
+	{
+		// first and end are file levels, the image starts at baseLevel
+		// the levels go into one staging allocation, each starting on a block
+		VkDeviceSize alignment = std::max<VkDeviceSize>(getBlockSize(format), 4);
+		VkDeviceSize size = 0;
+		for (uint32_t i = firstLevel; i < endLevel; i++)
+			size += (file.getLevel(i).size + alignment - 1) / alignment * alignment;
+
+		UploadContext& uploadContext = device.getUploadContext();
+		StagingAllocation levelStaging = uploadContext.stage(size, alignment);
+
+		std::vector<VkBufferImageCopy> regions(endLevel - firstLevel);
+		VkDeviceSize offset = 0;
+		for (uint32_t i = firstLevel; i < endLevel; i++) {
+			const Ktx2File::Level& level = file.getLevel(i);
+			memcpy(static_cast<unsigned char*>(levelStaging.data) + offset, level.data, level.size);
+
+			VkBufferImageCopy& region = regions[i - firstLevel];
+			region.bufferOffset = levelStaging.offset + offset;
+			region.imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, i - baseLevel, 0, 1 };
+			region.imageExtent = { std::max(file.getWidth() >> i, 1u), std::max(file.getHeight() >> i, 1u), 1 };
+
+			offset += (level.size + alignment - 1) / alignment * alignment;
+		}
+
+		// nothing to blit, so the whole upload stays on the transfer queue
+		transitionImageLayout(uploadContext.getCommandBuffer(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, firstLevel - baseLevel, endLevel - firstLevel);
+		vkCmdCopyBufferToImage(uploadContext.getCommandBuffer(), levelStaging.buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			static_cast<uint32_t>(regions.size()), regions.data());
+
+		VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, firstLevel - baseLevel, endLevel - firstLevel, 0, 1 };
+		uploadContext.releaseImage(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_ACCESS_SHADER_READ_BIT);
+	}
+
+	VkDeviceSize VulkanTexture::getNextLevelSize() const
+	{
+		if (!isStreaming() || pendingTicket != 0)
+			return 0;
+
+		return file->getLevel(baseLevel + residentLevel - 1).size;
+	}
+
+	void VulkanTexture::streamLevel()
+	{
+		assert(getNextLevelSize() != 0 && "streamLevel called with nothing to stream");
+
+		// the level isn't in the view yet, so nothing samples it while it's written
+		pendingLevel = residentLevel - 1;
+		uploadLevels(*file, baseLevel + pendingLevel, baseLevel + residentLevel);
+		pendingTicket = device.getUploadContext().currentTicket();
+	}
+
+	VkImageView VulkanTexture::updateStreaming()
+	{
+		if (pendingTicket == 0 || !device.getUploadContext().isComplete(pendingTicket))
+			return VK_NULL_HANDLE;
+
+		uploadTicket = std::exchange(pendingTicket, 0);
+		residentLevel = pendingLevel;
+
+		VkImageView oldView = imageView;
+		createImageViewInfo();
+		return oldView;
+	}
+
+	void VulkanTexture::createImage(VkImageUsageFlags usage)
+	{
 		VkImageCreateInfo imageInfo{};
 		imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
 		imageInfo.imageType = VK_IMAGE_TYPE_2D;
@@ -209,36 +311,39 @@ namespace VkRenderer {
 		imageInfo.extent.width = static_cast<uint32_t>(width);
 		imageInfo.extent.height = static_cast<uint32_t>(height);
 		imageInfo.extent.depth = 1;
-		imageInfo.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT;
+		imageInfo.usage = usage;
 
 		device.createImageWithInfo(imageInfo, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, image, memory);
-		transitionImageLayout(VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-		device.copyBufferToImage(stagingBuffer.getBuffer(), image, static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1);
-		generateMipmaps();
+	}
+
+	void VulkanTexture::createImageInfo()
+	{
+		mipLevels = std::floor(std::log2(std::max(width, height))) + 1;
+
+		createImage(VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT);
+
+		UploadContext& uploadContext = device.getUploadContext();
+
+		// the copy can run on the transfer queue, the blits for the mip chain need graphics
+		transitionImageLayout(uploadContext.getCommandBuffer(), VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+		device.copyBufferToImage(staging.buffer, image, static_cast<uint32_t>(width), static_cast<uint32_t>(height), 1, staging.offset);
+
+		VkImageSubresourceRange range{ VK_IMAGE_ASPECT_COLOR_BIT, 0, static_cast<uint32_t>(mipLevels), 0, 1 };
+		uploadContext.releaseImage(image, range, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+			VK_PIPELINE_STAGE_TRANSFER_BIT, VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT);
+
+		generateMipmaps(uploadContext.getGraphicsCommandBuffer());
+
+		uploadTicket = uploadContext.currentTicket();
 	}
 
 	void VulkanTexture::createSamplerInfo()
 	{
-		VkSamplerCreateInfo samplerInfo{};
-		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
-		samplerInfo.magFilter = VK_FILTER_LINEAR;
-		samplerInfo.minFilter = VK_FILTER_LINEAR;
-		samplerInfo.addressModeU = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeV = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.addressModeW = VK_SAMPLER_ADDRESS_MODE_REPEAT;
-		samplerInfo.anisotropyEnable = VK_TRUE;
-		samplerInfo.maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
-		samplerInfo.borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
-		samplerInfo.unnormalizedCoordinates = VK_FALSE;
-		samplerInfo.compareEnable = VK_FALSE;
-		samplerInfo.compareOp = VK_COMPARE_OP_ALWAYS;
-		samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
-		samplerInfo.mipLodBias = 0.0f;
-		samplerInfo.minLod = 0.0f;
-		samplerInfo.maxLod = static_cast<float>(mipLevels);
-
-		if (vkCreateSampler(device.device(), &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
-			throw std::runtime_error("failed to create image sampler");
+		// shared with every other texture, maxLod is left open since the view has the mip count
+		SamplerState state{};
+		state.maxAnisotropy = device.properties.limits.maxSamplerAnisotropy;
+
+		sampler = device.getSamplerCache().get(state);
 	}
 
 	void VulkanTexture::createImageViewInfo()
@@ -251,8 +356,8 @@ namespace VkRenderer {
 		viewInfo.components = { VK_COMPONENT_SWIZZLE_R, VK_COMPONENT_SWIZZLE_G, VK_COMPONENT_SWIZZLE_B, VK_COMPONENT_SWIZZLE_A };
 
 		viewInfo.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-		viewInfo.subresourceRange.baseMipLevel = 0;
-		viewInfo.subresourceRange.levelCount = mipLevels;
+		viewInfo.subresourceRange.baseMipLevel = residentLevel;
+		viewInfo.subresourceRange.levelCount = mipLevels - residentLevel;
 		viewInfo.subresourceRange.baseArrayLayer = 0;
 		viewInfo.subresourceRange.layerCount = 1;
 
@@ -1,11 +1,16 @@
 #pragma once
 
 #include "VulkanDevice.hpp"
+#include "Ktx2.hpp"
+
+#include <memory>
 
 namespace VkRenderer {
 	class VulkanTexture
 	{
 		public:
+			static constexpr VkDeviceSize STREAMING_TAIL_SIZE = 128ull * 1024; // a 256x256 BC7 mip tail, enough to look right at a distance
+
 			VulkanTexture(VulkanDevice& device, VkFormat _format = VK_FORMAT_R8G8B8A8_SRGB);
 			~VulkanTexture();
 
@@ -18,24 +23,69 @@ namespace VkRenderer {
 			VkImageView getImageView() { return imageView; }
 			VkImageLayout getImageLayout() { return layout; }
 
+			// the upload is recorded into the device upload context, this is the batch it lands in
+			UploadTicket getUploadTicket() const { return uploadTicket; }
+			bool isReady() { return device.getUploadContext().isComplete(uploadTicket); }
+
 			int width, height = 1;
 
 			void load(void* data);
+
+			// width/height have to be set, write the top mip straight into the returned staging memory then call endLoad
+			void* beginLoad();
+			void endLoad();
+
+			// every mip is already in the file, they go in with one copy and no blits. format has to match the file.
+			// with a tail size only the smallest levels that fit in it are uploaded (at least one), the rest are
+			// left for streamLevel. trimmed textures only allocate that tail and never stream, see ResidencyManager.
+			// the file stays mapped for as long as the texture lives
+			void loadKtx2(std::shared_ptr<const Ktx2File> file, VkDeviceSize tailSize = VK_WHOLE_SIZE, bool trimmed = false);
+
+			const std::shared_ptr<const Ktx2File>& getKtx2File() const { return file; }
+			bool isTrimmed() const { return baseLevel > 0; }
+			// loaded from a file with more in it than the streaming tail, so trimming it frees something
+			bool canTrim() const { return file != nullptr && !isTrimmed() && file->getDataSize() > STREAMING_TAIL_SIZE; }
+			VkDeviceSize getMemorySize() const { return memory.size; }
+
+			// the view only covers levels from here down, anything finer isn't uploaded yet
+			uint32_t getResidentLevel() const { return residentLevel; }
+			bool isStreaming() const { return file != nullptr && residentLevel > 0; }
+			// bytes streamLevel would stage, 0 while a level is still in flight or when there's nothing left
+			VkDeviceSize getNextLevelSize() const;
+			// world thread, records the upload of the next finer level
+			void streamLevel();
+			// once the streamed level landed the view is recreated to include it. returns the old view, which the
+			// caller destroys after the frames that may still sample it are done, VK_NULL_HANDLE if nothing changed
+			VkImageView updateStreaming();
 		private:
-			void transitionImageLayout(VkImageLayout oldLayout, VkImageLayout newLayout);
-			void generateMipmaps();
+			void transitionImageLayout(VkCommandBuffer commandBuffer, VkImageLayout oldLayout, VkImageLayout newLayout,
+				uint32_t baseLevel = 0, uint32_t levelCount = VK_REMAINING_MIP_LEVELS);
+			void uploadLevels(const Ktx2File& file, uint32_t firstLevel, uint32_t endLevel);
+			void generateMipmaps(VkCommandBuffer commandBuffer);
+
+			uint32_t getPixelSize() const;
 
-			void createImageInfo(void* data);
+			void createImage(VkImageUsageFlags usage);
+			void createImageInfo();
 			void createSamplerInfo();
 			void createImageViewInfo();
 
 			int mipLevels = 1;
+			UploadTicket uploadTicket = 0;
+
+			uint32_t baseLevel = 0; // file level of the image's first level, only trimmed textures skip any
+			uint32_t residentLevel = 0;
+			uint32_t pendingLevel = 0;
+			UploadTicket pendingTicket = 0;
+			std::shared_ptr<const Ktx2File> file;
+
+			StagingAllocation staging{};
 
 			VulkanDevice& device;
 
 			VkImageView imageView;
-			VkDeviceMemory memory;
-			VkSampler sampler;
+			VulkanAllocation memory;
+			VkSampler sampler; // from the device sampler cache, not ours to destroy
 			VkImage image;
 			VkFormat format;
 			VkImageLayout layout;
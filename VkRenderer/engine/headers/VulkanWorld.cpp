@@ -23,17 +23,12 @@ namespace VkRenderer {
 		// default material setups
 
 		auto defaultTex = std::unique_ptr<VulkanTexture>(VulkanObject::createTexture(device, nullptr));
-		VulkanTexture* texture = defaultTex.get();
-
 		materialManager.addTexture("default", std::move(defaultTex));
 
 		auto defaultNormalTex = std::unique_ptr<VulkanTexture>(VulkanObject::createTexture(device, "no_texture_normal", VK_FORMAT_R8G8B8A8_UNORM));
-		VulkanTexture* normalTexture = defaultNormalTex.get();
 
 		materialManager.addTexture("default_normal", std::move(defaultNormalTex));
 
-		parseImages(convertImages({ texture, normalTexture }));
-
 		Material material{};
 		material.albedoIndex = materialManager.getTextureId("default");
 		material.normalIndex = materialManager.getTextureId("default_normal");
@@ -60,6 +55,36 @@ namespace VkRenderer {
 			uboBuffers[i]->map();
 		}
 
+		// Per object data for the indirect draw path, indexed with gl_InstanceIndex
+		std::vector<std::unique_ptr<VulkanBuffer>> objectBuffers(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		for (int i = 0; i < objectBuffers.size(); i++) {
+			objectBuffers[i] = std::make_unique<VulkanBuffer>(
+				device,
+				sizeof(ObjectData),
+				MAX_OBJECTS,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+
+			objectBuffers[i]->map();
+		}
+
+		// Per instance object and material index, every submesh draw points into this
+		std::vector<std::unique_ptr<VulkanBuffer>> instanceBuffers(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		for (int i = 0; i < instanceBuffers.size(); i++) {
+			instanceBuffers[i] = std::make_unique<VulkanBuffer>(
+				device,
+				sizeof(InstanceData),
+				MAX_INSTANCES,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+
+			instanceBuffers[i]->map();
+		}
+
 		// Set the descriptor (no idea what i should call this)
 		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> bindings = createBindings();
 		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo = createBindingFlags();
@@ -70,16 +95,26 @@ namespace VkRenderer {
 			.setPNext(bindingFlagsInfo)
 			.build();
 
-		auto materialBufferInfo = materialManager.getDescriptorInfo();
+		// every texture and material registered so far, including the ones imported with models. textures still
+		// loading go in as their placeholder and are swapped in the frame loop
+		parseImages(convertImages(materialManager.getTextures()));
+		materialManager.takeChangedTextures();
 
 		std::vector<VkDescriptorSet> globalDescriptorSets(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
 		for (size_t i = 0; i < VulkanSwapChain::MAX_FRAMES_IN_FLIGHT; ++i) {
+			materialManager.updateGPUBuffer(static_cast<int>(i));
+
+			auto materialBufferInfo = materialManager.getDescriptorInfo(static_cast<int>(i));
 			auto bufferInfo = uboBuffers[i]->descriptorInfo();
+			auto objectBufferInfo = objectBuffers[i]->descriptorInfo();
+			auto instanceBufferInfo = instanceBuffers[i]->descriptorInfo();
 
 			VulkanDescriptorWriter(*globalSetLayout, *globalPool)
 				.writeBuffer(BINDING_STORAGE, &bufferInfo)
 				.writeImageArray(BINDING_SAMPLER, imagesToWrite.data(), imagesToWrite.size())
 				.writeBuffer(BINDING_MATERIAL, &materialBufferInfo)
+				.writeBuffer(BINDING_OBJECTS, &objectBufferInfo)
+				.writeBuffer(BINDING_INSTANCES, &instanceBufferInfo)
 				.build(globalDescriptorSets[i]);
 		}
 
@@ -93,9 +128,30 @@ namespace VkRenderer {
 		// Frames
 		std::chrono::high_resolution_clock::time_point lastFrameTime = std::chrono::high_resolution_clock::now();
 
+		UploadContext& uploadContext = device.getUploadContext();
+
+		// everything loaded up to here goes out as one batch
+		uploadContext.submit();
+
+		// texture ids every frame's descriptor set still has to pick up
+		std::array<std::vector<uint32_t>, VulkanSwapChain::MAX_FRAMES_IN_FLIGHT> textureWrites{};
+
 		while (!window.shouldClose()) {
 			glfwPollEvents();
 
+			uploadContext.collect();
+
+			// models and textures whose files finished loading are uploaded with this frame
+			modelRegistry.update();
+			materialManager.update();
+
+			// models no object draws anymore, update() destroys them once the frames in flight are done with them
+			modelRegistry.unloadUnused();
+
+			std::vector<uint32_t> changedTextures = materialManager.takeChangedTextures();
+			for (auto& writes : textureWrites)
+				writes.insert(writes.end(), changedTextures.begin(), changedTextures.end());
+
 			auto currentTime = std::chrono::high_resolution_clock::now();
 			deltaTime = std::chrono::duration<float, std::chrono::seconds::period>(currentTime - lastFrameTime).count();
 			lastFrameTime = currentTime;
@@ -110,13 +166,24 @@ namespace VkRenderer {
 			if (auto commandBuffer = renderer.beginFrame()) {
 				int frameIndex = renderer.getFrameIndex();
 
+				// beginFrame waited for this set's last use
+				if (!textureWrites[frameIndex].empty()) {
+					writeTextures(*globalSetLayout, globalDescriptorSets[frameIndex], textureWrites[frameIndex]);
+					textureWrites[frameIndex].clear();
+				}
+
+				// and for its material buffer, which picks up the materials of models created in modelRegistry.update()
+				materialManager.updateGPUBuffer(frameIndex);
+
 				FrameInfo frameInfo{
 					frameIndex,
 					deltaTime,
 					commandBuffer,
 					camera,
 					globalDescriptorSets[frameIndex],
-					worldObjects
+					worldObjects,
+					*objectBuffers[frameIndex],
+					*instanceBuffers[frameIndex]
 				};
 
 				// update
@@ -138,12 +205,17 @@ namespace VkRenderer {
 
 				// rendering
 
+				onPreRender(frameInfo);
+
 				if (!renderer.beginSwapChainRenderPass(commandBuffer))
 					return;
 
 				onRender(commandBuffer, frameInfo);
 
 				renderer.endSwapChainRenderPass(commandBuffer);
+
+				// uploads recorded during this frame have to land before it on the queue
+				uploadContext.submit();
 				renderer.endFrame();
 			}
 		}
@@ -152,6 +224,22 @@ namespace VkRenderer {
 		vkDeviceWaitIdle(device.device());
 	}
 
+	void VulkanWorld::writeTextures(VulkanDescriptorSetLayout& setLayout, VkDescriptorSet descriptorSet, const std::vector<uint32_t>& textureIds)
+	{
+		const auto& textures = materialManager.getTextures();
+
+		std::vector<VkDescriptorImageInfo> images;
+		images.reserve(textureIds.size()); // the writer keeps pointers into it
+		for (uint32_t id : textureIds)
+			images.push_back({ textures[id]->getSampler(), textures[id]->getImageView(), textures[id]->getImageLayout() });
+
+		VulkanDescriptorWriter writer(setLayout, *globalPool);
+		for (size_t i = 0; i < textureIds.size(); i++)
+			writer.writeImageArray(BINDING_SAMPLER, &images[i], 1, textureIds[i]);
+
+		writer.overwrite(descriptorSet);
+	}
+
 	void VulkanWorld::parseImages(std::vector<VkDescriptorImageInfo> images)
 	{
 		imagesToWrite = std::move(images);
@@ -227,6 +315,20 @@ namespace VkRenderer {
 			.stageFlags = VK_SHADER_STAGE_ALL,
 		};
 
+		bindings[BINDING_OBJECTS] = {
+			.binding = BINDING_OBJECTS,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_ALL,
+		};
+
+		bindings[BINDING_INSTANCES] = {
+			.binding = BINDING_INSTANCES,
+			.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER,
+			.descriptorCount = 1,
+			.stageFlags = VK_SHADER_STAGE_ALL,
+		};
+
 		return bindings;
 	}
 
@@ -237,6 +339,8 @@ namespace VkRenderer {
 			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
 			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
 			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
+			VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT,
 		};
 
 		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
@@ -5,8 +5,10 @@
 #include "VulkanDevice.hpp"
 #include "VulkanObject.h"
 #include "VulkanFrameInfo.hpp"
+#include "GeometryPool.hpp"
 
 #include "managers/material_manager.hpp"
+#include "managers/model_registry.hpp"
 
 #include <functional>
 
@@ -15,6 +17,8 @@ namespace VkRenderer {
 	const uint32_t BINDING_SAMPLER = 1;
 	const uint32_t BINDING_IMAGE = 2;
 	const uint32_t BINDING_MATERIAL = 3;
+	const uint32_t BINDING_OBJECTS = 4;
+	const uint32_t BINDING_INSTANCES = 5;
 
 	class VulkanWorld
 	{
@@ -22,6 +26,7 @@ namespace VkRenderer {
 		using CreateRenderingSystems = std::function<void(VulkanDescriptorSetLayout*)>;
 		using OnFrameUpdate = std::function<void()>;
 		using OnUpdate = std::function<void(FrameInfo, GlobalUbo&)>;
+		using OnPreRender = std::function<void(FrameInfo frameInfo)>; // outside the render pass, for compute work the frame draws from
 		using OnRender = std::function<void(VkCommandBuffer commandBuffer, FrameInfo frameInfo)>;
 
 		VulkanWorld(VulkanWindow &window);
@@ -38,6 +43,7 @@ namespace VkRenderer {
 
 		VulkanDevice& getDevice();
 		VulkanRenderer& getRenderer();
+		GeometryPool& getGeometryPool() { return geometryPool; }
 
 		VulkanDescriptorPool* getGlobalPool() const { return globalPool.get(); }
 		VulkanObject::Map& getObjects() { return worldObjects; }
@@ -47,6 +53,7 @@ namespace VkRenderer {
 		void setCreateRenderingSystems(CreateRenderingSystems callback) { createRenderingSystemsCallback = callback; }
 		void setOnFrameUpdate(OnFrameUpdate callback) { onFrameUpdateCallback = callback; }
 		void setOnUpdate(OnUpdate callback) { onUpdateCallback = callback;}
+		void setOnPreRender(OnPreRender callback) { onPreRenderCallback = callback; }
 		void setOnRender(OnRender callback) { onRenderCallback = callback; }
 
 		float camera_nearDistance = 0.1f;
@@ -57,16 +64,19 @@ namespace VkRenderer {
 		void createRenderingSystems(auto layout) { if (createRenderingSystemsCallback) createRenderingSystemsCallback(layout); }
 		void onFrameUpdate() { if (onFrameUpdateCallback) onFrameUpdateCallback(); }
 		void onUpdate(FrameInfo frameInfo, GlobalUbo &ubo) { if (onUpdateCallback) onUpdateCallback(frameInfo, ubo); }
+		void onPreRender(FrameInfo frameInfo) { if (onPreRenderCallback) onPreRenderCallback(frameInfo); }
 		void onRender(VkCommandBuffer commandBuffer, FrameInfo frameInfo) { if (onRenderCallback) onRenderCallback(commandBuffer, frameInfo); }
 
 	private:
 		VulkanWindow& window;
 		VulkanDevice device;
 		VulkanRenderer renderer;
+		GeometryPool geometryPool{ device }; // has to outlive every model in worldObjects
 
 		CreateRenderingSystems createRenderingSystemsCallback;
 		OnFrameUpdate onFrameUpdateCallback;
 		OnUpdate onUpdateCallback;
+		OnPreRender onPreRenderCallback;
 		OnRender onRenderCallback;
 
 		std::unique_ptr<VulkanDescriptorPool> globalPool{};
@@ -74,13 +84,17 @@ namespace VkRenderer {
 
 		float deltaTime{ 0.0f };
 
-		std::array<VkDescriptorBindingFlags, 4> bindingFlags{};
+		std::array<VkDescriptorBindingFlags, 6> bindingFlags{};
 		std::vector<VkDescriptorImageInfo> imagesToWrite{};
 
+		// rewrites the sampler array entries of textureIds with what they show now
+		void writeTextures(VulkanDescriptorSetLayout& setLayout, VkDescriptorSet descriptorSet, const std::vector<uint32_t>& textureIds);
+
 		std::unordered_map<uint32_t, VkDescriptorSetLayoutBinding> createBindings();
 		VkDescriptorSetLayoutBindingFlagsCreateInfo createBindingFlags();
 
 	public: // make it below device creation
 		MaterialManager materialManager{ device };
+		ModelRegistry modelRegistry{ device, geometryPool, &materialManager }; // models loaded through here are shared by path
 	};
 }
\ No newline at end of file
@@ -2,39 +2,424 @@
 
 #include "material_manager.hpp"
 
+#include "ThreadPool.hpp"
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <utility>
+
 namespace VkRenderer {
+	namespace {
+		struct EncodedBytes {
+			const unsigned char* data = nullptr;
+			size_t size = 0;
+		};
+
+		std::vector<unsigned char> readFile(const std::filesystem::path& path)
+		{
+			std::ifstream file(path, std::ios::binary | std::ios::ate);
+			if (!file)
+				return {};
+
+			std::vector<unsigned char> bytes(static_cast<size_t>(file.tellg()));
+			file.seekg(0);
+			file.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+			return bytes;
+		}
+	}
+
 	MaterialManager::MaterialManager(VulkanDevice& device)
-		: device{ device }, buffer(device, 4, sizeof(Material)* MAX_MATERIAL_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+		: device{ device }
 	{
-		buffer.map();
+		for (auto& buffer : buffers) {
+			buffer = std::make_unique<VulkanBuffer>(device, sizeof(Material), MAX_MATERIAL_COUNT, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+			buffer->map();
+		}
 	}
 
 	MaterialManager::~MaterialManager()
-	{}
+	{
+		// the old views and textures go before anything else the manager owns
+		retired.flush();
+	}
 
 	void MaterialManager::addMaterial(std::string name, Material& material)
 	{
 		if (materials.find(name) == materials.end()) {
+			if (materialOrder.size() >= MAX_MATERIAL_COUNT)
+				throw std::runtime_error("Too many materials");
+
 			materialOrder.push_back(material);
 			size_t index = materialOrder.size() - 1;
 			materials[name] = index;
+			materialVersion++;
 		}
 	}
 
 	void MaterialManager::addTexture(std::string name, std::unique_ptr<VulkanTexture> texture)
 	{
 		if (textures.find(name) == textures.end()) {
+			textureViews.push_back(texture.get());
 			textureOrder.push_back(std::move(texture));
 			size_t index = textureOrder.size() - 1;
 			textures[name] = index;
+			changedTextures.push_back(static_cast<uint32_t>(index));
+
+			if (textureOrder[index]->isStreaming())
+				streamingTextures.push_back(static_cast<uint32_t>(index));
+			trackTexture(static_cast<uint32_t>(index));
 
 			std::cout << "Texture '" << name << "' index = " << textureOrder.size() - 1 << "\n";
 		}
 	}
 
-	void MaterialManager::updateGPUBuffer()
+	int MaterialManager::loadTexture(const std::string& name, const std::string& path, TextureUsage usage, const std::string& placeholder)
+	{
+		if (auto it = textures.find(name); it != textures.end())
+			return static_cast<int>(it->second);
+
+		uint32_t index = reserveTexture(name, placeholder);
+		textureLoader.load(path, usage, onTextureLoaded(index));
+
+		return static_cast<int>(index);
+	}
+
+	uint32_t MaterialManager::reserveTexture(const std::string& name, const std::string& placeholder)
+	{
+		VulkanTexture* placeholderTexture = getTexture(placeholder);
+		if (placeholderTexture == nullptr)
+			throw std::runtime_error("Missing placeholder texture '" + placeholder + "' for '" + name + "'");
+
+		uint32_t index = static_cast<uint32_t>(textureOrder.size());
+		textureOrder.push_back(nullptr);
+		textureViews.push_back(placeholderTexture);
+		textures[name] = index;
+		changedTextures.push_back(index);
+
+		return index;
+	}
+
+	TextureLoader::Callback MaterialManager::onTextureLoaded(uint32_t index)
+	{
+		return [this, index](std::unique_ptr<VulkanTexture> texture) {
+			// a failed load keeps the placeholder
+			if (texture == nullptr)
+				return;
+
+			textureOrder[index] = std::move(texture);
+			uploadingTextures.push_back(index);
+		};
+	}
+
+	void MaterialManager::update()
+	{
+		// update runs before beginFrame, so anything replaced now can be in every frame in flight plus the one being recorded
+		retired.update();
+
+		textureLoader.upload();
+
+		std::erase_if(uploadingTextures, [this](uint32_t index) {
+			if (!textureOrder[index]->isReady())
+				return false;
+
+			textureViews[index] = textureOrder[index].get();
+			changedTextures.push_back(index);
+
+			if (textureOrder[index]->isStreaming())
+				streamingTextures.push_back(index);
+			trackTexture(index);
+			return true;
+		});
+
+		updateResidency();
+		updateStreaming();
+	}
+
+	void MaterialManager::markMaterialUsed(uint32_t material)
+	{
+		if (material >= materialOrder.size())
+			return;
+
+		residency.touch(materialOrder[material].albedoIndex);
+		residency.touch(materialOrder[material].normalIndex);
+	}
+
+	void MaterialManager::trackTexture(uint32_t index)
+	{
+		VulkanTexture& texture = *textureOrder[index];
+		residency.track(index, texture.getMemorySize(), texture.canTrim(), texture.isTrimmed());
+	}
+
+	void MaterialManager::replaceTexture(uint32_t index, bool trimmed)
+	{
+		// the file is still mapped, so neither needs a decode. a reload only uploads the tail, the rest streams in again
+		const auto& file = textureOrder[index]->getKtx2File();
+
+		auto texture = std::make_unique<VulkanTexture>(device, file->getFormat());
+		texture->loadKtx2(file, VulkanTexture::STREAMING_TAIL_SIZE, trimmed);
+		replacements.push_back({ index, std::move(texture) });
+	}
+
+	void MaterialManager::updateResidency()
+	{
+		std::erase_if(replacements, [this](Replacement& replacement) {
+			if (!replacement.texture->isReady())
+				return false;
+
+			uint32_t index = replacement.index;
+			retired.retire([texture = std::shared_ptr<VulkanTexture>(std::move(textureOrder[index]))]() {});
+
+			textureOrder[index] = std::move(replacement.texture);
+			textureViews[index] = textureOrder[index].get();
+			changedTextures.push_back(index);
+
+			std::erase(streamingTextures, index);
+			if (textureOrder[index]->isStreaming())
+				streamingTextures.push_back(index);
+
+			trackTexture(index);
+			return true;
+		});
+
+		ResidencyManager::Changes changes = residency.update();
+
+		for (uint32_t index : changes.reload)
+			replaceTexture(index, false);
+		for (uint32_t index : changes.trim)
+			replaceTexture(index, true);
+	}
+
+	void MaterialManager::updateStreaming()
+	{
+		for (uint32_t index : streamingTextures) {
+			VkImageView oldView = textureOrder[index]->updateStreaming();
+			if (oldView == VK_NULL_HANDLE)
+				continue;
+
+			retired.retire([this, oldView]() { vkDestroyImageView(device.device(), oldView, nullptr); });
+			changedTextures.push_back(index);
+		}
+
+		std::erase_if(streamingTextures, [this](uint32_t index) { return !textureOrder[index]->isStreaming(); });
+
+		// one level per texture at a time, smallest first, so everything gets sharper before anything gets its top mip
+		std::vector<std::pair<VkDeviceSize, uint32_t>> next;
+		for (uint32_t index : streamingTextures)
+			if (VkDeviceSize size = textureOrder[index]->getNextLevelSize(); size > 0)
+				next.emplace_back(size, index);
+
+		std::sort(next.begin(), next.end());
+
+		// always takes one, a top mip bigger than the budget would never go in otherwise
+		VkDeviceSize staged = 0;
+		for (auto& [size, index] : next) {
+			if (staged > 0 && staged + size > STREAMING_BUDGET)
+				break;
+
+			textureOrder[index]->streamLevel();
+			staged += size;
+		}
+	}
+
+	std::vector<uint32_t> MaterialManager::takeChangedTextures()
 	{
-		buffer.writeToBuffer(materialOrder.data());
+		return std::exchange(changedTextures, {});
+	}
+
+	void MaterialManager::updateGPUBuffer(int frameIndex)
+	{
+		if (bufferVersions[frameIndex] == materialVersion || materialOrder.empty())
+			return;
+
+		VulkanBuffer& buffer = *buffers[frameIndex];
+		buffer.writeToBuffer(materialOrder.data(), materialOrder.size() * sizeof(Material));
+		buffer.flush();
+
+		bufferVersions[frameIndex] = materialVersion;
+	}
+
+	std::vector<uint32_t> MaterialManager::importMaterials(const VulkanModel::Builder& builder, const std::string& prefix)
+	{
+		// one request per image and usage, the same image can be used as albedo (srgb) and as something linear
+		struct TextureRequest {
+			int image;
+			TextureUsage usage;
+			std::string name;
+			uint64_t key = 0;
+			int texture = -1;
+			int pending = -1; // index into decodes
+		};
+
+		std::vector<TextureRequest> requests;
+
+		auto request = [&](int image, TextureUsage usage) -> int {
+			if (image < 0 || image >= static_cast<int>(builder.images.size()))
+				return -1;
+
+			for (size_t i = 0; i < requests.size(); i++)
+				if (requests[i].image == image && requests[i].usage == usage)
+					return static_cast<int>(i);
+
+			requests.push_back({ image, usage });
+			return static_cast<int>(requests.size() - 1);
+		};
+
+		std::vector<std::pair<int, int>> materialRequests;
+		for (auto& material : builder.materials) {
+			int albedo = request(material.albedoImage, TextureUsage::Color);
+			int normal = request(material.normalImage, TextureUsage::Normal);
+			materialRequests.emplace_back(albedo, normal);
+		}
+
+		// uri matches are resolved before anything gets read or hashed
+		for (auto& req : requests) {
+			auto& source = builder.images[req.image];
+
+			std::stringstream name;
+			if (!source.uri.empty())
+				name << (std::filesystem::path(builder.directory) / source.uri).lexically_normal().generic_string();
+			else
+				name << prefix << ":image" << req.image;
+			if (req.usage != TextureUsage::Color)
+				name << "#linear";
+			req.name = name.str();
+
+			if (auto it = textures.find(req.name); it != textures.end()) {
+				req.texture = static_cast<int>(it->second);
+				continue;
+			}
+
+			// cooked flipped, the same way the decode below reads glTF images
+			if (device.features.textureCompressionBC && !source.uri.empty() && !source.buffer && source.encoded.empty()) {
+				std::string path = (std::filesystem::path(builder.directory) / source.uri).string();
+
+				if (auto cooked = GetTextureCache().load(path, req.usage, true)) {
+					auto texture = std::make_unique<VulkanTexture>(device, cooked->getFormat());
+					texture->loadKtx2(std::move(cooked), VulkanTexture::STREAMING_TAIL_SIZE);
+
+					addTexture(req.name, std::move(texture));
+					req.texture = getTextureId(req.name);
+				}
+			}
+		}
+
+		// external images are read here, embedded ones point into the file buffer or carry their data uri bytes
+		std::vector<std::vector<unsigned char>> fileBytes(builder.images.size());
+		std::vector<uint64_t> imageHashes(builder.images.size(), 0);
+		std::vector<bool> used(builder.images.size(), false);
+		for (auto& req : requests)
+			if (req.texture < 0)
+				used[req.image] = true;
+
+		auto bytesOf = [&](size_t image) -> EncodedBytes {
+			auto& source = builder.images[image];
+
+			if (source.buffer && source.byteOffset + source.byteLength <= source.buffer->size())
+				return { source.buffer->data() + source.byteOffset, source.byteLength };
+			if (!source.encoded.empty())
+				return { source.encoded.data(), source.encoded.size() };
+			return { fileBytes[image].data(), fileBytes[image].size() };
+		};
+
+		GetThreadPool().parallelFor(builder.images.size(), [&](size_t i) {
+			if (!used[i])
+				return;
+
+			auto& source = builder.images[i];
+			if (!source.buffer && source.encoded.empty() && !source.uri.empty())
+				fileBytes[i] = readFile(std::filesystem::path(builder.directory) / source.uri);
+
+			EncodedBytes bytes = bytesOf(i);
+			imageHashes[i] = hashBytes(bytes.data, bytes.size);
+		});
+
+		// then by content, against earlier imports and against the other images of this file
+		std::vector<int> decodes; // request index of every image that still needs decoding
+		std::unordered_map<uint64_t, int> pendingKeys;
+
+		for (size_t i = 0; i < requests.size(); i++) {
+			auto& req = requests[i];
+			if (req.texture >= 0)
+				continue;
+
+			req.key = imageHashes[req.image] ^ (static_cast<uint64_t>(getSourceFormat(req.usage)) * 0x9E3779B97F4A7C15ull);
+
+			if (auto it = textureHashes.find(req.key); it != textureHashes.end())
+				req.texture = static_cast<int>(it->second);
+			else if (auto it = pendingKeys.find(req.key); it != pendingKeys.end())
+				req.pending = it->second;
+			else if (bytesOf(req.image).size > 0) {
+				req.pending = static_cast<int>(decodes.size());
+				pendingKeys[req.key] = req.pending;
+				decodes.push_back(static_cast<int>(i));
+			}
+			else
+				std::cerr << "Missing image for texture '" << req.name << "'\n";
+		}
+
+		// decoded by the texture loader like loadTexture, flipped to match the flipped glTF uvs. the ids show the
+		// placeholders until the upload lands, the bytes stay alive with the decode
+		std::vector<int> decodedTextures(decodes.size(), -1);
+
+		for (size_t i = 0; i < decodes.size(); i++) {
+			auto& req = requests[decodes[i]];
+			auto& source = builder.images[req.image];
+
+			std::shared_ptr<const void> owner;
+			EncodedBytes bytes = bytesOf(req.image);
+
+			if (source.buffer && bytes.data == source.buffer->data() + source.byteOffset)
+				owner = source.buffer;
+			else {
+				// data uri bytes and read files go away with this call, the decode takes them along
+				auto copy = !source.encoded.empty()
+					? std::make_shared<std::vector<unsigned char>>(source.encoded)
+					: std::make_shared<std::vector<unsigned char>>(std::move(fileBytes[req.image]));
+
+				bytes = { copy->data(), copy->size() };
+				owner = std::move(copy);
+			}
+
+			uint32_t index = reserveTexture(req.name, req.usage == TextureUsage::Normal ? "default_normal" : "default");
+			textureLoader.loadEncoded(req.name, std::move(owner), bytes.data, bytes.size, req.usage, true, onTextureLoaded(index));
+
+			decodedTextures[i] = static_cast<int>(index);
+			textureHashes[req.key] = index;
+		}
+
+		auto textureFor = [&](int requestIndex, const char* fallback) -> uint32_t {
+			if (requestIndex >= 0) {
+				auto& req = requests[requestIndex];
+
+				if (req.texture >= 0)
+					return req.texture;
+				if (req.pending >= 0 && decodedTextures[req.pending] >= 0)
+					return decodedTextures[req.pending];
+			}
+
+			return getTextureId(fallback);
+		};
+
+		std::vector<uint32_t> materialIds;
+		materialIds.reserve(builder.materials.size());
+
+		for (size_t i = 0; i < builder.materials.size(); i++) {
+			auto& source = builder.materials[i];
+
+			Material material{};
+			material.albedoIndex = textureFor(materialRequests[i].first, "default");
+			material.normalIndex = textureFor(materialRequests[i].second, "default_normal");
+
+			std::string name = prefix + ":" + (source.name.empty() ? std::to_string(i) : source.name);
+			addMaterial(name, material);
+			materialIds.push_back(getMaterialId(name));
+		}
+
+		return materialIds;
 	}
 
 	VulkanTexture* MaterialManager::getTexture(const std::string& name) const
@@ -44,8 +429,8 @@ namespace VkRenderer {
 		if (it != textures.end()) {
 			size_t Index = it->second;
 
-			if (Index < textureOrder.size()) 
-				return textureOrder[Index].get();
+			if (Index < textureViews.size()) 
+				return textureViews[Index];
 			
 		}
 
@@ -1,6 +1,8 @@
 #pragma once
 
+#include <array>
 #include <iostream>
+#include <memory>
 #include <vector>
 #include <string>
 #include <unordered_map>
@@ -8,6 +10,11 @@
 #include "VulkanTexture.hpp"
 #include "VulkanBuffer.hpp"
 #include "VulkanDevice.hpp"
+#include "VulkanModel.hpp"
+#include "VulkanSwapChain.hpp"
+#include "DeferredDestroyQueue.hpp"
+#include "TextureLoader.hpp"
+#include "residency_manager.hpp"
 
 namespace VkRenderer {
 	const int MAX_MATERIAL_COUNT = 100;
@@ -21,12 +28,37 @@ namespace VkRenderer {
 	class MaterialManager
 	{
 	public:
+		static constexpr VkDeviceSize STREAMING_BUDGET = 8ull * 1024 * 1024; // mip levels staged per update
+
 		MaterialManager(VulkanDevice& device);
 		~MaterialManager();
 
 		void addMaterial(std::string name, Material& material);
 		void addTexture(std::string name, std::unique_ptr<VulkanTexture> texture);
-		void updateGPUBuffer();
+		// decodes the file on the thread pool, the returned id shows the placeholder texture until the real one is uploaded
+		int loadTexture(const std::string& name, const std::string& path, TextureUsage usage = TextureUsage::Color, const std::string& placeholder = "default");
+		// copies the materials into the frame's buffer when they changed since it was last written. models loaded
+		// at runtime add materials while other frames still read theirs, so every frame in flight has its own
+		void updateGPUBuffer(int frameIndex);
+
+		// world thread, once per frame: uploads a batch of decoded textures and swaps in the ones whose upload finished,
+		// trims or reloads textures for the residency budget, then streams the next mips of cooked textures, smallest
+		// first, and swaps in views that include the ones that landed
+		void update();
+		// draw path, the material's textures are sampled by the frame being recorded
+		void markMaterialUsed(uint32_t material);
+		// texture ids whose image changed since the last call, their descriptors have to be rewritten
+		std::vector<uint32_t> takeChangedTextures();
+		uint32_t getLoadingTextureCount() const { return textureLoader.getPendingCount() + static_cast<uint32_t>(uploadingTextures.size()); }
+		// shown, but still missing some of their finer mips
+		uint32_t getStreamingTextureCount() const { return static_cast<uint32_t>(streamingTextures.size()); }
+		ResidencyManager& getResidency() { return residency; }
+
+		// registers the textures and materials of a loaded model file, returns the material id for every file material.
+		// images are deduplicated by uri and by content, so the same image is never decoded twice. external images
+		// with a current cooked file are loaded from that instead. the rest decode in the texture loader, their ids show
+		// the default textures until they're uploaded, like loadTexture
+		std::vector<uint32_t> importMaterials(const VulkanModel::Builder& builder, const std::string& prefix);
 
 		VulkanTexture* getTexture(const std::string& name) const;
 		int getTextureId(const std::string& name);
@@ -35,17 +67,43 @@ namespace VkRenderer {
 		const std::vector<Material>& getMaterials() const { return materialOrder; }
 		const std::unordered_map<std::string, size_t> getMaterialItems() const { return materials; }
 
-		auto getDescriptorInfo() { return buffer.descriptorInfo(); }
-		const std::vector<std::unique_ptr<VulkanTexture>>& getTextures() const { return textureOrder; }
+		auto getDescriptorInfo(int frameIndex) { return buffers[frameIndex]->descriptorInfo(); }
+		// what every texture id shows right now, the placeholder while it's still loading
+		const std::vector<VulkanTexture*>& getTextures() const { return textureViews; }
 		const std::unordered_map<std::string, size_t>& getTextureItems() const { return textures; }
 	private:
+		// takes over its texture id once its upload landed
+		struct Replacement {
+			uint32_t index;
+			std::unique_ptr<VulkanTexture> texture;
+		};
+
+		// a new texture id that shows the placeholder until onTextureLoaded's callback gets the real one
+		uint32_t reserveTexture(const std::string& name, const std::string& placeholder);
+		TextureLoader::Callback onTextureLoaded(uint32_t index);
+		void trackTexture(uint32_t index);
+		void replaceTexture(uint32_t index, bool trimmed);
+		void updateResidency();
+		void updateStreaming();
+
 		std::vector<Material> materialOrder;
 		std::unordered_map<std::string, size_t> materials;
 
-		std::vector<std::unique_ptr<VulkanTexture>> textureOrder;
+		std::vector<std::unique_ptr<VulkanTexture>> textureOrder; // null while loading
+		std::vector<VulkanTexture*> textureViews;
+		std::vector<uint32_t> uploadingTextures;
+		std::vector<uint32_t> streamingTextures;
+		std::vector<Replacement> replacements;
+		DeferredDestroyQueue retired; // replaced textures and views, may still be bound in a frame in flight
+		std::vector<uint32_t> changedTextures;
 		std::unordered_map<std::string, size_t> textures;
+		std::unordered_map<uint64_t, size_t> textureHashes; // content hash + format of imported images
 
 		VulkanDevice& device;
-		VulkanBuffer buffer;
+		std::array<std::unique_ptr<VulkanBuffer>, VulkanSwapChain::MAX_FRAMES_IN_FLIGHT> buffers;
+		std::array<uint64_t, VulkanSwapChain::MAX_FRAMES_IN_FLIGHT> bufferVersions{}; // materialVersion each buffer was written at
+		uint64_t materialVersion = 1;
+		ResidencyManager residency{ device };
+		TextureLoader textureLoader{ device }; // last, its decodes finish before anything above goes away
 	};
 }
\ No newline at end of file
@@ -0,0 +1,182 @@
+#include "model_registry.hpp"
+
+#include "material_manager.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+
+namespace fs = std::filesystem;
+
+namespace VkRenderer {
+	ModelRegistry::ModelRegistry(VulkanDevice& device, GeometryPool& geometryPool, MaterialManager* materialManager)
+		: device{ device }, geometryPool{ geometryPool }, materialManager{ materialManager }
+	{}
+
+	ModelRegistry::~ModelRegistry()
+	{
+		// loads still running on the pool don't touch the registry, but their files shouldn't outlive it
+		for (auto& [key, entry] : entries) {
+			if (entry.file.valid())
+				entry.file.wait();
+		}
+	}
+
+	std::string ModelRegistry::makeKey(const std::string& filepath)
+	{
+		std::error_code error;
+		fs::path path = fs::weakly_canonical(fs::path(filepath), error);
+		if (error)
+			path = fs::absolute(fs::path(filepath));
+
+		return path.generic_string();
+	}
+
+	std::shared_future<ModelRegistry::Handle> ModelRegistry::request(const std::string& filepath)
+	{
+		std::string key = makeKey(filepath);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto it = entries.find(key);
+		if (it != entries.end() && it->second.model != nullptr) {
+			std::promise<Handle> loaded;
+			loaded.set_value(it->second.model);
+			return loaded.get_future().share();
+		}
+
+		if (it != entries.end())
+			return it->second.ready;
+
+		Entry& entry = entries[key];
+		entry.ready = entry.promise.get_future().share();
+
+		bool materials = materialManager != nullptr;
+		entry.file = GetThreadPool().submit([filepath, materials]() { return VulkanModel::loadFile(filepath, materials); });
+
+		return entry.ready;
+	}
+
+	ModelRegistry::Handle ModelRegistry::load(const std::string& filepath)
+	{
+		std::shared_future<Handle> ready = request(filepath);
+		std::string key = makeKey(filepath);
+
+		// entries are only finished and removed on this thread and other threads only add new ones, so the entry stays
+		// where it is while the file is waited for without the lock
+		Entry* entry = nullptr;
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+
+			auto it = entries.find(key);
+			if (it != entries.end() && it->second.file.valid())
+				entry = &it->second;
+		}
+
+		if (entry != nullptr) {
+			entry->file.wait();
+
+			std::lock_guard<std::mutex> lock{ mutex };
+			if (!finish(key, *entry))
+				entries.erase(key);
+		}
+
+		return ready.get();
+	}
+
+	bool ModelRegistry::finish(const std::string& key, Entry& entry)
+	{
+		try {
+			std::unique_ptr<VulkanModel::FileData> file = entry.file.get();
+
+			entry.model = VulkanModel::createModel(device, geometryPool, *file, materialManager);
+			loadOrder[entry.model.get()] = nextOrder++;
+
+			// the future's copy would count as a reference forever, callers still waiting keep theirs
+			entry.promise.set_value(entry.model);
+			entry.promise = {};
+			entry.ready = {};
+			return true;
+		}
+		catch (const std::exception& e) {
+			std::cerr << "Failed to load model '" << key << "': " << e.what() << "\n";
+
+			// dropped so the next request tries again
+			entry.promise.set_exception(std::current_exception());
+			return false;
+		}
+	}
+
+	void ModelRegistry::update()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		for (auto it = entries.begin(); it != entries.end();) {
+			Entry& entry = it->second;
+
+			bool loaded = entry.file.valid() && entry.file.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+			if (loaded && !finish(it->first, entry))
+				it = entries.erase(it);
+			else
+				++it;
+		}
+
+		// update runs before beginFrame, so a model unloaded now can be in every frame in flight plus the one being recorded
+		retired.update();
+	}
+
+	size_t ModelRegistry::unloadUnused()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		size_t unloaded = 0;
+		for (auto it = entries.begin(); it != entries.end();) {
+			Entry& entry = it->second;
+
+			if (entry.model == nullptr || entry.model.use_count() > 1) {
+				++it;
+				continue;
+			}
+
+			loadOrder.erase(entry.model.get());
+			retired.retire([model = std::move(entry.model)]() {});
+
+			it = entries.erase(it);
+			unloaded++;
+		}
+
+		return unloaded;
+	}
+
+	void ModelRegistry::gatherInstances(VulkanObject::Map& objects, std::vector<InstanceGroup>& groups) const
+	{
+		groups.clear();
+
+		std::unordered_map<const VulkanModel*, size_t> groupIndices;
+		for (auto& [id, object] : objects) {
+			if (object.model == nullptr)
+				continue;
+
+			auto [it, inserted] = groupIndices.try_emplace(object.model.get(), groups.size());
+			if (inserted)
+				groups.push_back({ object.model.get(), {} });
+
+			groups[it->second].objects.push_back(&object);
+		}
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		auto orderOf = [this](const VulkanModel* model) {
+			auto it = loadOrder.find(model);
+			return it != loadOrder.end() ? it->second : UINT64_MAX;
+		};
+
+		std::sort(groups.begin(), groups.end(), [&](const InstanceGroup& a, const InstanceGroup& b) {
+			uint64_t orderA = orderOf(a.model);
+			uint64_t orderB = orderOf(b.model);
+			return orderA != orderB ? orderA < orderB : a.model < b.model;
+		});
+	}
+}
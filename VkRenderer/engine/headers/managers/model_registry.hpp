@@ -0,0 +1,79 @@
+#pragma once
+
+#include <future>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+#include "VulkanModel.hpp"
+#include "VulkanObject.h"
+#include "GeometryPool.hpp"
+#include "DeferredDestroyQueue.hpp"
+
+namespace VkRenderer {
+	class MaterialManager;
+
+	/*
+	 * One VulkanModel per model file. Loading a path that is loaded already returns the same shared handle, and a path
+	 * that is still loading hands out the load in flight instead of starting a second one. Files are read on the thread
+	 * pool, the models are created in update() since upload recording stays on the world thread.
+	 * The registry holds a reference of its own, unloadUnused() drops the models nobody else holds anymore.
+	 */
+	class ModelRegistry
+	{
+	public:
+		using Handle = std::shared_ptr<VulkanModel>;
+
+		ModelRegistry(VulkanDevice& device, GeometryPool& geometryPool, MaterialManager* materialManager = nullptr);
+		~ModelRegistry();
+
+		ModelRegistry(const ModelRegistry&) = delete;
+		ModelRegistry& operator=(const ModelRegistry&) = delete;
+
+		// safe from any thread. the future becomes ready in the update() that creates the model, and rethrows if the load failed
+		std::shared_future<Handle> request(const std::string& filepath);
+		// request and wait for it, world thread only
+		Handle load(const std::string& filepath);
+
+		// world thread, once per frame before recording: creates the models whose files are read and destroys unloaded
+		// models once no frame in flight can still draw them
+		void update();
+
+		// world thread, returns how many models were unloaded
+		size_t unloadUnused();
+
+		// objects grouped by the model they draw, every group can go out as instanced draws. registered models come
+		// in load order so the grouping is stable between frames, models created outside the registry come after
+		struct InstanceGroup {
+			VulkanModel* model;
+			std::vector<VulkanObject*> objects;
+		};
+
+		void gatherInstances(VulkanObject::Map& objects, std::vector<InstanceGroup>& groups) const;
+	private:
+		struct Entry {
+			Handle model{};
+
+			// only while loading
+			std::future<std::unique_ptr<VulkanModel::FileData>> file{}; // read on the thread pool
+			std::promise<Handle> promise{};
+			std::shared_future<Handle> ready{};
+		};
+
+		static std::string makeKey(const std::string& filepath);
+		bool finish(const std::string& key, Entry& entry);
+
+		VulkanDevice& device;
+		GeometryPool& geometryPool;
+		MaterialManager* materialManager;
+
+		mutable std::mutex mutex;
+		std::unordered_map<std::string, Entry> entries; // by canonical path
+		std::unordered_map<const VulkanModel*, uint64_t> loadOrder;
+		DeferredDestroyQueue retired;
+		uint64_t nextOrder = 0;
+	};
+}
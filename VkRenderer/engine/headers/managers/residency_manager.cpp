@@ -0,0 +1,104 @@
+#include "residency_manager.hpp"
+
+#include "VulkanTexture.hpp"
+
+#include <algorithm>
+
+namespace VkRenderer {
+	ResidencyManager::ResidencyManager(VulkanDevice& device)
+		: device{ device }
+	{}
+
+	uint32_t ResidencyManager::getTrimmedCount() const
+	{
+		return static_cast<uint32_t>(std::count_if(entries.begin(), entries.end(), [](const Entry& entry) { return entry.tracked && entry.trimmed; }));
+	}
+
+	void ResidencyManager::track(uint32_t texture, VkDeviceSize bytes, bool canTrim, bool trimmed)
+	{
+		if (texture >= entries.size())
+			entries.resize(texture + 1);
+
+		Entry& entry = entries[texture];
+		if (entry.tracked)
+			residentBytes -= entry.bytes;
+		else
+			entry.lastUsed = updateCount; // a new texture gets the same grace period as a drawn one
+
+		if (!trimmed)
+			entry.fullBytes = bytes;
+
+		entry.bytes = bytes;
+		entry.tracked = true;
+		entry.canTrim = canTrim;
+		entry.trimmed = trimmed;
+		entry.pending = false;
+
+		residentBytes += bytes;
+	}
+
+	void ResidencyManager::touch(uint32_t texture)
+	{
+		if (texture < entries.size())
+			entries[texture].lastUsed = updateCount;
+	}
+
+	ResidencyManager::Changes ResidencyManager::update()
+	{
+		// everything that isn't one of our textures keeps its memory, the textures get what's left
+		VulkanMemoryBudget memory = device.getMemoryBudget();
+		VkDeviceSize others = memory.usage > residentBytes ? memory.usage - residentBytes : 0;
+		VkDeviceSize available = static_cast<VkDeviceSize>(memory.budget * BUDGET_HEADROOM);
+
+		budget = available > others ? available - others : 0;
+		if (budgetLimit > 0)
+			budget = std::min(budget, budgetLimit);
+
+		Changes changes;
+
+		// drawn since the last update. they come back whatever the budget says, a reload allocates the whole chain again
+		VkDeviceSize projected = 0;
+		for (uint32_t i = 0; i < entries.size(); i++) {
+			Entry& entry = entries[i];
+			if (!entry.tracked)
+				continue;
+
+			if (entry.trimmed && !entry.pending && entry.lastUsed == updateCount) {
+				entry.pending = true;
+				entry.pendingBytes = std::max(entry.fullBytes, entry.bytes);
+				changes.reload.push_back(i);
+			}
+
+			projected += entry.pending ? entry.pendingBytes : entry.bytes;
+		}
+
+		if (projected > budget) {
+			std::vector<uint32_t> candidates;
+			for (uint32_t i = 0; i < entries.size(); i++) {
+				const Entry& entry = entries[i];
+				if (entry.tracked && entry.canTrim && !entry.pending && updateCount - entry.lastUsed >= MIN_IDLE_UPDATES)
+					candidates.push_back(i);
+			}
+
+			std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) {
+				return entries[a].lastUsed < entries[b].lastUsed;
+			});
+
+			for (uint32_t i : candidates) {
+				if (projected <= budget)
+					break;
+
+				// the tail that stays is never more than what the streaming tail allows
+				Entry& entry = entries[i];
+				entry.pending = true;
+				entry.pendingBytes = std::min(entry.bytes, VulkanTexture::STREAMING_TAIL_SIZE);
+
+				projected -= entry.bytes - entry.pendingBytes;
+				changes.trim.push_back(i);
+			}
+		}
+
+		updateCount++;
+		return changes;
+	}
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "VulkanDevice.hpp"
+
+namespace VkRenderer {
+	/*
+	 * Keeps the textures of a MaterialManager inside a VRAM budget. It knows every texture's memory size and the last
+	 * update it was drawn in, which the draw path reports through touch(). Once the textures add up to more than the
+	 * budget, the ones that went unused the longest are trimmed to their mip tail. A trimmed texture that gets drawn
+	 * again is reloaded at full size, and its finer mips stream back in. Only textures from cooked files can be trimmed,
+	 * decoded ones stay resident. This only decides, MaterialManager swaps the textures.
+	 */
+	class ResidencyManager
+	{
+	public:
+		static constexpr uint64_t MIN_IDLE_UPDATES = 120; // unused this long before a texture is trimmed, so looking around doesn't reload everything
+		static constexpr float BUDGET_HEADROOM = 0.9f; // of the device budget, leaves room for what gets allocated between updates
+
+		explicit ResidencyManager(VulkanDevice& device);
+
+		ResidencyManager(const ResidencyManager&) = delete;
+		ResidencyManager& operator=(const ResidencyManager&) = delete;
+
+		// caps the texture budget, 0 leaves it to the device budget (VK_EXT_memory_budget when there is one)
+		void setBudgetLimit(VkDeviceSize bytes) { budgetLimit = bytes; }
+		VkDeviceSize getBudgetLimit() const { return budgetLimit; }
+
+		// what the textures got in the last update, the device budget less everything else that's allocated
+		VkDeviceSize getBudget() const { return budget; }
+		VkDeviceSize getResidentBytes() const { return residentBytes; }
+		uint32_t getTrimmedCount() const;
+
+		// a new texture or one that was swapped. trimmed means only its mip tail is allocated
+		void track(uint32_t texture, VkDeviceSize bytes, bool canTrim, bool trimmed);
+		// draw path, the texture is sampled by the frame being recorded
+		void touch(uint32_t texture);
+
+		struct Changes {
+			std::vector<uint32_t> reload; // trimmed and drawn again
+			std::vector<uint32_t> trim;   // coldest first, until the rest fits
+		};
+
+		// world thread, once per frame. the textures it returns are left alone until they're tracked again
+		Changes update();
+	private:
+		struct Entry {
+			VkDeviceSize bytes = 0;
+			VkDeviceSize fullBytes = 0; // before it was trimmed
+			VkDeviceSize pendingBytes = 0; // what it will have once the swap is done
+			uint64_t lastUsed = 0;
+			bool tracked = false;
+			bool canTrim = false;
+			bool trimmed = false;
+			bool pending = false;
+		};
+
+		VulkanDevice& device;
+		std::vector<Entry> entries; // by texture id
+
+		uint64_t updateCount = 0;
+		VkDeviceSize budgetLimit = 0;
+		VkDeviceSize budget = 0;
+		VkDeviceSize residentBytes = 0;
+	};
+}
@@ -0,0 +1,45 @@
+#include "DeferredDestroyQueue.hpp"
+
+#include <utility>
+
+namespace VkRenderer {
+	DeferredDestroyQueue::~DeferredDestroyQueue()
+	{
+		flush();
+	}
+
+	void DeferredDestroyQueue::retire(std::function<void()> destroy)
+	{
+		entries.push_back({ std::move(destroy), FRAMES });
+	}
+
+	void DeferredDestroyQueue::update()
+	{
+		// run after the erase, a destroy could retire something else
+		std::vector<std::function<void()>> due;
+		std::erase_if(entries, [&](Entry& entry) {
+			if (--entry.framesLeft > 0)
+				return false;
+
+			due.push_back(std::move(entry.destroy));
+			return true;
+		});
+
+		for (auto& destroy : due)
+			if (destroy)
+				destroy();
+	}
+
+	void DeferredDestroyQueue::flush()
+	{
+		// taken first for the same reason, and whatever those retire goes right after them
+		while (!entries.empty()) {
+			std::vector<Entry> remaining = std::move(entries);
+			entries.clear();
+
+			for (Entry& entry : remaining)
+				if (entry.destroy)
+					entry.destroy();
+		}
+	}
+}
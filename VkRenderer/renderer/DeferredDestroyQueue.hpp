@@ -0,0 +1,41 @@
+#pragma once
+
+#include "VulkanSwapChain.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+namespace VkRenderer {
+	/*
+	 * Things a frame in flight may still use. Everything retired waits out every frame in flight plus the one being
+	 * recorded before its destroy runs. The callback owns whatever it captures, so a model or texture can be kept
+	 * alive by capturing a shared_ptr and passing an empty body.
+	 */
+	class DeferredDestroyQueue
+	{
+		public:
+			static constexpr uint32_t FRAMES = VulkanSwapChain::MAX_FRAMES_IN_FLIGHT + 1;
+
+			DeferredDestroyQueue() = default;
+			~DeferredDestroyQueue();
+
+			DeferredDestroyQueue(const DeferredDestroyQueue&) = delete;
+			DeferredDestroyQueue& operator=(const DeferredDestroyQueue&) = delete;
+
+			void retire(std::function<void()> destroy);
+			// once per frame before recording, runs the destroys that waited out FRAMES calls
+			void update();
+			// runs everything left right away, only once the device is idle. the destructor does the same
+			void flush();
+
+			bool empty() const { return entries.empty(); }
+		private:
+			struct Entry {
+				std::function<void()> destroy;
+				uint32_t framesLeft;
+			};
+
+			std::vector<Entry> entries;
+	};
+}
@@ -0,0 +1,72 @@
+#include "RangeAllocator.hpp"
+
+#include <cassert>
+#include <iterator>
+
+namespace VkRenderer {
+	void RangeAllocator::reset(VkDeviceSize newCapacity)
+	{
+		freeRanges.clear();
+		freeRanges[0] = newCapacity;
+		capacity = newCapacity;
+		used = 0;
+	}
+
+	bool RangeAllocator::allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset)
+	{
+		if (size == 0) {
+			offset = 0;
+			return true;
+		}
+
+		if (alignment == 0)
+			alignment = 1;
+
+		for (auto it = freeRanges.begin(); it != freeRanges.end(); ++it) {
+			VkDeviceSize rangeOffset = it->first;
+			VkDeviceSize rangeEnd = it->first + it->second;
+
+			// strides aren't always a power of two (60 byte vertices, 20 byte compact ones), so round up the slow way
+			VkDeviceSize aligned = (rangeOffset + alignment - 1) / alignment * alignment;
+			if (aligned + size > rangeEnd)
+				continue;
+
+			freeRanges.erase(it);
+
+			if (aligned > rangeOffset)
+				freeRanges[rangeOffset] = aligned - rangeOffset;
+			if (aligned + size < rangeEnd)
+				freeRanges[aligned + size] = rangeEnd - (aligned + size);
+
+			offset = aligned;
+			used += size;
+			return true;
+		}
+
+		return false;
+	}
+
+	void RangeAllocator::free(VkDeviceSize offset, VkDeviceSize size)
+	{
+		if (size == 0)
+			return;
+
+		auto [it, inserted] = freeRanges.emplace(offset, size);
+		assert(inserted && "Range freed twice");
+		used -= size;
+
+		auto next = std::next(it);
+		if (next != freeRanges.end() && it->first + it->second == next->first) {
+			it->second += next->second;
+			freeRanges.erase(next);
+		}
+
+		if (it != freeRanges.begin()) {
+			auto prev = std::prev(it);
+			if (prev->first + prev->second == it->first) {
+				prev->second += it->second;
+				freeRanges.erase(it);
+			}
+		}
+	}
+}
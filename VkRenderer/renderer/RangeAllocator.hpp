@@ -0,0 +1,31 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <map>
+
+namespace VkRenderer {
+	/*
+	 * Address ordered first fit free list over [0, capacity). Neighbouring free
+	 * ranges are merged back together on free. Shared by the device memory
+	 * allocator and the geometry pool.
+	 */
+	class RangeAllocator
+	{
+		public:
+			RangeAllocator() = default;
+			RangeAllocator(VkDeviceSize capacity) { reset(capacity); }
+
+			void reset(VkDeviceSize capacity);
+			bool allocate(VkDeviceSize size, VkDeviceSize alignment, VkDeviceSize& offset);
+			void free(VkDeviceSize offset, VkDeviceSize size);
+
+			VkDeviceSize getCapacity() const { return capacity; }
+			VkDeviceSize getUsed() const { return used; }
+			bool isEmpty() const { return used == 0; }
+		private:
+			std::map<VkDeviceSize, VkDeviceSize> freeRanges; // offset -> size
+			VkDeviceSize capacity = 0;
+			VkDeviceSize used = 0;
+	};
+}
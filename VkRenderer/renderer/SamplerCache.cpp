@@ -0,0 +1,65 @@
+#include "SamplerCache.hpp"
+
+#include "VulkanUtils.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace VkRenderer {
+	SamplerCache::SamplerCache(VkDevice device, const VkPhysicalDeviceLimits& limits)
+		: device{ device }, maxAnisotropy{ limits.maxSamplerAnisotropy }
+	{}
+
+	SamplerCache::~SamplerCache()
+	{
+		for (auto& [state, sampler] : samplers)
+			vkDestroySampler(device, sampler, nullptr);
+	}
+
+	VkSampler SamplerCache::get(const SamplerState& state)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (auto it = samplers.find(state); it != samplers.end())
+			return it->second;
+
+		VkSamplerCreateInfo samplerInfo{};
+		samplerInfo.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO;
+		samplerInfo.magFilter = state.magFilter;
+		samplerInfo.minFilter = state.minFilter;
+		samplerInfo.addressModeU = state.addressMode;
+		samplerInfo.addressModeV = state.addressMode;
+		samplerInfo.addressModeW = state.addressMode;
+		samplerInfo.anisotropyEnable = state.maxAnisotropy > 0.0f ? VK_TRUE : VK_FALSE;
+		samplerInfo.maxAnisotropy = std::min(state.maxAnisotropy, maxAnisotropy);
+		samplerInfo.borderColor = state.borderColor;
+		samplerInfo.unnormalizedCoordinates = VK_FALSE;
+		samplerInfo.compareEnable = state.compareEnable;
+		samplerInfo.compareOp = state.compareOp;
+		samplerInfo.mipmapMode = state.mipmapMode;
+		samplerInfo.mipLodBias = state.mipLodBias;
+		samplerInfo.minLod = state.minLod;
+		samplerInfo.maxLod = state.maxLod;
+
+		VkSampler sampler;
+		if (vkCreateSampler(device, &samplerInfo, nullptr, &sampler) != VK_SUCCESS)
+			throw std::runtime_error("failed to create image sampler");
+
+		samplers.emplace(state, sampler);
+		return sampler;
+	}
+
+	uint32_t SamplerCache::getSamplerCount() const
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+		return static_cast<uint32_t>(samplers.size());
+	}
+
+	size_t SamplerCache::StateHash::operator()(const SamplerState& state) const
+	{
+		size_t seed = 0;
+		hashCombine(seed, state.magFilter, state.minFilter, state.mipmapMode, state.addressMode, state.borderColor,
+			state.maxAnisotropy, state.mipLodBias, state.minLod, state.maxLod, state.compareEnable, state.compareOp);
+		return seed;
+	}
+}
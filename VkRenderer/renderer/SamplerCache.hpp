@@ -0,0 +1,57 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+
+namespace VkRenderer {
+	// the sampler create info fields that actually vary, address mode is used for u, v and w
+	struct SamplerState {
+		VkFilter magFilter = VK_FILTER_LINEAR;
+		VkFilter minFilter = VK_FILTER_LINEAR;
+		VkSamplerMipmapMode mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
+		VkSamplerAddressMode addressMode = VK_SAMPLER_ADDRESS_MODE_REPEAT;
+		VkBorderColor borderColor = VK_BORDER_COLOR_FLOAT_OPAQUE_WHITE;
+		float maxAnisotropy = 0.0f; // 0 turns anisotropy off, anything above the device limit is clamped to it
+		float mipLodBias = 0.0f;
+		float minLod = 0.0f;
+		float maxLod = VK_LOD_CLAMP_NONE; // the image view already stops at the levels the image has
+		VkBool32 compareEnable = VK_FALSE;
+		VkCompareOp compareOp = VK_COMPARE_OP_ALWAYS;
+
+		bool operator==(const SamplerState&) const = default;
+	};
+
+	/*
+	 * Samplers shared by everything with the same state. Textures used to create one each, identical apart from
+	 * maxLod, which runs into maxSamplerAllocationCount long before the bindless table is full. There are only a
+	 * handful of distinct states, so samplers are never freed before the cache goes.
+	 */
+	class SamplerCache
+	{
+		public:
+			SamplerCache(VkDevice device, const VkPhysicalDeviceLimits& limits);
+			~SamplerCache();
+
+			SamplerCache(const SamplerCache&) = delete;
+			SamplerCache& operator=(const SamplerCache&) = delete;
+
+			// safe from any thread, creates the sampler the first time a state is asked for
+			VkSampler get(const SamplerState& state);
+
+			uint32_t getSamplerCount() const;
+		private:
+			struct StateHash {
+				size_t operator()(const SamplerState& state) const;
+			};
+
+			VkDevice device;
+			float maxAnisotropy;
+
+			mutable std::mutex mutex;
+			std::unordered_map<SamplerState, VkSampler, StateHash> samplers;
+	};
+}
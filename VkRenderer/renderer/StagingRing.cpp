@@ -0,0 +1,94 @@
+#include "StagingRing.hpp"
+#include "VulkanDevice.hpp"
+
+#include <stdexcept>
+
+namespace VkRenderer {
+	StagingRing::StagingRing(VulkanDevice& device, VkDeviceSize capacity)
+		: device{ device }, capacity{ capacity }
+	{
+		device.createBuffer(
+			capacity,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			buffer,
+			memory
+		);
+
+		if (!memory.mapped)
+			throw std::runtime_error("failed to map staging ring!");
+	}
+
+	StagingRing::~StagingRing()
+	{
+		device.destroyBuffer(buffer, memory);
+	}
+
+	bool StagingRing::allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t ticket, StagingAllocation& allocation)
+	{
+		if (size > capacity)
+			return false;
+
+		if (alignment == 0)
+			alignment = 1;
+
+		VkDeviceSize begin;
+
+		if (regions.empty()) {
+			begin = 0;
+		}
+		else {
+			VkDeviceSize tail = regions.front().begin;
+			VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+
+			// head == tail only ever means full here, so the wrapped cases stay strictly below the tail
+			if (head >= tail) {
+				if (aligned + size <= capacity)
+					begin = aligned;
+				else if (size < tail)
+					begin = 0;
+				else
+					return false;
+			}
+			else {
+				if (aligned + size < tail)
+					begin = aligned;
+				else
+					return false;
+			}
+		}
+
+		VkDeviceSize end = begin + size;
+
+		if (!regions.empty() && regions.back().ticket == ticket && regions.back().end <= begin)
+			regions.back().end = end;
+		else
+			regions.push_back({ begin, end, ticket });
+
+		head = end;
+
+		allocation.buffer = buffer;
+		allocation.offset = begin;
+		allocation.size = size;
+		allocation.data = static_cast<char*>(memory.mapped) + begin;
+		return true;
+	}
+
+	void StagingRing::release(uint64_t completedTicket)
+	{
+		while (!regions.empty() && regions.front().ticket <= completedTicket)
+			regions.pop_front();
+
+		if (regions.empty())
+			head = 0;
+	}
+
+	VkDeviceSize StagingRing::getUsed() const
+	{
+		if (regions.empty())
+			return 0;
+
+		VkDeviceSize tail = regions.front().begin;
+		return head >= tail ? head - tail : capacity - tail + head;
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "VulkanAllocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <deque>
+
+namespace VkRenderer {
+	class VulkanDevice;
+
+	struct StagingAllocation {
+		VkBuffer buffer = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* data = nullptr; // host pointer already at offset
+	};
+
+	/*
+	 * One persistently mapped host buffer that every upload stages through. Space is handed out
+	 * front to back and tagged with the upload ticket that reads it, release() gives it back once
+	 * that ticket completed. When the end is reached it wraps around to the start.
+	 */
+	class StagingRing
+	{
+		public:
+			StagingRing(VulkanDevice& device, VkDeviceSize capacity);
+			~StagingRing();
+
+			StagingRing(const StagingRing&) = delete;
+			StagingRing& operator=(const StagingRing&) = delete;
+
+			// false when there is no contiguous room until older tickets complete
+			bool allocate(VkDeviceSize size, VkDeviceSize alignment, uint64_t ticket, StagingAllocation& allocation);
+			void release(uint64_t completedTicket);
+
+			bool isEmpty() const { return regions.empty(); }
+			uint64_t oldestTicket() const { return regions.front().ticket; }
+
+			VkDeviceSize getCapacity() const { return capacity; }
+			VkDeviceSize getUsed() const;
+		private:
+			struct Region {
+				VkDeviceSize begin;
+				VkDeviceSize end;
+				uint64_t ticket;
+			};
+
+			VulkanDevice& device;
+
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VulkanAllocation memory{};
+			VkDeviceSize capacity;
+
+			VkDeviceSize head = 0;
+			std::deque<Region> regions;
+	};
+}
@@ -0,0 +1,474 @@
+#include "UploadContext.hpp"
+#include "VulkanDevice.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+namespace VkRenderer {
+	UploadContext::UploadContext(VulkanDevice& device, VkDeviceSize stagingCapacity) : device{ device }
+	{
+		stagingRing = std::make_unique<StagingRing>(device, stagingCapacity);
+		dedicatedTransfer = device.hasDedicatedTransferQueue();
+
+		VkCommandPoolCreateInfo poolInfo{};
+		poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+		poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+		poolInfo.queueFamilyIndex = device.getTransferQueueFamily();
+
+		if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &commandPool) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload command pool!");
+
+		if (dedicatedTransfer) {
+			poolInfo.queueFamilyIndex = device.getGraphicsQueueFamily();
+
+			if (vkCreateCommandPool(device.device(), &poolInfo, nullptr, &graphicsCommandPool) != VK_SUCCESS)
+				throw std::runtime_error("failed to create upload command pool!");
+
+			transferSemaphore = createTimelineSemaphore();
+		}
+
+		if (device.supportsTimelineSemaphore)
+			readySemaphore = createTimelineSemaphore();
+	}
+
+	VkSemaphore UploadContext::createTimelineSemaphore()
+	{
+		VkSemaphoreTypeCreateInfo typeInfo{};
+		typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+		typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+		typeInfo.initialValue = 0;
+
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		semaphoreInfo.pNext = &typeInfo;
+
+		VkSemaphore semaphore;
+		if (vkCreateSemaphore(device.device(), &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+			throw std::runtime_error("failed to create upload timeline semaphore!");
+
+		return semaphore;
+	}
+
+	UploadContext::~UploadContext()
+	{
+		// whatever is still recording may point at resources that are already gone, so it never gets submitted
+		if (recording) {
+			vkEndCommandBuffer(recording->commandBuffer);
+			if (dedicatedTransfer)
+				vkEndCommandBuffer(recording->graphicsCommandBuffer);
+			freeBatches.push_back(std::move(recording));
+		}
+
+		for (auto& batch : inFlight) {
+			vkWaitForFences(device.device(), 1, &batch->fence, VK_TRUE, UINT64_MAX);
+			retire(*batch);
+			freeBatches.push_back(std::move(batch));
+		}
+		inFlight.clear();
+
+		for (auto& batch : freeBatches)
+			vkDestroyFence(device.device(), batch->fence, nullptr);
+
+		stagingRing.reset();
+
+		if (transferSemaphore != VK_NULL_HANDLE)
+			vkDestroySemaphore(device.device(), transferSemaphore, nullptr);
+		if (readySemaphore != VK_NULL_HANDLE)
+			vkDestroySemaphore(device.device(), readySemaphore, nullptr);
+
+		if (graphicsCommandPool != VK_NULL_HANDLE)
+			vkDestroyCommandPool(device.device(), graphicsCommandPool, nullptr);
+		vkDestroyCommandPool(device.device(), commandPool, nullptr);
+	}
+
+	void UploadContext::beginBatch()
+	{
+		if (!freeBatches.empty()) {
+			recording = std::move(freeBatches.back());
+			freeBatches.pop_back();
+
+			vkResetCommandBuffer(recording->commandBuffer, 0);
+			if (dedicatedTransfer)
+				vkResetCommandBuffer(recording->graphicsCommandBuffer, 0);
+		}
+		else {
+			recording = std::make_unique<Batch>();
+
+			VkCommandBufferAllocateInfo allocInfo{};
+			allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+			allocInfo.commandPool = commandPool;
+			allocInfo.commandBufferCount = 1;
+
+			if (vkAllocateCommandBuffers(device.device(), &allocInfo, &recording->commandBuffer) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate upload command buffer!");
+
+			recording->graphicsCommandBuffer = recording->commandBuffer;
+			if (dedicatedTransfer) {
+				allocInfo.commandPool = graphicsCommandPool;
+
+				if (vkAllocateCommandBuffers(device.device(), &allocInfo, &recording->graphicsCommandBuffer) != VK_SUCCESS)
+					throw std::runtime_error("failed to allocate upload command buffer!");
+			}
+
+			VkFenceCreateInfo fenceInfo{};
+			fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+			if (vkCreateFence(device.device(), &fenceInfo, nullptr, &recording->fence) != VK_SUCCESS)
+				throw std::runtime_error("failed to create upload fence!");
+		}
+
+		recording->ticket = nextTicket;
+		recording->acquireStages = 0;
+
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+
+		vkBeginCommandBuffer(recording->commandBuffer, &beginInfo);
+		if (dedicatedTransfer)
+			vkBeginCommandBuffer(recording->graphicsCommandBuffer, &beginInfo);
+	}
+
+	VkCommandBuffer UploadContext::getCommandBuffer()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!recording)
+			beginBatch();
+
+		return recording->commandBuffer;
+	}
+
+	VkCommandBuffer UploadContext::getGraphicsCommandBuffer()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!recording)
+			beginBatch();
+
+		return recording->graphicsCommandBuffer;
+	}
+
+	void UploadContext::releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		VkCommandBuffer transferCommands = getCommandBuffer();
+		VkCommandBuffer graphicsCommands = getGraphicsCommandBuffer();
+
+		VkBufferMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dstAccess;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.buffer = buffer;
+		barrier.offset = offset;
+		barrier.size = size;
+
+		if (!dedicatedTransfer) {
+			vkCmdPipelineBarrier(transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			return;
+		}
+
+		barrier.srcQueueFamilyIndex = device.getTransferQueueFamily();
+		barrier.dstQueueFamilyIndex = device.getGraphicsQueueFamily();
+
+		// release half, dst access is ignored on this side
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		// acquire half, src access is ignored on this side. it starts at dstStage, which the transfer semaphore is waited on at
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(graphicsCommands, dstStage, dstStage, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		recording->acquireStages |= dstStage;
+	}
+
+	void UploadContext::releaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+	{
+		VkCommandBuffer transferCommands = getCommandBuffer();
+		VkCommandBuffer graphicsCommands = getGraphicsCommandBuffer();
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = dstAccess;
+		barrier.oldLayout = oldLayout;
+		barrier.newLayout = newLayout;
+		barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+		barrier.image = image;
+		barrier.subresourceRange = range;
+
+		if (!dedicatedTransfer) {
+			vkCmdPipelineBarrier(transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+			return;
+		}
+
+		barrier.srcQueueFamilyIndex = device.getTransferQueueFamily();
+		barrier.dstQueueFamilyIndex = device.getGraphicsQueueFamily();
+
+		// both halves have to carry the same layout transition
+		barrier.dstAccessMask = 0;
+		vkCmdPipelineBarrier(transferCommands, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = dstAccess;
+		vkCmdPipelineBarrier(graphicsCommands, dstStage, dstStage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		recording->acquireStages |= dstStage;
+	}
+
+	StagingAllocation UploadContext::stage(VkDeviceSize size, VkDeviceSize alignment)
+	{
+		// would never fit, give it a buffer of its own that dies with the batch
+		if (size > stagingRing->getCapacity() / 2)
+			return stageDedicated(size);
+
+		for (;;) {
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+
+				if (!recording)
+					beginBatch();
+
+				StagingAllocation allocation{};
+				if (stagingRing->allocate(size, alignment, recording->ticket, allocation))
+					return allocation;
+			}
+
+			// ring is full, wait for the oldest batch still reading from it (submits the current one if it is that)
+			UploadTicket oldest;
+			{
+				std::lock_guard<std::mutex> lock{ mutex };
+				oldest = stagingRing->oldestTicket();
+			}
+
+			wait(oldest);
+		}
+	}
+
+	StagingAllocation UploadContext::stageDedicated(VkDeviceSize size)
+	{
+		struct DedicatedStaging {
+			VulkanDevice& device;
+			VkBuffer buffer = VK_NULL_HANDLE;
+			VulkanAllocation memory{};
+
+			DedicatedStaging(VulkanDevice& device) : device{ device } {}
+			~DedicatedStaging() { device.destroyBuffer(buffer, memory); }
+		};
+
+		auto staging = std::make_shared<DedicatedStaging>(device);
+		device.createBuffer(
+			size,
+			VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+			VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+			staging->buffer,
+			staging->memory
+		);
+
+		StagingAllocation allocation{};
+		allocation.buffer = staging->buffer;
+		allocation.offset = 0;
+		allocation.size = size;
+		allocation.data = staging->memory.mapped;
+
+		retain(staging);
+		return allocation;
+	}
+
+	void UploadContext::retain(std::shared_ptr<void> resource)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!recording)
+			beginBatch();
+
+		recording->resources.push_back(std::move(resource));
+	}
+
+	void UploadContext::onComplete(std::function<void()> callback)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!recording)
+			beginBatch();
+
+		recording->callbacks.push_back(std::move(callback));
+	}
+
+	UploadTicket UploadContext::submit()
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (!recording)
+			return nextTicket - 1;
+
+		UploadTicket ticket = recording->ticket;
+
+		// the release/acquire barriers already made the copies visible where they're read, nothing to add here
+		vkEndCommandBuffer(recording->commandBuffer);
+		if (dedicatedTransfer)
+			vkEndCommandBuffer(recording->graphicsCommandBuffer);
+
+		vkResetFences(device.device(), 1, &recording->fence);
+
+		if (dedicatedTransfer) {
+			VkTimelineSemaphoreSubmitInfo transferTimeline{};
+			transferTimeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+			transferTimeline.signalSemaphoreValueCount = 1;
+			transferTimeline.pSignalSemaphoreValues = &ticket;
+
+			VkSubmitInfo transferSubmit{};
+			transferSubmit.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+			transferSubmit.pNext = &transferTimeline;
+			transferSubmit.commandBufferCount = 1;
+			transferSubmit.pCommandBuffers = &recording->commandBuffer;
+			transferSubmit.signalSemaphoreCount = 1;
+			transferSubmit.pSignalSemaphores = &transferSemaphore;
+
+			if (vkQueueSubmit(device.transferQueue(), 1, &transferSubmit, VK_NULL_HANDLE) != VK_SUCCESS)
+				throw std::runtime_error("failed to submit upload command buffer!");
+		}
+
+		// only the acquire barriers read what the transfer half wrote, the rest of the graphics half can start right away
+		VkPipelineStageFlags waitStage = recording->acquireStages != 0 ? recording->acquireStages : VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
+
+		VkTimelineSemaphoreSubmitInfo graphicsTimeline{};
+		graphicsTimeline.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+		graphicsTimeline.waitSemaphoreValueCount = dedicatedTransfer ? 1 : 0;
+		graphicsTimeline.pWaitSemaphoreValues = &ticket;
+		graphicsTimeline.signalSemaphoreValueCount = 1;
+		graphicsTimeline.pSignalSemaphoreValues = &ticket;
+
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.commandBufferCount = 1;
+		submitInfo.pCommandBuffers = &recording->graphicsCommandBuffer;
+
+		if (dedicatedTransfer) {
+			submitInfo.waitSemaphoreCount = 1;
+			submitInfo.pWaitSemaphores = &transferSemaphore;
+			submitInfo.pWaitDstStageMask = &waitStage;
+		}
+
+		if (readySemaphore != VK_NULL_HANDLE) {
+			submitInfo.pNext = &graphicsTimeline;
+			submitInfo.signalSemaphoreCount = 1;
+			submitInfo.pSignalSemaphores = &readySemaphore;
+		}
+
+		if (vkQueueSubmit(device.graphicsQueue(), 1, &submitInfo, recording->fence) != VK_SUCCESS)
+			throw std::runtime_error("failed to submit upload command buffer!");
+
+		inFlight.push_back(std::move(recording));
+		nextTicket++;
+
+		return ticket;
+	}
+
+	void UploadContext::requireForFrame(UploadTicket ticket)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (ticket > completedTicket)
+			frameWait = std::max(frameWait, ticket);
+	}
+
+	UploadTicket UploadContext::takeFrameWait()
+	{
+		std::unique_lock<std::mutex> lock{ mutex };
+		UploadTicket ticket = std::exchange(frameWait, 0);
+		bool pending = recording && ticket >= recording->ticket;
+		lock.unlock();
+
+		// the batch has to be on the queue before a frame can wait on it
+		if (pending)
+			submit();
+
+		lock.lock();
+		return ticket > completedTicket ? ticket : 0;
+	}
+
+	bool UploadContext::isComplete(UploadTicket ticket)
+	{
+		collect();
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		// nothing got recorded under the current ticket yet
+		if (!recording && ticket >= nextTicket)
+			return true;
+
+		return ticket <= completedTicket;
+	}
+
+	void UploadContext::wait(UploadTicket ticket)
+	{
+		{
+			std::unique_lock<std::mutex> lock{ mutex };
+			bool pending = recording && ticket >= recording->ticket;
+			lock.unlock();
+
+			if (pending)
+				submit();
+		}
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+
+			for (auto& batch : inFlight) {
+				if (batch->ticket > ticket)
+					break;
+
+				vkWaitForFences(device.device(), 1, &batch->fence, VK_TRUE, UINT64_MAX);
+			}
+		}
+
+		collect();
+	}
+
+	void UploadContext::collect()
+	{
+		std::vector<std::unique_ptr<Batch>> finished;
+
+		{
+			std::lock_guard<std::mutex> lock{ mutex };
+
+			// the fence sits on the graphics half, which always runs after the transfer half and in submission order
+			size_t count = 0;
+			while (count < inFlight.size() && vkGetFenceStatus(device.device(), inFlight[count]->fence) == VK_SUCCESS) {
+				completedTicket = inFlight[count]->ticket;
+				count++;
+			}
+
+			for (size_t i = 0; i < count; i++)
+				finished.push_back(std::move(inFlight[i]));
+
+			inFlight.erase(inFlight.begin(), inFlight.begin() + count);
+			stagingRing->release(completedTicket);
+		}
+
+		// callbacks may record new uploads or free memory, run them outside the lock
+		for (auto& batch : finished)
+			retire(*batch);
+
+		std::lock_guard<std::mutex> lock{ mutex };
+		for (auto& batch : finished)
+			freeBatches.push_back(std::move(batch));
+	}
+
+	void UploadContext::retire(Batch& batch)
+	{
+		for (auto& callback : batch.callbacks)
+			callback();
+
+		batch.callbacks.clear();
+		batch.resources.clear();
+	}
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+#include "StagingRing.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VkRenderer {
+	class VulkanDevice;
+
+	using UploadTicket = uint64_t;
+
+	/*
+	 * Batches buffer/image uploads into one command buffer instead of a submit + vkQueueWaitIdle per copy.
+	 * Everything recorded between two submit() calls shares a ticket, callers poll isComplete() or
+	 * wait() on it. Source data goes through stage(), which hands out staging ring memory that stays
+	 * reserved until the ticket completes. Anything else the copies read from can be handed to retain().
+	 *
+	 * When the device has a dedicated transfer queue the copies run there. Work that needs the graphics
+	 * queue (blits for mips) goes into getGraphicsCommandBuffer(), which waits on the transfer submit
+	 * through a timeline semaphore. Resources cross over with releaseBuffer()/releaseImage(), their barriers
+	 * are what makes the copies visible to later submits. A frame that draws something from a batch that
+	 * hasn't completed yet names its ticket with requireForFrame(), the frame's submit then waits on
+	 * getReadySemaphore() at takeFrameWait(). Frames that don't are never held up by uploads.
+	 *
+	 * Recording isn't thread safe, only record from the thread that drives the world.
+	 */
+	class UploadContext
+	{
+		public:
+			static constexpr VkDeviceSize DEFAULT_STAGING_CAPACITY = 64ull * 1024 * 1024;
+
+			UploadContext(VulkanDevice& device, VkDeviceSize stagingCapacity = DEFAULT_STAGING_CAPACITY);
+			~UploadContext();
+
+			UploadContext(const UploadContext&) = delete;
+			UploadContext& operator=(const UploadContext&) = delete;
+
+			// command buffer of the batch being recorded, begins a new batch when there is none.
+			// runs on the transfer queue, only record copies and transfer stage barriers into it
+			VkCommandBuffer getCommandBuffer();
+			// runs on the graphics queue after everything in getCommandBuffer(), same buffer without a transfer queue
+			VkCommandBuffer getGraphicsCommandBuffer();
+
+			// hand a freshly written range/image over to the graphics queue, a plain barrier when it's the same family
+			void releaseBuffer(VkBuffer buffer, VkDeviceSize offset, VkDeviceSize size, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+			void releaseImage(VkImage image, const VkImageSubresourceRange& range, VkImageLayout oldLayout, VkImageLayout newLayout, VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+
+			// write the source data into the returned pointer, then record the copy before the next submit()
+			StagingAllocation stage(VkDeviceSize size, VkDeviceSize alignment = 16);
+
+			void retain(std::shared_ptr<void> resource);
+			void onComplete(std::function<void()> callback);
+
+			// ticket the currently recorded commands will complete with
+			UploadTicket currentTicket() const { return nextTicket; }
+			bool isRecording() const { return recording != nullptr; }
+
+			UploadTicket submit();
+			bool isComplete(UploadTicket ticket);
+			void wait(UploadTicket ticket);
+			void waitIdle() { wait(nextTicket); }
+
+			// timeline semaphore the graphics side of each batch signals with its ticket, null without timeline support
+			VkSemaphore getReadySemaphore() const { return readySemaphore; }
+
+			// the frame being recorded reads what this ticket uploads, ignored once it completed
+			void requireForFrame(UploadTicket ticket);
+			// value the frame's submit waits on getReadySemaphore() for, 0 when it doesn't need to. resets for the next frame
+			UploadTicket takeFrameWait();
+
+			// releases resources and runs callbacks of finished batches
+			void collect();
+		private:
+			struct Batch {
+				VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+				VkCommandBuffer graphicsCommandBuffer = VK_NULL_HANDLE;
+				VkFence fence = VK_NULL_HANDLE;
+				UploadTicket ticket = 0;
+				VkPipelineStageFlags acquireStages = 0; // where the graphics half first touches what the transfer half wrote
+				std::vector<std::shared_ptr<void>> resources;
+				std::vector<std::function<void()>> callbacks;
+			};
+
+			void beginBatch();
+			VkSemaphore createTimelineSemaphore();
+			void retire(Batch& batch);
+			StagingAllocation stageDedicated(VkDeviceSize size);
+
+			VulkanDevice& device;
+			VkCommandPool commandPool = VK_NULL_HANDLE;
+			VkCommandPool graphicsCommandPool = VK_NULL_HANDLE;
+			bool dedicatedTransfer = false;
+
+			VkSemaphore transferSemaphore = VK_NULL_HANDLE;
+			VkSemaphore readySemaphore = VK_NULL_HANDLE;
+			UploadTicket frameWait = 0;
+
+			std::unique_ptr<StagingRing> stagingRing;
+
+			std::mutex mutex;
+			std::unique_ptr<Batch> recording;
+			std::vector<std::unique_ptr<Batch>> inFlight;
+			std::vector<std::unique_ptr<Batch>> freeBatches;
+
+			UploadTicket nextTicket = 1;
+			UploadTicket completedTicket = 0;
+	};
+}
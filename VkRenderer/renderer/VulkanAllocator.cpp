@@ -0,0 +1,246 @@
+#include "VulkanAllocator.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <stdexcept>
+
+namespace VkRenderer {
+	VulkanAllocator::VulkanAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, VkDeviceSize blockSize)
+		: device{ device }, memoryProperties{ memoryProperties }, blockSize{ blockSize }, nonCoherentAtomSize{ std::max<VkDeviceSize>(limits.nonCoherentAtomSize, 1) }
+	{
+		dedicatedStats.resize(memoryProperties.memoryTypeCount);
+	}
+
+	VulkanAllocator::~VulkanAllocator()
+	{
+		for (auto& block : blocks) {
+			assert(block->allocationCount == 0 && "Allocator destroyed with live allocations");
+
+			if (block->mapped)
+				vkUnmapMemory(device, block->memory);
+			vkFreeMemory(device, block->memory, nullptr);
+		}
+	}
+
+	uint32_t VulkanAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+	{
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if ((typeFilter & (1 << i)) &&
+				(memoryProperties.memoryTypes[i].propertyFlags & properties) == properties) {
+				return i;
+			}
+		}
+
+		throw std::runtime_error("failed to find suitable memory type!");
+	}
+
+	bool VulkanAllocator::isHostVisible(uint32_t memoryType) const
+	{
+		return memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+	}
+
+	bool VulkanAllocator::isCoherent(uint32_t memoryType) const
+	{
+		return memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
+
+	VkResult VulkanAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory& memory, void** mapped)
+	{
+		VkMemoryAllocateInfo allocInfo{};
+		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+		allocInfo.allocationSize = size;
+		allocInfo.memoryTypeIndex = memoryType;
+
+		VkResult result = vkAllocateMemory(device, &allocInfo, nullptr, &memory);
+		if (result != VK_SUCCESS)
+			return result;
+
+		*mapped = nullptr;
+		if (isHostVisible(memoryType)) {
+			result = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+			if (result != VK_SUCCESS) {
+				vkFreeMemory(device, memory, nullptr);
+				memory = VK_NULL_HANDLE;
+			}
+		}
+
+		return result;
+	}
+
+	VulkanAllocation VulkanAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		VulkanAllocation allocation{};
+		allocation.memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+
+		VkDeviceSize alignment = requirements.alignment;
+		VkDeviceSize size = requirements.size;
+
+		// keep flushes of non coherent memory from touching the neighbours
+		if (isHostVisible(allocation.memoryType) && !isCoherent(allocation.memoryType)) {
+			alignment = std::max(alignment, nonCoherentAtomSize);
+			size = (size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+		}
+
+		allocation.size = size;
+
+		// anything bigger than half a block would just waste the rest of it
+		if (dedicated || size > blockSize / 2) {
+			void* mapped = nullptr;
+			if (allocateMemory(size, allocation.memoryType, allocation.memory, &mapped) != VK_SUCCESS)
+				throw std::runtime_error("failed to allocate dedicated memory!");
+
+			allocation.mapped = mapped;
+
+			dedicatedStats[allocation.memoryType].bytes += size;
+			dedicatedStats[allocation.memoryType].count++;
+			return allocation;
+		}
+
+		for (auto& block : blocks) {
+			if (block->memoryType != allocation.memoryType || block->linear != linear)
+				continue;
+
+			if (block->ranges.allocate(size, alignment, allocation.offset)) {
+				block->allocationCount++;
+				allocation.memory = block->memory;
+				allocation.block = block.get();
+				allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+				return allocation;
+			}
+		}
+
+		auto block = std::make_unique<Block>();
+		block->memoryType = allocation.memoryType;
+		block->linear = linear;
+		block->ranges.reset(blockSize);
+
+		if (allocateMemory(blockSize, allocation.memoryType, block->memory, &block->mapped) != VK_SUCCESS)
+			throw std::runtime_error("failed to allocate memory block!");
+
+		if (!block->ranges.allocate(size, alignment, allocation.offset))
+			throw std::runtime_error("allocation does not fit in a fresh memory block!");
+
+		block->allocationCount++;
+		allocation.memory = block->memory;
+		allocation.block = block.get();
+		allocation.mapped = block->mapped ? static_cast<char*>(block->mapped) + allocation.offset : nullptr;
+
+		blocks.push_back(std::move(block));
+		return allocation;
+	}
+
+	void VulkanAllocator::free(VulkanAllocation& allocation)
+	{
+		if (!allocation.isValid())
+			return;
+
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		if (allocation.isDedicated()) {
+			if (allocation.mapped)
+				vkUnmapMemory(device, allocation.memory);
+			vkFreeMemory(device, allocation.memory, nullptr);
+
+			dedicatedStats[allocation.memoryType].bytes -= allocation.size;
+			dedicatedStats[allocation.memoryType].count--;
+
+			allocation = {};
+			return;
+		}
+
+		Block* block = static_cast<Block*>(allocation.block);
+		block->ranges.free(allocation.offset, allocation.size);
+		block->allocationCount--;
+
+		allocation = {};
+
+		if (block->allocationCount != 0)
+			return;
+
+		// keep one empty block around per type, staging buffers come and go constantly during loading
+		bool hasOtherEmpty = std::any_of(blocks.begin(), blocks.end(), [&](const std::unique_ptr<Block>& other) {
+			return other.get() != block && other->allocationCount == 0 &&
+				other->memoryType == block->memoryType && other->linear == block->linear;
+		});
+
+		if (!hasOtherEmpty)
+			return;
+
+		if (block->mapped)
+			vkUnmapMemory(device, block->memory);
+		vkFreeMemory(device, block->memory, nullptr);
+
+		blocks.erase(std::find_if(blocks.begin(), blocks.end(), [&](const std::unique_ptr<Block>& other) {
+			return other.get() == block;
+		}));
+	}
+
+	VkMappedMemoryRange VulkanAllocator::mappedRange(const VulkanAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const
+	{
+		if (size == VK_WHOLE_SIZE)
+			size = allocation.size - offset;
+
+		// ranges have to be multiples of nonCoherentAtomSize, allocations in non coherent memory are already aligned to it
+		VkDeviceSize begin = (allocation.offset + offset) / nonCoherentAtomSize * nonCoherentAtomSize;
+		VkDeviceSize end = (allocation.offset + offset + size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+		end = std::min(end, allocation.offset + allocation.size);
+
+		VkMappedMemoryRange range{};
+		range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+		range.memory = allocation.memory;
+		range.offset = begin;
+		range.size = end - begin;
+		return range;
+	}
+
+	VkResult VulkanAllocator::flush(const VulkanAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (isCoherent(allocation.memoryType))
+			return VK_SUCCESS;
+
+		VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+		return vkFlushMappedMemoryRanges(device, 1, &range);
+	}
+
+	VkResult VulkanAllocator::invalidate(const VulkanAllocation& allocation, VkDeviceSize size, VkDeviceSize offset)
+	{
+		if (isCoherent(allocation.memoryType))
+			return VK_SUCCESS;
+
+		VkMappedMemoryRange range = mappedRange(allocation, size, offset);
+		return vkInvalidateMappedMemoryRanges(device, 1, &range);
+	}
+
+	VulkanHeapStats VulkanAllocator::getHeapStats(uint32_t heapIndex)
+	{
+		std::lock_guard<std::mutex> lock{ mutex };
+
+		VulkanHeapStats stats{};
+		stats.heapSize = memoryProperties.memoryHeaps[heapIndex].size;
+		stats.flags = memoryProperties.memoryHeaps[heapIndex].flags;
+
+		for (auto& block : blocks) {
+			if (memoryProperties.memoryTypes[block->memoryType].heapIndex != heapIndex)
+				continue;
+
+			stats.blockCount++;
+			stats.reservedBytes += block->ranges.getCapacity();
+			stats.usedBytes += block->ranges.getUsed();
+			stats.allocationCount += block->allocationCount;
+		}
+
+		for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; i++) {
+			if (memoryProperties.memoryTypes[i].heapIndex != heapIndex)
+				continue;
+
+			stats.reservedBytes += dedicatedStats[i].bytes;
+			stats.usedBytes += dedicatedStats[i].bytes;
+			stats.allocationCount += dedicatedStats[i].count;
+			stats.dedicatedCount += dedicatedStats[i].count;
+		}
+
+		return stats;
+	}
+}
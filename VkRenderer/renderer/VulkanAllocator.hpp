@@ -0,0 +1,92 @@
+#pragma once
+
+#include "RangeAllocator.hpp"
+
+#include <vulkan/vulkan.h>
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace VkRenderer {
+	// A sub range of a VkDeviceMemory block (or a whole dedicated allocation)
+	struct VulkanAllocation {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		VkDeviceSize offset = 0;
+		VkDeviceSize size = 0;
+		void* mapped = nullptr; // already points at offset, null when the memory isn't host visible
+		uint32_t memoryType = 0;
+		void* block = nullptr; // owning block, null for dedicated allocations
+
+		bool isValid() const { return memory != VK_NULL_HANDLE; }
+		bool isDedicated() const { return block == nullptr; }
+	};
+
+	struct VulkanHeapStats {
+		VkDeviceSize heapSize = 0;
+		VkMemoryHeapFlags flags = 0;
+		VkDeviceSize reservedBytes = 0; // blocks + dedicated allocations
+		VkDeviceSize usedBytes = 0;
+		uint32_t blockCount = 0;
+		uint32_t allocationCount = 0;
+		uint32_t dedicatedCount = 0;
+	};
+
+	/*
+	 * Allocates big blocks per memory type and sub allocates buffers and images out of them,
+	 * so we stay far away from maxMemoryAllocationCount. Linear resources (buffers, linear images)
+	 * and optimal images never share a block which keeps bufferImageGranularity out of the picture.
+	 * Host visible blocks are mapped once for their whole lifetime.
+	 */
+	class VulkanAllocator
+	{
+		public:
+			static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = 64ull * 1024 * 1024;
+
+			VulkanAllocator(VkDevice device, const VkPhysicalDeviceMemoryProperties& memoryProperties, const VkPhysicalDeviceLimits& limits, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+			~VulkanAllocator();
+
+			VulkanAllocator(const VulkanAllocator&) = delete;
+			VulkanAllocator& operator=(const VulkanAllocator&) = delete;
+
+			// linear: buffer or linear tiled image, dedicated: force a VkDeviceMemory of its own
+			VulkanAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties, bool linear, bool dedicated = false);
+			void free(VulkanAllocation& allocation);
+
+			// offset and size are relative to the allocation, VK_WHOLE_SIZE means the rest of it
+			VkResult flush(const VulkanAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+			VkResult invalidate(const VulkanAllocation& allocation, VkDeviceSize size = VK_WHOLE_SIZE, VkDeviceSize offset = 0);
+
+			uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+			uint32_t getHeapCount() const { return memoryProperties.memoryHeapCount; }
+			VulkanHeapStats getHeapStats(uint32_t heapIndex);
+		private:
+			struct Block {
+				VkDeviceMemory memory = VK_NULL_HANDLE;
+				void* mapped = nullptr;
+				uint32_t memoryType = 0;
+				bool linear = true;
+				uint32_t allocationCount = 0;
+				RangeAllocator ranges;
+			};
+
+			VkResult allocateMemory(VkDeviceSize size, uint32_t memoryType, VkDeviceMemory& memory, void** mapped);
+			VkMappedMemoryRange mappedRange(const VulkanAllocation& allocation, VkDeviceSize size, VkDeviceSize offset) const;
+			bool isHostVisible(uint32_t memoryType) const;
+			bool isCoherent(uint32_t memoryType) const;
+
+			VkDevice device;
+			VkPhysicalDeviceMemoryProperties memoryProperties;
+			VkDeviceSize blockSize;
+			VkDeviceSize nonCoherentAtomSize;
+
+			std::mutex mutex;
+			std::vector<std::unique_ptr<Block>> blocks;
+
+			struct DedicatedStats {
+				VkDeviceSize bytes = 0;
+				uint32_t count = 0;
+			};
+			std::vector<DedicatedStats> dedicatedStats; // per memory type
+	};
+}
@@ -39,10 +39,19 @@ namespace VkRenderer {
 		pickPhysicalDevice();
 		createLogicalDevice();
 		createCommandPool();
+
+		allocator = std::make_unique<VulkanAllocator>(_device, memoryProperties, properties.limits);
+		uploadContext = std::make_unique<UploadContext>(*this);
+		samplerCache = std::make_unique<SamplerCache>(_device, properties.limits);
 	}
 
 	VulkanDevice::~VulkanDevice()
 	{
+		// releases the staging buffers it still holds, so it goes before the allocator
+		uploadContext.reset();
+		allocator.reset();
+		samplerCache.reset();
+
 		vkDestroyCommandPool(_device, commandPool, nullptr);
 		vkDestroyDevice(_device, nullptr);
 
@@ -66,7 +75,7 @@ namespace VkRenderer {
 		appInfo.applicationVersion = VK_MAKE_VERSION(1, 0, 0);
 		appInfo.pEngineName = "No Engine";
 		appInfo.engineVersion = VK_MAKE_VERSION(1, 0, 0);
-		appInfo.apiVersion = VK_API_VERSION_1_0;
+		appInfo.apiVersion = VK_API_VERSION_1_2; // timeline semaphores
 
 		VkInstanceCreateInfo createInfo{};
 		createInfo.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
@@ -121,6 +130,20 @@ namespace VkRenderer {
 		}
 
 		vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+		vkGetPhysicalDeviceFeatures(physicalDevice, &features);
+
+		if (properties.apiVersion >= VK_API_VERSION_1_2) {
+			VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+			timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+
+			VkPhysicalDeviceFeatures2 features2{};
+			features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+			features2.pNext = &timelineFeatures;
+
+			vkGetPhysicalDeviceFeatures2(physicalDevice, &features2);
+			supportsTimelineSemaphore = timelineFeatures.timelineSemaphore;
+		}
+
 		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
 		uint32_t propertyCount = 0;
 		vkGetPhysicalDeviceQueueFamilyProperties(physicalDevice, &propertyCount, &queueFamilyProperties);
@@ -144,6 +167,13 @@ namespace VkRenderer {
 		std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
 		std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
 
+		// async uploads hand resources back to graphics through a timeline semaphore, no point without one
+		transferQueueFamily = graphicsQueueFamily;
+		if (indices.transferFamily.has_value() && supportsTimelineSemaphore) {
+			transferQueueFamily = indices.transferFamily.value();
+			uniqueQueueFamilies.insert(transferQueueFamily);
+		}
+
 		float queuePriority = 1.0f;
 		for (uint32_t queueFamily : uniqueQueueFamilies) {
 			VkDeviceQueueCreateInfo queueCreateInfo{};
@@ -155,8 +185,12 @@ namespace VkRenderer {
 		}
 
 		VkPhysicalDeviceDescriptorIndexingFeatures indexingFeatures{};
+		VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures{};
+		timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+		timelineFeatures.timelineSemaphore = supportsTimelineSemaphore;
+
 		indexingFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_FEATURES;
-		indexingFeatures.pNext = nullptr;
+		indexingFeatures.pNext = supportsTimelineSemaphore ? &timelineFeatures : nullptr;
 		indexingFeatures.runtimeDescriptorArray = true;
 		indexingFeatures.descriptorBindingPartiallyBound = true;
 		indexingFeatures.shaderStorageBufferArrayNonUniformIndexing = true;
@@ -175,6 +209,9 @@ namespace VkRenderer {
 		deviceFeatures.features.samplerAnisotropy = true;
 		deviceFeatures.features.vertexPipelineStoresAndAtomics = true;
 		deviceFeatures.features.fragmentStoresAndAtomics = true;
+		deviceFeatures.features.multiDrawIndirect = features.multiDrawIndirect;
+		deviceFeatures.features.drawIndirectFirstInstance = features.drawIndirectFirstInstance;
+		deviceFeatures.features.textureCompressionBC = features.textureCompressionBC;
 		deviceFeatures.pNext = &scalarLayoutFeatures;
 
 		VkDeviceCreateInfo createInfo{};
@@ -186,8 +223,18 @@ namespace VkRenderer {
 
 		createInfo.pEnabledFeatures = &deviceFeatures.features;
 
-		createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-		createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+		std::vector<const char*> enabledExtensions = deviceExtensions;
+		for (const char* extension : optionalDeviceExtensions) {
+			if (hasDeviceExtension(physicalDevice, extension))
+				enabledExtensions.push_back(extension);
+		}
+
+		supportsDrawIndirectCount = hasDeviceExtension(physicalDevice, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+		// queried through vkGetPhysicalDeviceMemoryProperties2, which is core from 1.1
+		supportsMemoryBudget = properties.apiVersion >= VK_API_VERSION_1_1 && hasDeviceExtension(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+
+		createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+		createInfo.ppEnabledExtensionNames = enabledExtensions.data();
 
 		if (enableValidationLayers) {
 			createInfo.enabledLayerCount = static_cast<uint32_t>(validationLayers.size());
@@ -203,6 +250,11 @@ namespace VkRenderer {
 
 		vkGetDeviceQueue(_device, indices.graphicsFamily.value(), 0, &_graphicsQueue);
 		vkGetDeviceQueue(_device, indices.presentFamily.value(), 0, &_presentQueue);
+		vkGetDeviceQueue(_device, transferQueueFamily, 0, &_transferQueue);
+
+		if (supportsDrawIndirectCount)
+			cmdDrawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(vkGetDeviceProcAddr(_device, "vkCmdDrawIndexedIndirectCountKHR"));
+		supportsDrawIndirectCount = cmdDrawIndexedIndirectCount != nullptr;
 	}
 
 	void VulkanDevice::createCommandPool()
@@ -339,6 +391,22 @@ namespace VkRenderer {
 		return requiredExtensions.empty();
 	}
 
+	bool VulkanDevice::hasDeviceExtension(VkPhysicalDevice device, const char* extension)
+	{
+		uint32_t extensionCount;
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+
+		std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+		vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+		for (const auto& available : availableExtensions) {
+			if (strcmp(available.extensionName, extension) == 0)
+				return true;
+		}
+
+		return false;
+	}
+
 	QueueFamilyIndices VulkanDevice::findQueueFamilies(VkPhysicalDevice device)
 	{
 		QueueFamilyIndices indices;
@@ -369,6 +437,16 @@ namespace VkRenderer {
 			i++;
 		}
 
+		// prefer a transfer only family, those map to the copy engines
+		for (uint32_t family = 0; family < queueFamilyCount; family++) {
+			VkQueueFlags flags = queueFamilies[family].queueFlags;
+
+			if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) && !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+				indices.transferFamily = family;
+				break;
+			}
+		}
+
 		return indices;
 	}
 
@@ -417,19 +495,11 @@ namespace VkRenderer {
 
 	uint32_t VulkanDevice::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
 	{
-		VkPhysicalDeviceMemoryProperties memProperties;
-		vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-		for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-			if ((typeFilter & (1 << i)) &&
-				(memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-				return i;
-			}
-		}
-
-		throw std::runtime_error("failed to find suitable memory type!");
+		// the allocator has the memory properties we queried at startup
+		return allocator->findMemoryType(typeFilter, properties);
 	}
 
-	void VulkanDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
+	void VulkanDevice::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VulkanAllocation& bufferMemory) {
 		VkBufferCreateInfo bufferInfo{};
 		bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
 		bufferInfo.size = size;
@@ -443,16 +513,17 @@ namespace VkRenderer {
 		VkMemoryRequirements memRequirements;
 		vkGetBufferMemoryRequirements(_device, buffer, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		bufferMemory = allocator->allocate(memRequirements, properties, true);
 
-		if (vkAllocateMemory(_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate vertex buffer memory!");
+		if (vkBindBufferMemory(_device, buffer, bufferMemory.memory, bufferMemory.offset) != VK_SUCCESS) {
+			throw std::runtime_error("failed to bind buffer memory!");
 		}
+	}
 
-		vkBindBufferMemory(_device, buffer, bufferMemory, 0);
+	void VulkanDevice::destroyBuffer(VkBuffer buffer, VulkanAllocation& bufferMemory)
+	{
+		vkDestroyBuffer(_device, buffer, nullptr);
+		allocator->free(bufferMemory);
 	}
 
 	VkCommandBuffer VulkanDevice::beginSingleTimeCommands()
@@ -489,25 +560,23 @@ namespace VkRenderer {
 		vkFreeCommandBuffers(_device, commandPool, 1, &commandBuffer);
 	}
 
-	void VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+	void VulkanDevice::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset, VkDeviceSize dstOffset)
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		VkCommandBuffer commandBuffer = uploadContext->getCommandBuffer();
 
 		VkBufferCopy copyRegion{};
-		copyRegion.srcOffset = 0;  // Optional
-		copyRegion.dstOffset = 0;  // Optional
+		copyRegion.srcOffset = srcOffset;
+		copyRegion.dstOffset = dstOffset;
 		copyRegion.size = size;
 		vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-		endSingleTimeCommands(commandBuffer);
 	}
 
-	void VulkanDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount)
+	void VulkanDevice::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, VkDeviceSize bufferOffset)
 	{
-		VkCommandBuffer commandBuffer = beginSingleTimeCommands();
+		VkCommandBuffer commandBuffer = uploadContext->getCommandBuffer();
 
 		VkBufferImageCopy region{};
-		region.bufferOffset = 0;
+		region.bufferOffset = bufferOffset;
 		region.bufferRowLength = 0;
 		region.bufferImageHeight = 0;
 
@@ -520,10 +589,9 @@ namespace VkRenderer {
 		region.imageExtent = { width, height, 1 };
 
 		vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-		endSingleTimeCommands(commandBuffer);
 	}
 
-	void VulkanDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+	void VulkanDevice::createImageWithInfo(const VkImageCreateInfo& imageInfo, VkMemoryPropertyFlags properties, VkImage& image, VulkanAllocation& imageMemory, bool dedicated)
 	{
 		if (vkCreateImage(_device, &imageInfo, nullptr, &image) != VK_SUCCESS) {
 			throw std::runtime_error("failed to create image!");
@@ -532,17 +600,48 @@ namespace VkRenderer {
 		VkMemoryRequirements memRequirements;
 		vkGetImageMemoryRequirements(_device, image, &memRequirements);
 
-		VkMemoryAllocateInfo allocInfo{};
-		allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-		allocInfo.allocationSize = memRequirements.size;
-		allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+		imageMemory = allocator->allocate(memRequirements, properties, imageInfo.tiling == VK_IMAGE_TILING_LINEAR, dedicated);
 
-		if (vkAllocateMemory(_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS) {
-			throw std::runtime_error("failed to allocate image memory!");
+		if (vkBindImageMemory(_device, image, imageMemory.memory, imageMemory.offset) != VK_SUCCESS) {
+			throw std::runtime_error("failed to bind image memory!");
 		}
+	}
 
-		if (vkBindImageMemory(_device, image, imageMemory, 0) != VK_SUCCESS) {
-			throw std::runtime_error("failed to bind image memory!");
+	void VulkanDevice::destroyImage(VkImage image, VulkanAllocation& imageMemory)
+	{
+		vkDestroyImage(_device, image, nullptr);
+		allocator->free(imageMemory);
+	}
+
+	VulkanMemoryBudget VulkanDevice::getMemoryBudget()
+	{
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+
+		if (supportsMemoryBudget) {
+			VkPhysicalDeviceMemoryProperties2 properties2{};
+			properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+			properties2.pNext = &budgetProperties;
+
+			vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &properties2);
 		}
+
+		VulkanMemoryBudget total{};
+		for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; i++) {
+			if (!(memoryProperties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT))
+				continue;
+
+			if (supportsMemoryBudget) {
+				total.budget += budgetProperties.heapBudget[i];
+				total.usage += budgetProperties.heapUsage[i];
+			}
+			else {
+				// the os and other applications usually hold some of it
+				total.budget += memoryProperties.memoryHeaps[i].size / 10 * 8;
+				total.usage += allocator->getHeapStats(i).reservedBytes;
+			}
+		}
+
+		return total;
 	}
 }
\ No newline at end of file
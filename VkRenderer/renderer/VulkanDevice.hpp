@@ -1,6 +1,9 @@
 #pragma once
 
 #include "VulkanWindow.hpp"
+#include "VulkanAllocator.hpp"
+#include "UploadContext.hpp"
+#include "SamplerCache.hpp"
 
 #include <string>
 #include <vector>
@@ -20,6 +23,7 @@ namespace VkRenderer {
 	struct QueueFamilyIndices {
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		std::optional<uint32_t> transferFamily; // only set for a family without graphics/compute (a dma engine)
 
 		bool graphicsFamilyHasValue = false;
 		bool presentFamilyHasValue = false;
@@ -35,6 +39,18 @@ namespace VkRenderer {
 		VK_EXT_DESCRIPTOR_INDEXING_EXTENSION_NAME
 	};
 
+	// enabled when the device has them, check the matching supports* flag before use
+	const std::vector<const char*> optionalDeviceExtensions = {
+		VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME,
+		VK_EXT_MEMORY_BUDGET_EXTENSION_NAME
+	};
+
+	// summed over the device local heaps
+	struct VulkanMemoryBudget {
+		VkDeviceSize budget = 0; // what this process can have allocated before it risks failing or being paged out
+		VkDeviceSize usage = 0;  // what it has allocated now
+	};
+
 	class VulkanDevice
 	{
 		public:
@@ -59,8 +75,11 @@ namespace VkRenderer {
 			VkSurfaceKHR surface() { return _surface; }
 			VkQueue graphicsQueue() { return _graphicsQueue; }
 			VkQueue presentQueue() { return _presentQueue; }
+			VkQueue transferQueue() { return _transferQueue; }
 			VkInstance getInstance() { return instance; }
 			uint32_t getGraphicsQueueFamily() { return graphicsQueueFamily; }
+			uint32_t getTransferQueueFamily() { return transferQueueFamily; }
+			bool hasDedicatedTransferQueue() { return transferQueueFamily != graphicsQueueFamily; }
 
 			SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 			uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
@@ -74,20 +93,39 @@ namespace VkRenderer {
 				VkBufferUsageFlags usage,
 				VkMemoryPropertyFlags properties,
 				VkBuffer& buffer,
-				VkDeviceMemory& bufferMemory);
+				VulkanAllocation& bufferMemory);
+			void destroyBuffer(VkBuffer buffer, VulkanAllocation& bufferMemory);
 			VkCommandBuffer beginSingleTimeCommands();
 			void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-			void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+
+			// recorded into the upload context (transfer queue when there is one), the source has to stay alive until
+			// the batch completes and the destination still needs a releaseBuffer/releaseImage before graphics uses it
+			void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, VkDeviceSize srcOffset = 0, VkDeviceSize dstOffset = 0);
 			void copyBufferToImage(
-				VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount);
+				VkBuffer buffer, VkImage image, uint32_t width, uint32_t height, uint32_t layerCount, VkDeviceSize bufferOffset = 0);
 
 			void createImageWithInfo(
 				const VkImageCreateInfo& imageInfo,
 				VkMemoryPropertyFlags properties,
 				VkImage& image,
-				VkDeviceMemory& imageMemory);
+				VulkanAllocation& imageMemory,
+				bool dedicated = false);
+			void destroyImage(VkImage image, VulkanAllocation& imageMemory);
+
+			// follows VK_EXT_memory_budget, which knows about other applications and the driver. without it the
+			// budget is most of the heap size and the usage is what our allocator reserved
+			VulkanMemoryBudget getMemoryBudget();
+
+			VulkanAllocator& getAllocator() { return *allocator; }
+			UploadContext& getUploadContext() { return *uploadContext; }
+			SamplerCache& getSamplerCache() { return *samplerCache; }
 
 			VkPhysicalDeviceProperties properties;
+			VkPhysicalDeviceFeatures features;
+			bool supportsTimelineSemaphore = false;
+			bool supportsDrawIndirectCount = false;
+			bool supportsMemoryBudget = false;
+			PFN_vkCmdDrawIndexedIndirectCountKHR cmdDrawIndexedIndirectCount = nullptr;
 			VkPhysicalDeviceMemoryProperties memoryProperties;
 			VkQueueFamilyProperties queueFamilyProperties;
 		private:
@@ -106,6 +144,7 @@ namespace VkRenderer {
 			void populateDebugMessengerCreateInfo(VkDebugUtilsMessengerCreateInfoEXT& createInfo);
 			void hasGflwRequiredInstanceExtensions();
 			bool checkDeviceExtensionSupport(VkPhysicalDevice device);
+			bool hasDeviceExtension(VkPhysicalDevice device, const char* extension);
 			SwapChainSupportDetails querySwapChainSupport(VkPhysicalDevice device);
 
 			VkInstance instance;
@@ -118,7 +157,13 @@ namespace VkRenderer {
 			VkSurfaceKHR _surface;
 			VkQueue _graphicsQueue;
 			VkQueue _presentQueue;
+			VkQueue _transferQueue;
+
+			std::unique_ptr<VulkanAllocator> allocator;
+			std::unique_ptr<UploadContext> uploadContext;
+			std::unique_ptr<SamplerCache> samplerCache;
 
 			uint32_t graphicsQueueFamily;
+			uint32_t transferQueueFamily;
 	};
 }
\ No newline at end of file
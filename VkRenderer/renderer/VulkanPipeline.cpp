@@ -7,8 +7,15 @@ namespace VkRenderer {
 		createGraphicsPipeline(vertFilepath, fragFilepath, configInfo);
 	}
 
+	VulkanPipeline::VulkanPipeline(VulkanDevice& device, const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+		: device{device}, bindPoint{VK_PIPELINE_BIND_POINT_COMPUTE}
+	{
+		createComputePipeline(compFilepath, pipelineLayout);
+	}
+
 	VulkanPipeline::~VulkanPipeline()
 	{
+		vkDestroyShaderModule(device.device(), compShaderModule, nullptr);
 		vkDestroyShaderModule(device.device(), fragShaderModule, nullptr);
 		vkDestroyShaderModule(device.device(), vertShaderModule, nullptr);
 		vkDestroyPipeline(device.device(), graphicsPipeline, nullptr);
@@ -93,6 +100,26 @@ namespace VkRenderer {
 		}
 	}
 
+	void VulkanPipeline::createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout)
+	{
+		auto compShaderCode = readFile(compFilepath);
+		createShaderModule(compShaderCode, &compShaderModule);
+
+		VkComputePipelineCreateInfo pipelineInfo{};
+		pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+		pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+		pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+		pipelineInfo.stage.module = compShaderModule;
+		pipelineInfo.stage.pName = "main";
+		pipelineInfo.layout = pipelineLayout;
+		pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
+		pipelineInfo.basePipelineIndex = -1;
+
+		if (vkCreateComputePipelines(device.device(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create compute pipeline!");
+		}
+	}
+
 	void VulkanPipeline::createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule)
 	{
 		VkShaderModuleCreateInfo createInfo{};
@@ -107,7 +134,7 @@ namespace VkRenderer {
 
 	void VulkanPipeline::bind(VkCommandBuffer commandBuffer) const
 	{
-		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+		vkCmdBindPipeline(commandBuffer, bindPoint, graphicsPipeline);
 	}
 
 	void VulkanPipeline::defaultPipelineConfigInfo(PipelineConfigInfo& configInfo)
@@ -39,6 +39,11 @@ namespace VkRenderer {
 				const std::string& vertFilepath,
 				const std::string& fragFilepath,
 				const PipelineConfigInfo& configInfo);
+			// compute pipeline
+			VulkanPipeline(
+				VulkanDevice& device,
+				const std::string& compFilepath,
+				VkPipelineLayout pipelineLayout);
 			~VulkanPipeline();
 
 			VulkanPipeline(const VulkanPipeline&) = delete;
@@ -51,11 +56,14 @@ namespace VkRenderer {
 			static std::vector<char> readFile(const std::string& filepath);
 
 			void createGraphicsPipeline(const std::string& vertFilepath, const std::string& fragFilepath, const PipelineConfigInfo& configInfo);
+			void createComputePipeline(const std::string& compFilepath, VkPipelineLayout pipelineLayout);
 			void createShaderModule(const std::vector<char>& code, VkShaderModule* shaderModule);
 
 			VulkanDevice& device;
 			VkPipeline graphicsPipeline;
-			VkShaderModule vertShaderModule;
-			VkShaderModule fragShaderModule;
+			VkPipelineBindPoint bindPoint = VK_PIPELINE_BIND_POINT_GRAPHICS;
+			VkShaderModule vertShaderModule = VK_NULL_HANDLE;
+			VkShaderModule fragShaderModule = VK_NULL_HANDLE;
+			VkShaderModule compShaderModule = VK_NULL_HANDLE;
 	};
 }
\ No newline at end of file
@@ -69,7 +69,7 @@ namespace VkRenderer {
 			VkRenderPass renderPass;
 
 			std::vector<VkImage> depthImages;
-			std::vector<VkDeviceMemory> depthImageMemorys;
+			std::vector<VulkanAllocation> depthImageMemorys;
 			std::vector<VkImageView> depthImageViews;
 			std::vector<VkImage> swapChainImages;
 			std::vector<VkImageView> swapChainImageViews;
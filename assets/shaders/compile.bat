@@ -2,7 +2,11 @@
 cd /d "%~dp0"
 
 E:\VulkanSDK\1.4.304.0\Bin\glslc.exe shader.vert -o compiled\vert.spv
+E:\VulkanSDK\1.4.304.0\Bin\glslc.exe -DINDIRECT_DRAW shader.vert -o compiled\vert_indirect.spv
+E:\VulkanSDK\1.4.304.0\Bin\glslc.exe -DCOMPACT_VERTEX shader.vert -o compiled\vert_compact.spv
+E:\VulkanSDK\1.4.304.0\Bin\glslc.exe -DCOMPACT_VERTEX -DINDIRECT_DRAW shader.vert -o compiled\vert_compact_indirect.spv
 E:\VulkanSDK\1.4.304.0\Bin\glslc.exe shader.frag -o compiled\frag.spv
+E:\VulkanSDK\1.4.304.0\Bin\glslc.exe meshlet_cull.comp -o compiled\meshlet_cull_comp.spv
 
 E:\VulkanSDK\1.4.304.0\Bin\glslc.exe point_light.vert -o compiled\point_light_vert.spv
 E:\VulkanSDK\1.4.304.0\Bin\glslc.exe point_light.frag -o compiled\point_light_frag.spv
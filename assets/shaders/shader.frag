@@ -7,6 +7,7 @@ layout(location = 1) in vec3 fragWorldPos;
 layout(location = 2) in vec3 fragWorldNormal;
 layout(location = 3) in vec2 fragUV;
 layout(location = 4) in mat3 fragTBN;
+layout(location = 7) flat in uint fragMaterialIndex;
 
 layout(location = 0) out vec4 outColor;
 
@@ -29,13 +30,6 @@ layout(set = 0, binding = 0, scalar) buffer GlobalUbo {
 
 layout(set = 0, binding = 1) uniform sampler2D Sampler2D[];
 
-layout(push_constant) uniform Push {
-    mat4 modelMatrix;
-    mat4 normalMatrix;
-    uint bufferIndex;
-    uint materialIndex;
-} push;
-
 struct Material {
     uint albedoIndex;
     uint normalIndex;
@@ -50,10 +44,12 @@ vec3 gammaCorrect(vec3 color) {
 }
 
 void main() {
-    Material material = ssbo.materials[push.materialIndex];
+    Material material = ssbo.materials[fragMaterialIndex];
 
-    vec3 normalMap = texture(Sampler2D[nonuniformEXT(material.normalIndex)], fragUV).rgb;
-    vec3 surfaceNormal = normalize(fragTBN * (normalMap * 2.0 - 1.0));
+    // only x and y are read so BC5 normal maps work too, z is rebuilt from the unit length
+    vec2 normalXY = texture(Sampler2D[nonuniformEXT(material.normalIndex)], fragUV).rg * 2.0 - 1.0;
+    vec3 normalMap = vec3(normalXY, sqrt(max(1.0 - dot(normalXY, normalXY), 0.0)));
+    vec3 surfaceNormal = normalize(fragTBN * normalMap);
 
     vec3 viewDir = normalize(ubo.inverseView[3].xyz - fragWorldPos);
     vec3 diffuseLight = ubo.ambientLightColor.rgb * ubo.ambientLightColor.a;
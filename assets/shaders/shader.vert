@@ -2,17 +2,33 @@
 #extension GL_EXT_nonuniform_qualifier : require
 #extension GL_EXT_scalar_block_layout : require
 
+#ifdef COMPACT_VERTEX
+// see VulkanModel::CompactVertex, the model matrix already contains the dequantization
+layout(location = 0) in vec4 packedPosition; // w is the tangent sign
+layout(location = 2) in vec2 packedNormal;
+layout(location = 3) in vec2 uv;
+layout(location = 4) in vec2 packedTangent;
+
+vec3 octDecode(vec2 e) {
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    float t = max(-v.z, 0.0);
+    v.xy += vec2(v.x >= 0.0 ? -t : t, v.y >= 0.0 ? -t : t);
+    return normalize(v);
+}
+#else
 layout(location = 0) in vec3 position;
 layout(location = 1) in vec3 color;
 layout(location = 2) in vec3 normal;
 layout(location = 3) in vec2 uv;
 layout(location = 4) in vec4 tangent;
+#endif
 
 layout(location = 0) out vec3 fragColor;
 layout(location = 1) out vec3 fragWorldPos;
 layout(location = 2) out vec3 fragWorldNormal;
 layout(location = 3) out vec2 fragUV;
 layout(location = 4) out mat3 fragTBN;
+layout(location = 7) flat out uint fragMaterialIndex;
 
 struct PointLight {
     vec4 position;
@@ -33,20 +49,59 @@ layout(set = 0, binding = 0, scalar) buffer GlobalUbo {
 
 layout(set = 0, binding = 1) uniform sampler2D Sampler2D[];
 
+#ifdef INDIRECT_DRAW
+struct ObjectData {
+    mat4 modelMatrix;
+    mat4 normalMatrix;
+};
+
+struct InstanceData {
+    uint objectIndex;
+    uint materialIndex;
+};
+
+layout(set = 0, binding = 4, std430) readonly buffer ObjectBuffer {
+    ObjectData objects[];
+} objectBuffer;
+
+layout(set = 0, binding = 5, std430) readonly buffer InstanceBuffer {
+    InstanceData instances[];
+} instanceBuffer;
+#else
 layout(push_constant) uniform Push {
     mat4 modelMatrix;
     mat4 normalMatrix;
     uint bufferIndex;
     uint materialIndex;
 } push;
+#endif
 
 void main() {
-    vec3 worldNormal   = normalize(mat3(push.normalMatrix) * normal);
-    vec3 worldTangent  = normalize(mat3(push.normalMatrix) * tangent.xyz);
+#ifdef COMPACT_VERTEX
+    vec3 position = packedPosition.xyz;
+    vec3 color = vec3(1.0);
+    vec3 normal = octDecode(packedNormal);
+    vec4 tangent = vec4(octDecode(packedTangent), packedPosition.w < 0.0 ? -1.0 : 1.0);
+#endif
+
+#ifdef INDIRECT_DRAW
+    InstanceData instance = instanceBuffer.instances[gl_InstanceIndex];
+    ObjectData object = objectBuffer.objects[instance.objectIndex];
+    mat4 modelMatrix = object.modelMatrix;
+    mat4 normalMatrix = object.normalMatrix;
+    fragMaterialIndex = instance.materialIndex;
+#else
+    mat4 modelMatrix = push.modelMatrix;
+    mat4 normalMatrix = push.normalMatrix;
+    fragMaterialIndex = push.materialIndex;
+#endif
+
+    vec3 worldNormal   = normalize(mat3(normalMatrix) * normal);
+    vec3 worldTangent  = normalize(mat3(normalMatrix) * tangent.xyz);
     vec3 worldBitangent = normalize(cross(worldNormal, worldTangent)) * tangent.w;
 
     fragWorldNormal = worldNormal;
-    fragWorldPos = (push.modelMatrix * vec4(position, 1.0)).xyz;
+    fragWorldPos = (modelMatrix * vec4(position, 1.0)).xyz;
     fragColor = color;
     fragUV = uv;
     fragTBN = mat3(worldTangent, worldBitangent, worldNormal);
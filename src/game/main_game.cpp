@@ -32,6 +32,7 @@ namespace VkRenderer {
 
     Game::~Game()
     {
+        retiredTextureIDs.flush();
         ImGui_ImplVulkan_Shutdown();
         ImGui_ImplGlfw_Shutdown();
         ImGui::DestroyContext();
@@ -47,9 +48,9 @@ namespace VkRenderer {
             VulkanDevice& device = world.getDevice();
             VkRenderPass renderPass = world.getRenderer().getSwapChainRenderPass();
 
-            this->renderingSystem = std::make_unique<RenderingSystem>(device, renderPass, layout->getDescriptorSetLayout());
+            this->renderingSystem = std::make_unique<RenderingSystem>(device, world.getGeometryPool(), world.modelRegistry, world.materialManager, renderPass, layout->getDescriptorSetLayout());
             this->pointLightSystem = std::make_unique<PointLightSystem>(device, renderPass, layout->getDescriptorSetLayout());
-            this->skyboxSystem = std::make_unique<SkyboxSystem>(device, renderPass, layout->getDescriptorSetLayout());
+            this->skyboxSystem = std::make_unique<SkyboxSystem>(device, world.getGeometryPool(), renderPass, layout->getDescriptorSetLayout());
         });
 
         world.setOnFrameUpdate([this]() {
@@ -88,6 +89,10 @@ namespace VkRenderer {
             pointLightSystem->update(frameInfo, ubo);
         });
 
+        world.setOnPreRender([this](FrameInfo frameInfo) {
+            renderingSystem->prepareFrame(frameInfo);
+        });
+
         world.setOnRender([this](VkCommandBuffer commandBuffer, FrameInfo frameInfo) {
             skyboxSystem->renderSkybox(frameInfo);
             renderingSystem->renderObjects(frameInfo);
@@ -311,7 +316,29 @@ namespace VkRenderer {
 
             // Texture manager
             static int selectedTextureIndex = 0;
-            static std::unordered_map<std::string, ImTextureID> textureIDCache;
+            // by texture id. views change as mips stream in or textures get trimmed, so entries are checked every frame,
+            // before MaterialManager destroys the old view, and their sets freed once no frame in flight draws them
+            struct CachedTexture {
+                VkImageView view;
+                ImTextureID id;
+            };
+            static std::unordered_map<size_t, CachedTexture> textureIDCache;
+
+            {
+                auto& textures = world.materialManager.getTextures();
+
+                for (auto it = textureIDCache.begin(); it != textureIDCache.end();) {
+                    if (it->second.view == textures[it->first]->getImageView()) {
+                        ++it;
+                        continue;
+                    }
+
+                    retiredTextureIDs.retire([id = it->second.id]() { ImGui_ImplVulkan_RemoveTexture((VkDescriptorSet)id); });
+                    it = textureIDCache.erase(it);
+                }
+
+                retiredTextureIDs.update();
+            }
 
             if (menu_TextureManager_open) {
                 ImGui::Begin("Texture Manager", &menu_TextureManager_open);
@@ -352,10 +379,9 @@ namespace VkRenderer {
 
                     if (!textureNames.empty())
                     {
-                        VulkanTexture* selected = textures[selectedTextureIndex].get();
-                        const std::string& selectedName = textureNames[selectedTextureIndex];
+                        VulkanTexture* selected = textures[selectedTextureIndex];
 
-                        if (textureIDCache.find(selectedName) == textureIDCache.end())
+                        if (textureIDCache.find(selectedTextureIndex) == textureIDCache.end())
                         {
                             VkDescriptorSet textureId = ImGui_ImplVulkan_AddTexture(
                                 selected->getSampler(),
@@ -363,10 +389,10 @@ namespace VkRenderer {
                                 selected->getImageLayout()
                             );
 
-                            textureIDCache[selectedName] = (ImTextureID)textureId;
+                            textureIDCache[selectedTextureIndex] = { selected->getImageView(), (ImTextureID)textureId };
                         }
 
-                        ImTextureID imguiTexture = textureIDCache[selectedName];
+                        ImTextureID imguiTexture = textureIDCache[selectedTextureIndex].id;
                         ImGui::Text("Preview:");
                         ImGui::Image(imguiTexture, ImVec2(128, 128));
 
@@ -384,6 +410,37 @@ namespace VkRenderer {
                     fps_text << "FPS: " << 1.f / world.getDeltaTime();
 
                     ImGui::Text(fps_text.str().c_str());
+
+                    if (renderingSystem->supportsIndirectDraw()) {
+                        ImGui::Checkbox("Indirect Drawing", &renderingSystem->useIndirectDraw);
+                        ImGui::Checkbox("Meshlet Culling", &renderingSystem->useMeshletCulling);
+                        ImGui::Checkbox("Meshlet Cone Culling", &renderingSystem->useConeCulling);
+                    }
+
+                    ImGui::Checkbox("Level of Detail", &renderingSystem->useLods);
+                    ImGui::SliderFloat("LOD Screen Error", &renderingSystem->lodScreenError, 0.0001f, 0.01f, "%.4f", ImGuiSliderFlags_Logarithmic);
+
+                    if (ImGui::CollapsingHeader("GPU Memory")) {
+                        VulkanAllocator& allocator = world.getDevice().getAllocator();
+                        constexpr float MB = 1024.f * 1024.f;
+
+                        for (uint32_t i = 0; i < allocator.getHeapCount(); i++) {
+                            VulkanHeapStats stats = allocator.getHeapStats(i);
+                            bool deviceLocal = stats.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT;
+
+                            ImGui::Text("Heap %u (%s): %.1f MB used, %.1f MB reserved, %.0f MB total",
+                                i, deviceLocal ? "device" : "host",
+                                stats.usedBytes / MB, stats.reservedBytes / MB, stats.heapSize / MB);
+                            ImGui::Text("    %u blocks, %u allocations (%u dedicated)",
+                                stats.blockCount, stats.allocationCount, stats.dedicatedCount);
+                        }
+
+                        ResidencyManager& residency = world.materialManager.getResidency();
+                        ImGui::Text("Textures: %.1f MB of a %.1f MB budget%s, %u trimmed, %u streaming",
+                            residency.getResidentBytes() / MB, residency.getBudget() / MB,
+                            world.getDevice().supportsMemoryBudget ? " (memory budget)" : "",
+                            residency.getTrimmedCount(), world.materialManager.getStreamingTextureCount());
+                    }
                 }
                 ImGui::End();
             }
@@ -395,10 +452,9 @@ namespace VkRenderer {
 
     void Game::loadObjects()
 	{
-        VulkanDevice& device = world.getDevice();
         MaterialManager& materialManager = world.materialManager;
 
-        std::shared_ptr<VulkanModel> model = VulkanModel::createModelFromFile(device, "assets/models/Sponza.gltf");
+        std::shared_ptr<VulkanModel> model = world.modelRegistry.load("assets/models/Sponza.gltf");
         auto floor = VulkanObject::create();
         floor.model = model;
         floor.material = materialManager.getMaterialId("brick");
@@ -418,7 +474,6 @@ namespace VkRenderer {
 
     void Game::loadTextures()
     {
-        VulkanDevice& device = world.getDevice();
         MaterialManager& materialManager = world.materialManager;
 
         struct MaterialLoadInfo {
@@ -432,40 +487,16 @@ namespace VkRenderer {
             { "wood",  "assets/textures/wood/color.jpg",  "assets/textures/wood/normal.png" }
         };
 
+        // decoded on the thread pool (or mapped from the texture cache after --cook), the ids show the default textures until the real ones are uploaded
         for(const auto& entry : materialsToLoad) {
-            materialManager.addTexture(entry.name + "_color", std::unique_ptr<VulkanTexture>(VulkanObject::createTexture(device, entry.albedoPath)));
-            materialManager.addTexture(entry.name + "_normal", std::unique_ptr<VulkanTexture>(VulkanObject::createTexture(device, entry.normalPath, VK_FORMAT_R8G8B8A8_UNORM)));
-
             Material material{};
-            material.albedoIndex = materialManager.getTextureId(entry.name + "_color");
-            material.normalIndex = materialManager.getTextureId(entry.name + "_normal");
+            material.albedoIndex = materialManager.loadTexture(entry.name + "_color", entry.albedoPath);
+            material.normalIndex = materialManager.loadTexture(entry.name + "_normal", entry.normalPath, TextureUsage::Normal, "default_normal");
 
             materialManager.addMaterial(entry.name, material);
         }
 
-        materialManager.addTexture("skybox_hdri", std::unique_ptr<VulkanTexture>(VulkanObject::createTexture(device, "assets/hdris/autumn_field.hdr", VK_FORMAT_R32G32B32A32_SFLOAT)));
-
-        materialManager.updateGPUBuffer();
-
-        // TODO: Do this in VulkanWorld
-
-        const auto& textureMap = materialManager.getTextureItems();
-        const auto& textureOrder = materialManager.getTextures();
-
-        std::vector<std::pair<std::string, size_t>> sortedTextures(textureMap.begin(), textureMap.end());
-        std::sort(sortedTextures.begin(), sortedTextures.end(), [](const auto& a, const auto& b) {
-            return a.second < b.second;
-        });
-
-        std::vector<VulkanTexture*> rawTextures;
-        rawTextures.reserve(sortedTextures.size());
-
-        for (const auto& [name, index] : sortedTextures) {
-            if (index < textureOrder.size()) 
-                rawTextures.push_back(textureOrder[index].get());
-        }
-
-        world.parseImages(world.convertImages(rawTextures));
+        materialManager.loadTexture("skybox_hdri", "assets/hdris/autumn_field.hdr", TextureUsage::Hdr);
     }
 
     bool Game::isToggled(auto key) {
@@ -5,6 +5,7 @@
 #include "VulkanObject.h"
 #include "VulkanRenderer.hpp"
 #include "VulkanWorld.hpp"
+#include "DeferredDestroyQueue.hpp"
 
 #include "systems/RenderingSystem.hpp"
 #include "systems/PointLightSystem.hpp"
@@ -49,5 +50,8 @@ namespace VkRenderer {
 
         bool showImGui = false;
         int selectedObjectId = -1;
+
+        // texture manager previews, their descriptor sets are freed once no frame in flight draws them
+        DeferredDestroyQueue retiredTextureIDs;
 	};
 }
\ No newline at end of file
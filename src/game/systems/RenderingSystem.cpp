@@ -4,8 +4,19 @@
 #include <glm/gtc/constants.hpp>
 
 #include "RenderingSystem.hpp"
+#include "VulkanSwapChain.hpp"
+#include "managers/material_manager.hpp"
+
+#include <algorithm>
 
 namespace VkRenderer {
+	constexpr uint32_t MAX_MESHLET_DRAWS = 262144; // per frame, submeshes past it are drawn whole
+	constexpr uint32_t MAX_CULL_JOBS = 65535; // one workgroup each, the smallest maxComputeWorkGroupCount allowed
+	constexpr uint32_t MAX_MESHLET_GROUPS = 16;
+
+	constexpr uint32_t CULL_FLAG_COMPACT = 1;
+	constexpr uint32_t CULL_FLAG_CONE_CULLING = 2;
+
 	struct SimplePushConstantData {
 		glm::mat4 modelMatrix{ 1.f };
 		glm::mat4 normalMatrix{};
@@ -13,13 +24,46 @@ namespace VkRenderer {
 		uint32_t materialIndex;
 	};
 
-	RenderingSystem::RenderingSystem(VulkanDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout) : device{ device } {
+	struct MeshletCullPushConstants {
+		glm::vec4 frustumPlanes[6];
+		glm::vec4 cameraPosition;
+		uint32_t jobCount;
+		uint32_t flags;
+	};
+
+	// world space planes of projection * view, normalized and pointing inwards. near is z = 0 since depth goes 0 to 1
+	static void extractFrustumPlanes(const glm::mat4& viewProjection, glm::vec4 planes[6])
+	{
+		glm::vec4 row0(viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0]);
+		glm::vec4 row1(viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1]);
+		glm::vec4 row2(viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2]);
+		glm::vec4 row3(viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3]);
+
+		planes[0] = row3 + row0;
+		planes[1] = row3 - row0;
+		planes[2] = row3 + row1;
+		planes[3] = row3 - row1;
+		planes[4] = row2;
+		planes[5] = row3 - row2;
+
+		for (int i = 0; i < 6; i++)
+			planes[i] /= glm::length(glm::vec3(planes[i]));
+	}
+
+	RenderingSystem::RenderingSystem(VulkanDevice& device, GeometryPool& geometryPool, ModelRegistry& modelRegistry, MaterialManager& materialManager, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+		: device{ device }, geometryPool{ geometryPool }, modelRegistry{ modelRegistry }, materialManager{ materialManager }
+	{
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
+		createIndirectBuffers();
+		createCullingPipeline();
+		createCullingBuffers();
 	}
 
 	RenderingSystem::~RenderingSystem()
 	{
+		if (cullPipeline)
+			vkDestroyPipelineLayout(device.device(), cullPipelineLayout, nullptr);
 		vkDestroyPipelineLayout(device.device(), pipelineLayout, nullptr);
 	}
 
@@ -55,15 +99,260 @@ namespace VkRenderer {
 		pipelineConfig.rasterizationInfo.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
 
 		pipeline = std::make_unique<VulkanPipeline>(device, "assets/shaders/compiled/vert.spv", "assets/shaders/compiled/frag.spv", pipelineConfig);
+
+		if (supportsIndirectDraw())
+			indirectPipeline = std::make_unique<VulkanPipeline>(device, "assets/shaders/compiled/vert_indirect.spv", "assets/shaders/compiled/frag.spv", pipelineConfig);
+
+		pipelineConfig.bindingDescriptions = VulkanModel::getBindingDescriptions(VulkanModel::VertexLayout::Compact);
+		pipelineConfig.attributeDescriptions = VulkanModel::getAttributeDescriptions(VulkanModel::VertexLayout::Compact);
+
+		compactPipeline = std::make_unique<VulkanPipeline>(device, "assets/shaders/compiled/vert_compact.spv", "assets/shaders/compiled/frag.spv", pipelineConfig);
+
+		if (supportsIndirectDraw())
+			compactIndirectPipeline = std::make_unique<VulkanPipeline>(device, "assets/shaders/compiled/vert_compact_indirect.spv", "assets/shaders/compiled/frag.spv", pipelineConfig);
+	}
+
+	VulkanPipeline& RenderingSystem::getPipeline(VulkanModel::VertexLayout layout, bool indirect)
+	{
+		if (layout == VulkanModel::VertexLayout::Compact)
+			return indirect ? *compactIndirectPipeline : *compactPipeline;
+
+		return indirect ? *indirectPipeline : *pipeline;
+	}
+
+	uint32_t RenderingSystem::selectLod(VulkanObject& object, const VulkanCamera& camera)
+	{
+		const VulkanModel& model = *object.model;
+		if (!useLods || model.getLodCount() <= 1)
+			return object.lod = 0;
+
+		glm::mat4 transform = object.transform.mat4();
+		float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+
+		const glm::vec4& sphere = model.getBoundingSphere();
+		glm::vec3 center = glm::vec3(transform * glm::vec4(glm::vec3(sphere), 1.0f));
+
+		// measured at the closest point of the bounding sphere, from inside it the full mesh is drawn
+		float distance = glm::length(center - camera.getPosition()) - sphere.w * scale;
+		if (distance <= 0.0f)
+			return object.lod = 0;
+
+		// screen heights covered by one model unit there, projection[1][1] is 1 / tan(fov / 2)
+		float projectedScale = scale * camera.getProjection()[1][1] * 0.5f / distance;
+
+		uint32_t lod = std::min(object.lod, model.getLodCount() - 1);
+		while (lod > 0 && model.getLodError(lod) * projectedScale > lodScreenError)
+			lod--;
+		while (lod + 1 < model.getLodCount() && model.getLodError(lod + 1) * projectedScale <= lodScreenError * (1.0f - lodHysteresis))
+			lod++;
+
+		return object.lod = lod;
+	}
+
+	void RenderingSystem::createIndirectBuffers()
+	{
+		if (!supportsIndirectDraw())
+			return;
+
+		indirectBuffers.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		for (auto& buffer : indirectBuffers) {
+			buffer = std::make_unique<VulkanBuffer>(
+				device,
+				sizeof(VkDrawIndexedIndirectCommand),
+				MAX_OBJECTS,
+				VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+
+			buffer->map();
+		}
+	}
+
+	void RenderingSystem::createCullingPipeline()
+	{
+		if (!supportsIndirectDraw())
+			return;
+
+		cullSetLayout = VulkanDescriptorSetLayout::Builder(device)
+			.addBinding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.addBinding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, VK_SHADER_STAGE_COMPUTE_BIT)
+			.build();
+
+		cullDescriptorPool = VulkanDescriptorPool::Builder(device)
+			.setMaxSets(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.addPoolSize(VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 5 * VulkanSwapChain::MAX_FRAMES_IN_FLIGHT)
+			.build();
+
+		cullDescriptorSets.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(MeshletCullPushConstants);
+
+		VkDescriptorSetLayout setLayout = cullSetLayout->getDescriptorSetLayout();
+
+		VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+		pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+		pipelineLayoutInfo.setLayoutCount = 1;
+		pipelineLayoutInfo.pSetLayouts = &setLayout;
+		pipelineLayoutInfo.pushConstantRangeCount = 1;
+		pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+		if (vkCreatePipelineLayout(device.device(), &pipelineLayoutInfo, nullptr, &cullPipelineLayout) != VK_SUCCESS) {
+			throw std::runtime_error("failed to create culling pipeline layout!");
+		}
+
+		cullPipeline = std::make_unique<VulkanPipeline>(device, "assets/shaders/compiled/meshlet_cull_comp.spv", cullPipelineLayout);
+	}
+
+	void RenderingSystem::createCullingBuffers()
+	{
+		if (!cullPipeline)
+			return;
+
+		cullJobBuffers.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+		meshletCommandBuffers.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+		meshletCountBuffers.resize(VulkanSwapChain::MAX_FRAMES_IN_FLIGHT);
+
+		for (int i = 0; i < VulkanSwapChain::MAX_FRAMES_IN_FLIGHT; i++) {
+			cullJobBuffers[i] = std::make_unique<VulkanBuffer>(
+				device,
+				sizeof(CullJob),
+				MAX_CULL_JOBS,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT
+			);
+			cullJobBuffers[i]->map();
+
+			// only the GPU touches these
+			meshletCommandBuffers[i] = std::make_unique<VulkanBuffer>(
+				device,
+				sizeof(VkDrawIndexedIndirectCommand),
+				MAX_MESHLET_DRAWS,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+
+			meshletCountBuffers[i] = std::make_unique<VulkanBuffer>(
+				device,
+				sizeof(uint32_t),
+				MAX_MESHLET_GROUPS,
+				VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+				VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
+			);
+		}
+	}
+
+	void RenderingSystem::prepareFrame(FrameInfo& frameInfo)
+	{
+		framePrepared = false;
+
+		if (!useIndirectDraw || !supportsIndirectDraw())
+			return;
+
+		bool cullMeshlets = useMeshletCulling && cullPipeline != nullptr;
+		buildIndirectDraws(frameInfo, cullMeshlets);
+
+		if (cullMeshlets)
+			recordMeshletCulling(frameInfo);
+
+		framePrepared = true;
 	}
 
 	void RenderingSystem::renderObjects(FrameInfo& frameInfo)
+	{
+		reportTextureUsage(frameInfo);
+		requireUploads(frameInfo);
+
+		if (useIndirectDraw && supportsIndirectDraw()) {
+			// dispatches can't be recorded inside the render pass, so an unprepared frame skips meshlet culling
+			if (!framePrepared)
+				buildIndirectDraws(frameInfo, false);
+
+			renderObjectsIndirect(frameInfo);
+		}
+		else
+			renderObjectsDirect(frameInfo);
+
+		framePrepared = false;
+	}
+
+	void RenderingSystem::reportTextureUsage(FrameInfo& frameInfo)
+	{
+		// the gpu culls for real, this is only a sphere test per submesh so textures out of view can go cold
+		glm::vec4 planes[6];
+		extractFrustumPlanes(frameInfo.camera.getProjection() * frameInfo.camera.getView(), planes);
+
+		for (auto& [id, object] : frameInfo.objects) {
+			if (object.model == nullptr)
+				continue;
+
+			object.getSubmeshWorldBounds(submeshBounds);
+			for (uint32_t submesh = 0; submesh < submeshBounds.size(); submesh++) {
+				const glm::vec4& sphere = submeshBounds[submesh].sphere;
+
+				bool visible = true;
+				for (int i = 0; i < 6 && visible; i++)
+					visible = glm::dot(glm::vec3(planes[i]), glm::vec3(sphere)) + planes[i].w >= -sphere.w;
+
+				if (visible)
+					materialManager.markMaterialUsed(object.getSubmeshMaterial(submesh));
+			}
+		}
+	}
+
+	void RenderingSystem::requireUploads(FrameInfo& frameInfo)
+	{
+		// models created since the last batch completed, the frame's submit waits for their geometry instead of every frame waiting on every upload
+		UploadContext& uploadContext = device.getUploadContext();
+
+		for (auto& [id, object] : frameInfo.objects)
+			if (object.model != nullptr)
+				uploadContext.requireForFrame(object.model->getUploadTicket());
+	}
+
+	void RenderingSystem::renderObjectsDirect(FrameInfo& frameInfo)
 	{
 		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
-		VulkanCamera camera = frameInfo.camera;
 
-		pipeline->bind(commandBuffer);
+		drawList.clear();
+		for (auto& [id, object] : frameInfo.objects) {
+			if (object.model == nullptr)
+				continue;
+
+			uint32_t lod = selectLod(object, frameInfo.camera);
+			uint32_t submeshCount = static_cast<uint32_t>(object.model->getSubmeshes().size());
+			for (uint32_t submesh = 0; submesh < submeshCount; submesh++)
+				drawList.push_back({ object.model->getVertexLayout(), object.model.get(), &object, submesh, object.getSubmeshMaterial(submesh), 0, lod });
+		}
 
+		// layout first since it switches the pipeline, then batch by material, then by pool so the vertex/index buffers are rebound as rarely as possible
+		std::sort(drawList.begin(), drawList.end(), [](const SubmeshDraw& a, const SubmeshDraw& b) {
+			if (a.layout != b.layout)
+				return a.layout < b.layout;
+
+			if (a.material != b.material)
+				return a.material < b.material;
+
+			GeometryPool* poolA = &a.model->getGeometryPool();
+			GeometryPool* poolB = &b.model->getGeometryPool();
+			if (poolA != poolB)
+				return poolA < poolB;
+
+			if (a.model->getIndexType() != b.model->getIndexType())
+				return a.model->getIndexType() < b.model->getIndexType();
+
+			return a.object != b.object ? a.object < b.object : a.submesh < b.submesh;
+		});
+
+		if (drawList.empty())
+			return;
+
+		// every pipeline shares the layout, so the set stays bound across pipeline switches
 		vkCmdBindDescriptorSets(
 			commandBuffer,
 			VK_PIPELINE_BIND_POINT_GRAPHICS,
@@ -73,22 +362,314 @@ namespace VkRenderer {
 			0, nullptr
 		);
 
-		for (auto& key : frameInfo.objects) {
-			auto& object = key.second;
+		GeometryPool* boundPool = nullptr;
+		VkIndexType boundIndexType = VK_INDEX_TYPE_MAX_ENUM;
+		VulkanObject* pushedObject = nullptr;
+		uint32_t pushedMaterial = 0;
+		bool pipelineBound = false;
+		VulkanModel::VertexLayout boundLayout{};
 
-			if (object.model == nullptr)
-				continue;
+		for (auto& draw : drawList) {
+			if (!pipelineBound || draw.layout != boundLayout) {
+				getPipeline(draw.layout, false).bind(commandBuffer);
+				pipelineBound = true;
+				boundLayout = draw.layout;
+			}
+
+			if (draw.object != pushedObject || draw.material != pushedMaterial) {
+				SimplePushConstantData push{};
+
+				push.modelMatrix = draw.object->transform.mat4() * draw.model->getDequantization();
+				push.normalMatrix = draw.object->transform.normalMatrix();
+				push.bufferIndex = frameInfo.frameIndex;
+				push.materialIndex = draw.material;
+
+				vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
+
+				pushedObject = draw.object;
+				pushedMaterial = draw.material;
+			}
+
+			if (&draw.model->getGeometryPool() != boundPool || draw.model->getIndexType() != boundIndexType) {
+				draw.model->bind(commandBuffer);
+				boundPool = &draw.model->getGeometryPool();
+				boundIndexType = draw.model->getIndexType();
+			}
+
+			draw.model->drawSubmesh(commandBuffer, draw.submesh, draw.lod);
+		}
+	}
+
+	void RenderingSystem::buildIndirectDraws(FrameInfo& frameInfo, bool cullMeshlets)
+	{
+		auto* objectData = static_cast<ObjectData*>(frameInfo.objectBuffer.getMappedMemory());
+		auto* instanceData = static_cast<InstanceData*>(frameInfo.instanceBuffer.getMappedMemory());
+		auto* commands = static_cast<VkDrawIndexedIndirectCommand*>(indirectBuffers[frameInfo.frameIndex]->getMappedMemory());
+
+		// object data is written once, every submesh instance only points at it
+		drawList.clear();
+		meshletDrawList.clear();
+		uint32_t objectCount = 0;
+		uint32_t meshletDrawCount = 0;
+
+		// objects sharing a model come as one group, models that need the same pipeline and buffers next to each other
+		// so their commands merge into one draw call
+		modelRegistry.gatherInstances(frameInfo.objects, instanceGroups);
+
+		std::stable_sort(instanceGroups.begin(), instanceGroups.end(), [](const ModelRegistry::InstanceGroup& a, const ModelRegistry::InstanceGroup& b) {
+			if (a.model->getVertexLayout() != b.model->getVertexLayout())
+				return a.model->getVertexLayout() < b.model->getVertexLayout();
+
+			GeometryPool* poolA = &a.model->getGeometryPool();
+			GeometryPool* poolB = &b.model->getGeometryPool();
+			if (poolA != poolB)
+				return poolA < poolB;
+
+			return a.model->getIndexType() < b.model->getIndexType();
+		});
+
+		for (auto& group : instanceGroups) {
+			size_t firstDraw = drawList.size();
+
+			for (VulkanObject* instance : group.objects) {
+				if (objectCount >= MAX_OBJECTS)
+					break;
+
+				VulkanObject& object = *instance;
+
+				ObjectData& data = objectData[objectCount];
+				data.modelMatrix = object.transform.mat4() * object.model->getDequantization();
+				data.normalMatrix = object.transform.normalMatrix();
+
+				// meshlets only exist in the pool the culling pass reads from, and only cover the full mesh
+				uint32_t lod = selectLod(object, frameInfo.camera);
+				bool meshlets = cullMeshlets && lod == 0 && object.model->hasMeshlets() && &object.model->getGeometryPool() == &geometryPool;
+
+				const auto& submeshes = object.model->getSubmeshes();
+				for (uint32_t submesh = 0; submesh < submeshes.size(); submesh++) {
+					SubmeshDraw draw{ object.model->getVertexLayout(), object.model.get(), &object, submesh, object.getSubmeshMaterial(submesh), objectCount, lod };
+
+					uint32_t meshletCount = submeshes[submesh].meshletCount;
+					if (meshlets && meshletCount > 0 && meshletDrawList.size() < MAX_CULL_JOBS && meshletDrawCount + meshletCount <= MAX_MESHLET_DRAWS) {
+						meshletDrawList.push_back(draw);
+						meshletDrawCount += meshletCount;
+					}
+					else
+						drawList.push_back(draw);
+				}
+
+				objectCount++;
+			}
+
+			// every draw here is the same model, sorting by submesh and level makes every pair one instanced draw command.
+			// materials are per instance
+			std::sort(drawList.begin() + firstDraw, drawList.end(), [](const SubmeshDraw& a, const SubmeshDraw& b) {
+				if (a.submesh != b.submesh)
+					return a.submesh < b.submesh;
+
+				return a.lod != b.lod ? a.lod < b.lod : a.material < b.material;
+			});
+		}
+
+		commandGroups.clear();
+		uint32_t instanceCount = 0;
+
+		for (size_t i = 0; i < drawList.size() && instanceCount < MAX_INSTANCES && commandGroups.size() < MAX_OBJECTS;) {
+			VulkanModel* model = drawList[i].model;
+			uint32_t submesh = drawList[i].submesh;
+			uint32_t lod = drawList[i].lod;
+			const VulkanModel::Submesh& range = model->getSubmeshes()[submesh];
+
+			VkDrawIndexedIndirectCommand& command = commands[commandGroups.size()];
+			command.indexCount = range.lods[lod].indexCount;
+			command.firstIndex = model->getFirstIndex() + range.lods[lod].firstIndex;
+			command.vertexOffset = model->getVertexOffset() + range.vertexOffset;
+			command.firstInstance = instanceCount;
+
+			for (; i < drawList.size() && drawList[i].model == model && drawList[i].submesh == submesh && drawList[i].lod == lod && instanceCount < MAX_INSTANCES; i++) {
+				InstanceData& instance = instanceData[instanceCount++];
+				instance.objectIndex = drawList[i].objectIndex;
+				instance.materialIndex = drawList[i].material;
+			}
+
+			command.instanceCount = instanceCount - command.firstInstance;
+			commandGroups.push_back({ model->getVertexLayout(), &model->getGeometryPool(), model->getIndexType() });
+		}
+
+		// meshlet draws become cull jobs, one per submesh instance, grouped by what needs a separate draw call
+		std::sort(meshletDrawList.begin(), meshletDrawList.end(), [](const SubmeshDraw& a, const SubmeshDraw& b) {
+			if (a.layout != b.layout)
+				return a.layout < b.layout;
+
+			return a.model->getIndexType() < b.model->getIndexType();
+		});
+
+		meshletGroups.clear();
+		cullJobCount = 0;
+
+		if (!meshletDrawList.empty()) {
+			auto* jobs = static_cast<CullJob*>(cullJobBuffers[frameInfo.frameIndex]->getMappedMemory());
+
+			for (const SubmeshDraw& draw : meshletDrawList) {
+				if (instanceCount >= MAX_INSTANCES)
+					break;
+
+				VkIndexType indexType = draw.model->getIndexType();
+				if (meshletGroups.empty() || meshletGroups.back().layout != draw.layout || meshletGroups.back().indexType != indexType) {
+					if (meshletGroups.size() >= MAX_MESHLET_GROUPS)
+						break;
+
+					uint32_t base = meshletGroups.empty() ? 0 : meshletGroups.back().commandBase + meshletGroups.back().commandCount;
+					meshletGroups.push_back({ draw.layout, indexType, base, 0 });
+				}
+
+				MeshletGroup& group = meshletGroups.back();
+				const VulkanModel::Submesh& range = draw.model->getSubmeshes()[draw.submesh];
+
+				InstanceData& instance = instanceData[instanceCount];
+				instance.objectIndex = draw.objectIndex;
+				instance.materialIndex = draw.material;
+
+				// the meshlet bounds are in model units, the sphere grows with the largest axis scale
+				glm::mat4 transform = draw.object->transform.mat4();
+				float scale = std::max({ glm::length(glm::vec3(transform[0])), glm::length(glm::vec3(transform[1])), glm::length(glm::vec3(transform[2])) });
+
+				CullJob& job = jobs[cullJobCount++];
+				job.firstMeshlet = draw.model->getFirstMeshlet() + range.firstMeshlet;
+				job.meshletCount = range.meshletCount;
+				job.objectIndex = draw.objectIndex;
+				job.instanceIndex = instanceCount++;
+				job.group = static_cast<uint32_t>(meshletGroups.size() - 1);
+				job.commandBase = group.commandBase;
+				job.commandOffset = group.commandBase + group.commandCount;
+				job.radiusScale = scale;
+
+				group.commandCount += range.meshletCount;
+			}
+
+			cullJobBuffers[frameInfo.frameIndex]->flush();
+		}
+
+		frameInfo.objectBuffer.flush();
+		frameInfo.instanceBuffer.flush();
+		indirectBuffers[frameInfo.frameIndex]->flush();
+	}
+
+	void RenderingSystem::recordMeshletCulling(FrameInfo& frameInfo)
+	{
+		if (cullJobCount == 0)
+			return;
+
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+		int frameIndex = frameInfo.frameIndex;
+
+		VkDescriptorSet& descriptorSet = cullDescriptorSets[frameIndex];
+		if (descriptorSet == VK_NULL_HANDLE) {
+			auto meshletInfo = geometryPool.getMeshletBuffer().descriptorInfo();
+			auto jobInfo = cullJobBuffers[frameIndex]->descriptorInfo();
+			auto objectInfo = frameInfo.objectBuffer.descriptorInfo();
+			auto commandInfo = meshletCommandBuffers[frameIndex]->descriptorInfo();
+			auto countInfo = meshletCountBuffers[frameIndex]->descriptorInfo();
+
+			VulkanDescriptorWriter(*cullSetLayout, *cullDescriptorPool)
+				.writeBuffer(0, &meshletInfo)
+				.writeBuffer(1, &jobInfo)
+				.writeBuffer(2, &objectInfo)
+				.writeBuffer(3, &commandInfo)
+				.writeBuffer(4, &countInfo)
+				.build(descriptorSet);
+		}
+
+		// counters start at zero every frame
+		vkCmdFillBuffer(commandBuffer, meshletCountBuffers[frameIndex]->getBuffer(), 0, sizeof(uint32_t) * MAX_MESHLET_GROUPS, 0);
+
+		VkMemoryBarrier clearBarrier{};
+		clearBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		clearBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		clearBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 1, &clearBarrier, 0, nullptr, 0, nullptr);
+
+		MeshletCullPushConstants push{};
+		extractFrustumPlanes(frameInfo.camera.getProjection() * frameInfo.camera.getView(), push.frustumPlanes);
+		push.cameraPosition = glm::vec4(frameInfo.camera.getPosition(), 1.0f);
+		push.jobCount = cullJobCount;
+		push.flags = (device.supportsDrawIndirectCount ? CULL_FLAG_COMPACT : 0) | (useConeCulling ? CULL_FLAG_CONE_CULLING : 0);
+
+		cullPipeline->bind(commandBuffer);
+		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+		vkCmdPushConstants(commandBuffer, cullPipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(MeshletCullPushConstants), &push);
+		vkCmdDispatch(commandBuffer, cullJobCount, 1, 1);
+
+		VkMemoryBarrier drawBarrier{};
+		drawBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+		drawBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+		drawBarrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 1, &drawBarrier, 0, nullptr, 0, nullptr);
+	}
+
+	void RenderingSystem::renderObjectsIndirect(FrameInfo& frameInfo)
+	{
+		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
+
+		bool drawMeshlets = framePrepared && cullJobCount > 0;
+		if (commandGroups.empty() && !drawMeshlets)
+			return;
+
+		vkCmdBindDescriptorSets(
+			commandBuffer,
+			VK_PIPELINE_BIND_POINT_GRAPHICS,
+			pipelineLayout,
+			0, 1,
+			&frameInfo.globalDescriptorSet,
+			0, nullptr
+		);
+
+		VkBuffer indirectBuffer = indirectBuffers[frameInfo.frameIndex]->getBuffer();
+		constexpr uint32_t stride = sizeof(VkDrawIndexedIndirectCommand);
+
+		// commands sharing a vertex layout, geometry pool and index type are drawn with a single call
+		uint32_t first = 0;
+		while (first < commandGroups.size()) {
+			const CommandGroup& group = commandGroups[first];
+
+			uint32_t count = 1;
+			while (first + count < commandGroups.size() && commandGroups[first + count] == commandGroups[first])
+				count++;
+
+			getPipeline(group.layout, true).bind(commandBuffer);
+			group.pool->bind(commandBuffer, group.indexType);
+
+			if (device.features.multiDrawIndirect)
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, first * stride, count, stride);
+			else {
+				for (uint32_t i = 0; i < count; i++)
+					vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffer, (first + i) * stride, 1, stride);
+			}
+
+			first += count;
+		}
+
+		if (!drawMeshlets)
+			return;
+
+		VkBuffer meshletCommands = meshletCommandBuffers[frameInfo.frameIndex]->getBuffer();
+		VkBuffer meshletCounts = meshletCountBuffers[frameInfo.frameIndex]->getBuffer();
 
-			SimplePushConstantData push{};
+		// compacted draws stop at the group counter, without draw count the culled meshlets are zero instance draws
+		for (uint32_t g = 0; g < meshletGroups.size(); g++) {
+			const MeshletGroup& group = meshletGroups[g];
 
-			push.modelMatrix = object.transform.mat4();
-			push.normalMatrix = object.transform.normalMatrix();
-			push.bufferIndex = frameInfo.frameIndex;
-			push.materialIndex = object.material;
+			getPipeline(group.layout, true).bind(commandBuffer);
+			geometryPool.bind(commandBuffer, group.indexType);
 
-			vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(SimplePushConstantData), &push);
-			object.model->bind(commandBuffer);
-			object.model->draw(commandBuffer);
+			if (device.supportsDrawIndirectCount)
+				device.cmdDrawIndexedIndirectCount(commandBuffer, meshletCommands, group.commandBase * stride, meshletCounts, g * sizeof(uint32_t), group.commandCount, stride);
+			else if (device.features.multiDrawIndirect)
+				vkCmdDrawIndexedIndirect(commandBuffer, meshletCommands, group.commandBase * stride, group.commandCount, stride);
+			else {
+				for (uint32_t i = 0; i < group.commandCount; i++)
+					vkCmdDrawIndexedIndirect(commandBuffer, meshletCommands, (group.commandBase + i) * stride, 1, stride);
+			}
 		}
 	}
-}
\ No newline at end of file
+}
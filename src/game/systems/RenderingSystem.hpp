@@ -5,6 +5,12 @@
 #include "VulkanObject.h"
 #include "VulkanCamera.hpp"
 #include "VulkanFrameInfo.hpp"
+#include "VulkanBuffer.hpp"
+#include "VulkanDescriptors.hpp"
+#include "GeometryPool.hpp"
+#include "managers/model_registry.hpp"
+
+#include <vector>
 
 namespace VkRenderer {
     class RenderingSystem
@@ -12,20 +18,114 @@ namespace VkRenderer {
     public:
         float deltaTime;
 
-        RenderingSystem(VulkanDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+        // GPU-driven path: per object data goes into an SSBO and every submesh is one instanced indirect draw
+        bool useIndirectDraw = true;
+
+        // indirect path only: models with meshlets in the geometry pool are culled per meshlet by a compute pass
+        bool useMeshletCulling = true;
+        bool useConeCulling = true;
+
+        // every object picks a simplified level of its model from how large it is on screen, see selectLod
+        bool useLods = true;
+        float lodScreenError = 0.001f; // simplification error allowed on screen, in screen heights. about a pixel at 1080p
+        float lodHysteresis = 0.25f; // a coarser level has to come in this far under the limit, so objects don't flicker at the boundary
+
+        RenderingSystem(VulkanDevice& device, GeometryPool& geometryPool, ModelRegistry& modelRegistry, MaterialManager& materialManager, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
         ~RenderingSystem();
 
         RenderingSystem(const RenderingSystem&) = delete;
         RenderingSystem& operator=(const RenderingSystem&) = delete;
 
+        // records the meshlet culling pass, call it before the render pass. without it the frame is drawn per submesh
+        void prepareFrame(FrameInfo& frameInfo);
         void renderObjects(FrameInfo &frameInfo);
+
+        bool supportsIndirectDraw() const { return device.features.drawIndirectFirstInstance; }
     private:
         void createPipelineLayout(VkDescriptorSetLayout globalSetLayout);
         void createPipeline(VkRenderPass renderPass);
+        void createIndirectBuffers();
+        void createCullingPipeline();
+        void createCullingBuffers();
+
+        void reportTextureUsage(FrameInfo& frameInfo);
+        void requireUploads(FrameInfo& frameInfo);
+        void renderObjectsDirect(FrameInfo& frameInfo);
+        void buildIndirectDraws(FrameInfo& frameInfo, bool cullMeshlets);
+        void recordMeshletCulling(FrameInfo& frameInfo);
+        void renderObjectsIndirect(FrameInfo& frameInfo);
+
+        VulkanPipeline& getPipeline(VulkanModel::VertexLayout layout, bool indirect);
+        uint32_t selectLod(VulkanObject& object, const VulkanCamera& camera);
 
         VulkanDevice& device;
+        GeometryPool& geometryPool; // meshlets are read from this pool's meshlet buffer
+        ModelRegistry& modelRegistry; // groups the objects by model for instancing
+        MaterialManager& materialManager; // told which materials are in view, for texture residency
+        std::vector<WorldBounds> submeshBounds;
 
+        // one pipeline per vertex layout
         std::unique_ptr<VulkanPipeline> pipeline;
+        std::unique_ptr<VulkanPipeline> indirectPipeline;
+        std::unique_ptr<VulkanPipeline> compactPipeline;
+        std::unique_ptr<VulkanPipeline> compactIndirectPipeline;
         VkPipelineLayout pipelineLayout;
+
+        std::unique_ptr<VulkanPipeline> cullPipeline;
+        VkPipelineLayout cullPipelineLayout;
+        std::unique_ptr<VulkanDescriptorSetLayout> cullSetLayout;
+        std::unique_ptr<VulkanDescriptorPool> cullDescriptorPool;
+        std::vector<VkDescriptorSet> cullDescriptorSets;
+
+        struct SubmeshDraw {
+            VulkanModel::VertexLayout layout;
+            VulkanModel* model;
+            VulkanObject* object;
+            uint32_t submesh;
+            uint32_t material;
+            uint32_t objectIndex;
+            uint32_t lod;
+        };
+
+        std::vector<std::unique_ptr<VulkanBuffer>> indirectBuffers;
+        std::vector<ModelRegistry::InstanceGroup> instanceGroups;
+        std::vector<SubmeshDraw> drawList;
+        std::vector<SubmeshDraw> meshletDrawList;
+        struct CommandGroup {
+            VulkanModel::VertexLayout layout;
+            GeometryPool* pool;
+            VkIndexType indexType;
+
+            bool operator==(const CommandGroup& other) const { return layout == other.layout && pool == other.pool && indexType == other.indexType; }
+        };
+
+        std::vector<CommandGroup> commandGroups; // layout, pool and index type of every indirect command, for grouping draw calls
+
+        // std430, matches CullJob in meshlet_cull.comp. one per submesh instance with meshlets
+        struct CullJob {
+            uint32_t firstMeshlet;
+            uint32_t meshletCount;
+            uint32_t objectIndex;
+            uint32_t instanceIndex;
+            uint32_t group;
+            uint32_t commandBase;   // start of the group's command range
+            uint32_t commandOffset; // slot of the first meshlet when the draws are not compacted
+            float radiusScale;
+        };
+
+        // every group is one draw call over its own range of the meshlet command buffer
+        struct MeshletGroup {
+            VulkanModel::VertexLayout layout;
+            VkIndexType indexType;
+            uint32_t commandBase;
+            uint32_t commandCount;
+        };
+
+        std::vector<std::unique_ptr<VulkanBuffer>> cullJobBuffers;
+        std::vector<std::unique_ptr<VulkanBuffer>> meshletCommandBuffers;
+        std::vector<std::unique_ptr<VulkanBuffer>> meshletCountBuffers;
+        std::vector<MeshletGroup> meshletGroups;
+        uint32_t cullJobCount = 0;
+        bool framePrepared = false;
     };
-}
\ No newline at end of file
+}
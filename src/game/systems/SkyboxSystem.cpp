@@ -10,8 +10,8 @@ namespace VkRenderer {
 		bool sunVisible;
 	};
 
-	SkyboxSystem::SkyboxSystem(VulkanDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
-		: device{ device } {
+	SkyboxSystem::SkyboxSystem(VulkanDevice& device, GeometryPool& geometryPool, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout)
+		: device{ device }, geometryPool{ geometryPool } {
 		createCube();
 		createPipelineLayout(globalSetLayout);
 		createPipeline(renderPass);
@@ -28,6 +28,9 @@ namespace VkRenderer {
 		VkCommandBuffer commandBuffer = frameInfo.commandBuffer;
 		VulkanCamera camera = frameInfo.camera;
 
+		// drawn outside RenderingSystem, so the cube's upload has to be named for this frame here too
+		device.getUploadContext().requireForFrame(cube->getUploadTicket());
+
 		pipeline->bind(commandBuffer);
 
 		vkCmdBindDescriptorSets(
@@ -140,6 +143,6 @@ namespace VkRenderer {
 			4, 5, 1, 1, 0, 4
 		};
 
-		cube = std::make_unique<VulkanModel>(device, builder);
+		cube = std::make_unique<VulkanModel>(device, geometryPool, builder);
 	}
 }
\ No newline at end of file
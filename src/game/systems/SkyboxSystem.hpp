@@ -9,7 +9,7 @@ namespace VkRenderer {
 	class SkyboxSystem
 	{
 	public:
-		SkyboxSystem(VulkanDevice& device, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
+		SkyboxSystem(VulkanDevice& device, GeometryPool& geometryPool, VkRenderPass renderPass, VkDescriptorSetLayout globalSetLayout);
 		~SkyboxSystem();
 
 		SkyboxSystem(const SkyboxSystem&) = delete;
@@ -23,6 +23,7 @@ namespace VkRenderer {
 		void createCube();
 
 		VulkanDevice& device;
+		GeometryPool& geometryPool;
 		std::unique_ptr<VulkanModel> cube;
 
 		std::unique_ptr<VulkanPipeline> pipeline;
@@ -1,8 +1,151 @@
 #include "main_game.hpp"
 
+#include "MeshCache.hpp"
+#include "TextureCache.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <utility>
+
 using namespace VkRenderer;
 
-int main() {
+namespace fs = std::filesystem;
+
+struct CookCounts {
+    uint32_t cooked = 0, current = 0, failed = 0;
+};
+
+static void cookTexture(const std::string& path, TextureUsage usage, bool flip, CookCounts& counts) {
+    if (GetTextureCache().load(path, usage, flip)) {
+        counts.current++;
+        return;
+    }
+
+    if (GetTextureCache().cook(path, usage, flip)) {
+        std::cout << "Cooked '" << path << "' -> " << GetTextureCache().getCachePath(path, usage, flip) << std::endl;
+        counts.cooked++;
+    }
+    else {
+        std::cerr << "Failed to cook '" << path << "'" << std::endl;
+        counts.failed++;
+    }
+}
+
+// glTF images are cooked as whatever their materials use them for and flipped like importMaterials decodes them.
+// embedded images have no file to check against, they keep getting decoded at load
+static void cookModelTextures(const std::string& directory, const std::vector<VulkanModel::ImageSource>& images,
+    const std::vector<VulkanModel::MaterialSource>& materials, std::set<std::pair<fs::path, TextureUsage>>& cookedImages, CookCounts& counts) {
+    auto cookImage = [&](int image, TextureUsage usage) {
+        if (image < 0 || image >= static_cast<int>(images.size()) || images[image].uri.empty())
+            return;
+
+        fs::path path = (fs::path(directory) / images[image].uri).lexically_normal();
+        if (cookedImages.emplace(fs::weakly_canonical(path), usage).second)
+            cookTexture(path.string(), usage, true, counts);
+    };
+
+    for (const auto& material : materials) {
+        cookImage(material.albedoImage, TextureUsage::Color);
+        cookImage(material.normalImage, TextureUsage::Normal);
+    }
+}
+
+// images outside of models go by their name, the way the game loads them
+static TextureUsage guessTextureUsage(const fs::path& path) {
+    std::string name = path.stem().string();
+    std::transform(name.begin(), name.end(), name.begin(), [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    if (path.extension() == ".hdr")
+        return TextureUsage::Hdr;
+    if (name.find("normal") != std::string::npos)
+        return TextureUsage::Normal;
+
+    for (const char* mask : { "roughness", "metallic", "occlusion", "height" })
+        if (name.find(mask) != std::string::npos)
+            return TextureUsage::Mask;
+
+    return TextureUsage::Color;
+}
+
+// VulkanTest --cook <directory>: writes the mesh cache for every gltf model under directory and the block compressed
+// texture cache for the images they use and every other image, without opening a window
+static int cookAssets(const std::string& directory) {
+    CookCounts meshes, textures;
+    std::set<std::pair<fs::path, TextureUsage>> cookedImages;
+    std::vector<fs::path> looseImages;
+
+    for (const auto& entry : fs::recursive_directory_iterator(directory)) {
+        std::string extension = entry.path().extension().string();
+        if (!entry.is_regular_file())
+            continue;
+
+        if (extension == ".png" || extension == ".jpg" || extension == ".jpeg" || extension == ".tga" || extension == ".hdr")
+            looseImages.push_back(entry.path());
+        if (extension != ".gltf" && extension != ".glb")
+            continue;
+
+        std::string path = entry.path().string();
+
+        VulkanModel::Builder builder{};
+        VulkanModel::configureFileBuilder(builder, true);
+
+        if (auto cached = GetMeshCache().load(path, builder)) {
+            meshes.current++;
+            cookModelTextures(cached->directory, cached->images, cached->materials, cookedImages, textures);
+            continue;
+        }
+
+        try {
+            builder.loadModel(path);
+        }
+        catch (const std::exception& e) {
+            std::cerr << "Failed to load '" << path << "': " << e.what() << std::endl;
+            meshes.failed++;
+            continue;
+        }
+
+        if (GetMeshCache().store(path, builder)) {
+            std::cout << "Cooked '" << path << "' -> " << GetMeshCache().getCachePath(path, builder) << std::endl;
+            meshes.cooked++;
+        }
+        else {
+            std::cerr << "Failed to write the mesh cache for '" << path << "'" << std::endl;
+            meshes.failed++;
+        }
+
+        cookModelTextures(builder.directory, builder.images, builder.materials, cookedImages, textures);
+    }
+
+    // the ones no model claimed
+    for (const fs::path& image : looseImages) {
+        fs::path canonical = fs::weakly_canonical(image);
+        bool usedByModel = std::any_of(cookedImages.begin(), cookedImages.end(), [&](const auto& cooked) {
+            return cooked.first == canonical;
+        });
+
+        if (!usedByModel)
+            cookTexture(image.string(), guessTextureUsage(image), image.extension() == ".hdr", textures);
+    }
+
+    std::cout << "meshes: " << meshes.cooked << " cooked, " << meshes.current << " already current, " << meshes.failed << " failed" << std::endl;
+    std::cout << "textures: " << textures.cooked << " cooked, " << textures.current << " already current, " << textures.failed << " failed" << std::endl;
+    return meshes.failed + textures.failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+int main(int argc, char** argv) {
+    if (argc >= 2 && std::string(argv[1]) == "--cook") {
+        try {
+            return cookAssets(argc >= 3 ? argv[2] : "assets");
+        }
+        catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+
     Game game{};
 
     try {
@@ -14,4 +157,4 @@ int main() {
     }
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}